@@ -0,0 +1,41 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#ifndef GRAMMAR_BENCHMARK_ALLOCATION_COUNTER_H
+#define GRAMMAR_BENCHMARK_ALLOCATION_COUNTER_H
+
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+// Counts the calls to the global operator new. Include it in only one translation unit of a benchmark executable.
+
+namespace benchmark_helper {
+
+inline std::atomic<std::size_t> &AllocationCount() {
+  static std::atomic<std::size_t> count{0};
+  return count;
+}
+
+}
+
+
+void *operator new(std::size_t _size) {
+  benchmark_helper::AllocationCount().fetch_add(1, std::memory_order_relaxed);
+
+  if (void *ptr = std::malloc(_size ? _size : 1))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void *_ptr) noexcept {
+  std::free(_ptr);
+}
+
+void operator delete(void *_ptr, std::size_t) noexcept {
+  std::free(_ptr);
+}
+
+#endif //GRAMMAR_BENCHMARK_ALLOCATION_COUNTER_H
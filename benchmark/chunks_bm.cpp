@@ -5,6 +5,7 @@
 #include <iostream>
 #include <random>
 #include <algorithm>
+#include <numeric>
 
 #include <boost/filesystem.hpp>
 
@@ -18,9 +19,12 @@
 #include "grammar/slp_metadata.h"
 #include "grammar/slp.h"
 #include "grammar/re_pair.h"
+#include "grammar/span_cache.h"
+#include "grammar/elias_fano_chunks.h"
 
 
 DEFINE_string(data, "", "Data file.");
+DEFINE_uint64(cache_size, 64 << 20, "Memory budget (in bytes) of the span caches.");
 //DEFINE_bool(psize, true, "Print size.");
 
 
@@ -127,6 +131,85 @@ auto BM_merge_gcchunks = [](benchmark::State &state, const auto &chunks, const a
 //  if (FLAGS_psize) state.counters["Size"] = sdsl::size_in_bytes(chunks);
 };
 
+auto BM_merge_chunks_bulk = [](benchmark::State &state, const auto &chunks, const auto &merge, const auto &set_union) {
+  std::vector<uint32_t> result;
+
+  std::vector<uint32_t> items;
+
+  std::default_random_engine gen(state.range(0));
+  std::uniform_int_distribution<> uniform_dist(1, chunks.size());
+  for (int i = 0; i < state.range(0); ++i) {
+    items.push_back(uniform_dist(gen));
+  }
+
+  std::vector<uint32_t> idx(items.size());
+  std::iota(idx.begin(), idx.end(), 0);
+
+  grammar::SetsBuffer<> buffer;
+
+  std::size_t n_decoded = 0;
+  for (auto _ : state) {
+    result.clear();
+
+    buffer.Decode(items.begin(), items.end(), chunks);
+    merge(idx.begin(), idx.end(), buffer, result, set_union);
+
+    n_decoded += buffer[buffer.size() - 1].end() - buffer[0].begin();
+  }
+
+  state.counters["Items"] = result.size();
+  state.counters["Size"] = sdsl::size_in_bytes(chunks);
+  state.counters["Decoded"] = benchmark::Counter(n_decoded, benchmark::Counter::kIsRate);
+};
+
+auto BM_merge_chunks_cached = [](benchmark::State &state, const auto &gcchunks, const auto &merge, const auto &set_union) {
+  grammar::SpanCache<> cache(FLAGS_cache_size);
+  auto chunks = grammar::BuildCachedGCChunks(gcchunks, cache);
+
+  BM_merge_chunks(state, chunks, merge, set_union);
+
+  state.counters["Hits"] = cache.Hits();
+  state.counters["Misses"] = cache.Misses();
+  state.counters["CacheSize"] = cache.Size();
+};
+
+auto BM_merge_gcchunks_cached = [](benchmark::State &state, const auto &chunks, const auto &merge, const auto &set_union) {
+  std::vector<uint32_t> result;
+  std::vector<uint32_t> tresult;
+  std::vector<uint32_t> vresult;
+  std::vector<uint32_t> sresult;
+
+  std::vector<uint32_t> items;
+
+  std::default_random_engine gen(state.range(0));
+  std::uniform_int_distribution<> uniform_dist(1, chunks.size());
+  for (int i = 0; i < state.range(0); ++i) {
+    items.push_back(uniform_dist(gen));
+  }
+
+  grammar::SpanCache<> cache(FLAGS_cache_size);
+  auto spans = grammar::BuildCachedSpans(chunks.GetSLP(), cache);
+
+  for (auto _ : state) {
+    tresult.clear();
+    vresult.clear();
+    sresult.clear();
+    result.clear();
+
+    merge(items.begin(), items.end(), chunks, tresult, set_union);
+    merge(items.begin(), items.end(), BuildVChunksWrapper(chunks), vresult, set_union);
+    merge(vresult.begin(), vresult.end(), spans, sresult, set_union);
+
+    result.reserve(tresult.size() + sresult.size());
+    std::set_union(tresult.begin(), tresult.end(), sresult.begin(), sresult.end(), back_inserter(result));
+  }
+
+  state.counters["Items"] = result.size();
+  state.counters["Hits"] = cache.Hits();
+  state.counters["Misses"] = cache.Misses();
+  state.counters["CacheSize"] = cache.Size();
+};
+
 
 int main(int argc, char *argv[]) {
   gflags::AllowCommandLineReparsing();
@@ -161,6 +244,11 @@ int main(int argc, char *argv[]) {
                                chunks,
                                merge_one_by_one,
                                set_union_default)->RangeMultiplier(2)->Range(4, 16);
+  benchmark::RegisterBenchmark("Chunks_Bulk",
+                               BM_merge_chunks_bulk,
+                               chunks,
+                               merge_one_by_one,
+                               set_union_default)->RangeMultiplier(2)->Range(4, 16);
 //  benchmark::RegisterBenchmark("Chunks_set_union_custom",
 //                               BM_merge_chunks,
 //                               chunks,
@@ -176,6 +264,19 @@ int main(int argc, char *argv[]) {
                                chunks_bc,
                                merge_one_by_one,
                                set_union_default)->RangeMultiplier(2)->Range(4, 16);
+  benchmark::RegisterBenchmark("Chunks<BC>_Bulk",
+                               BM_merge_chunks_bulk,
+                               chunks_bc,
+                               merge_one_by_one,
+                               set_union_default)->RangeMultiplier(2)->Range(4, 16);
+
+  grammar::EliasFanoChunks<> chunks_ef(chunks);
+  std::cout << "  *** |Chunks<EF>| = " << sdsl::size_in_bytes(chunks_ef) << std::endl;
+  benchmark::RegisterBenchmark("Chunks<EF>_Bulk",
+                               BM_merge_chunks_bulk,
+                               chunks_ef,
+                               merge_one_by_one,
+                               set_union_default)->RangeMultiplier(2)->Range(4, 16);
 //  benchmark::RegisterBenchmark("Chunks<BC>_set_union_custom",
 //                               BM_merge_chunks,
 //                               chunks_bc,
@@ -217,6 +318,11 @@ int main(int argc, char *argv[]) {
                                gcchunks,
                                merge_one_by_one,
                                set_union_default)->RangeMultiplier(2)->Range(4, 16);
+  benchmark::RegisterBenchmark("GCChunks_Cached",
+                               BM_merge_chunks_cached,
+                               gcchunks,
+                               merge_one_by_one,
+                               set_union_default)->RangeMultiplier(2)->Range(4, 16);
 //  benchmark::RegisterBenchmark("GCChunks_set_union_custom",
 //                               BM_merge_chunks,
 //                               gcchunks,
@@ -295,6 +401,11 @@ int main(int argc, char *argv[]) {
                                gcchunkstv,
                                merge_one_by_one,
                                set_union_default)->RangeMultiplier(2)->Range(4, 16);
+  benchmark::RegisterBenchmark("GCChunksTV_All_Cached",
+                               BM_merge_gcchunks_cached,
+                               gcchunkstv,
+                               merge_one_by_one,
+                               set_union_default)->RangeMultiplier(2)->Range(4, 16);
 //  benchmark::RegisterBenchmark("GCChunksTV_set_union_custom",
 //                               BM_merge_chunks,
 //                               gcchunkstv,
@@ -329,6 +440,11 @@ int main(int argc, char *argv[]) {
                                gcchunkstv_bc,
                                merge_one_by_one,
                                set_union_default)->RangeMultiplier(2)->Range(4, 16);
+  benchmark::RegisterBenchmark("GCChunksTV<bc>_All_Cached",
+                               BM_merge_gcchunks_cached,
+                               gcchunkstv_bc,
+                               merge_one_by_one,
+                               set_union_default)->RangeMultiplier(2)->Range(4, 16);
 //  benchmark::RegisterBenchmark("GCChunksTV<bc>_set_union_custom",
 //                               BM_merge_chunks,
 //                               gcchunkstv_bc,
@@ -0,0 +1,244 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <iostream>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <gflags/gflags.h>
+
+#include "grammar/slp.h"
+#include "grammar/slp_helper.h"
+#include "grammar/re_pair.h"
+#include "grammar/slp_metadata.h"
+#include "grammar/sampled_slp.h"
+
+#include "synthetic_data.h"
+#include "memory_usage.h"
+
+
+DEFINE_uint64(n, 1 << 20, "Length of the synthetic sequence.");
+DEFINE_int32(sigma, 64, "Alphabet size of the synthetic sequence.");
+DEFINE_uint32(seed, 17, "Seed of the synthetic sequence.");
+DEFINE_double(copy_prob, 0.9, "Repetitiveness of the synthetic sequence: probability of copying a previous block.");
+DEFINE_uint64(block_length, 256, "Maximum length of the blocks of the synthetic sequence.");
+
+
+static void BM_Empty(benchmark::State &state) {
+  for (auto _ : state)
+    std::string empty_string;
+}
+// Register the function as a benchmark
+BENCHMARK(BM_Empty);
+
+
+/**
+ * Run a construction stage (_construct() -> output) and report the size of its output and the peak RSS during the
+ * construction (including the inputs, which are already in memory)
+ */
+template<typename _Construct>
+void RunConstruction(benchmark::State &_state, const _Construct &_construct) {
+  benchmark_helper::ResetPeakRSS();
+  auto initial_rss = benchmark_helper::CurrentRSS();
+
+  std::size_t output_size = 0;
+  for (auto _ : _state) {
+    auto output = _construct();
+    output_size = sdsl::size_in_bytes(output);
+    benchmark::DoNotOptimize(output);
+  }
+
+  auto peak_rss = benchmark_helper::PeakRSS();
+  _state.counters["Size(B)"] = output_size;
+  _state.counters["PeakRSS(B)"] = peak_rss;
+  _state.counters["PeakRSSDelta(B)"] = initial_rss < peak_rss ? peak_rss - initial_rss : 0;
+}
+
+
+auto BM_construct_slp = [](benchmark::State &state, const auto &seq) {
+  std::size_t n_vars = 0;
+  RunConstruction(state, [&seq, &n_vars]() {
+    grammar::SLP<> slp(0);
+    grammar::RePairEncoder<true> encoder;
+    grammar::ConstructSLP(seq.begin(), seq.end(), encoder, slp);
+    n_vars = slp.Variables();
+    return slp;
+  });
+
+  state.counters["Variables"] = n_vars;
+};
+
+
+auto BM_construct_pts = [](benchmark::State &state, const auto &slp) {
+  RunConstruction(state, [&slp]() {
+    return grammar::PTS<>(&slp);
+  });
+};
+
+
+auto BM_construct_sampled_pts = [](benchmark::State &state, const auto &slp) {
+  uint32_t block_size = state.range(0);
+  const float storing_factor = 16;
+
+  RunConstruction(state, [&slp, block_size, storing_factor]() {
+    return grammar::SampledPTS<grammar::SLP<>>(&slp, block_size, storing_factor);
+  });
+};
+
+
+/**
+ * Sampled SLP with the sets of the sampled nodes. The predicate is built over the sets (build_pred(pts)). The block
+ * size is range(0) and the number of threads is range(1).
+ */
+auto BM_construct_sampled_slp = [](benchmark::State &state, const auto &slp, auto build_pred) {
+  uint32_t block_size = state.range(0);
+  std::size_t n_threads = state.range(1);
+
+  std::size_t n_sets = 0;
+  RunConstruction(state, [&slp, &build_pred, &n_sets, block_size, n_threads]() {
+    grammar::Chunks<> pts;
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    grammar::SampledSLP<> sslp(slp, block_size, add_set, add_set, build_pred(pts), n_threads);
+    n_sets = pts.size();
+    return sslp;
+  });
+
+  state.counters["Sets"] = n_sets;
+};
+
+
+auto BM_construct_combined_slp = [](benchmark::State &state, const auto &slp, auto build_pred) {
+  uint32_t block_size = state.range(0);
+  std::size_t n_threads = state.range(1);
+
+  std::size_t n_sets = 0;
+  RunConstruction(state, [&slp, &build_pred, &n_sets, block_size, n_threads]() {
+    grammar::CombinedSLP<> cslp(slp);
+    grammar::Chunks<> pts;
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    cslp.Compute(block_size, add_set, add_set, build_pred(pts), n_threads);
+    n_sets = pts.size();
+    return cslp;
+  });
+
+  state.counters["Sets"] = n_sets;
+};
+
+
+/**
+ * Light SLP of the sequence over the combined SLP of block size range(0) (computed before the benchmark)
+ */
+auto BM_construct_light_slp = [](benchmark::State &state, const auto &seq, const auto &slp, auto build_pred) {
+  uint32_t block_size = state.range(0);
+  std::size_t n_threads = state.range(1);
+
+  grammar::CombinedSLP<> cslp(slp);
+  grammar::Chunks<> pts;
+  {
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    cslp.Compute(block_size, add_set, add_set, build_pred(pts));
+  }
+
+  RunConstruction(state, [&seq, &cslp, n_threads]() {
+    grammar::LightSLP<> lslp;
+    lslp.Compute(seq.begin(), seq.end(), grammar::RePairEncoder<false>(), cslp, n_threads);
+    return lslp;
+  });
+};
+
+
+/**
+ * Grammar-compressed chunks of the sets of the sampled SLP of block size range(0) (computed before the benchmark)
+ */
+auto BM_construct_gcchunks = [](benchmark::State &state, const auto &slp, auto build_pred) {
+  uint32_t block_size = state.range(0);
+  std::size_t n_threads = state.range(1);
+
+  grammar::Chunks<> pts;
+  {
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    grammar::SampledSLP<> sslp(slp, block_size, add_set, add_set, build_pred(pts));
+  }
+
+  RunConstruction(state, [&pts, n_threads]() {
+    grammar::RePairEncoder<false> encoder;
+    return grammar::GCChunks<grammar::SLP<>, false>(
+        pts.GetObjects().begin(), pts.GetObjects().end(), pts, encoder, n_threads);
+  });
+
+  state.counters["Sets"] = pts.size();
+  state.counters["SetsSize(B)"] = sdsl::size_in_bytes(pts);
+};
+
+
+int main(int argc, char *argv[]) {
+  gflags::AllowCommandLineReparsing();
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+  auto seq = benchmark_helper::GenerateRepetitiveSequence(
+      FLAGS_n, FLAGS_sigma, FLAGS_seed, FLAGS_copy_prob, FLAGS_block_length);
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(seq.begin(), seq.end(), encoder, slp);
+  std::cout << "  *** |Seq| = " << seq.size() << ", |SLP| = " << slp.Variables() << std::endl;
+
+  if (!benchmark_helper::ResetPeakRSS()) {
+    std::cout << "  *** The peak RSS cannot be reset: PeakRSS is the peak of the whole process" << std::endl;
+  }
+
+  // Sampling predicates over the sets of the sampled nodes
+  auto are_children_too_big = [](const grammar::Chunks<> &_pts) {
+    return grammar::BuildSamplingPredicate(grammar::ChildrenSetSource<grammar::Chunks<>>(_pts),
+                                           grammar::AreChildrenTooBig<grammar::Chunks<>>(_pts, 2));
+  };
+
+  auto is_too_big = [](const grammar::Chunks<> &_pts) {
+    return grammar::BuildSamplingPredicate(grammar::ChildrenSetSource<grammar::Chunks<>>(_pts),
+                                           grammar::IsTooBig(std::max(1, FLAGS_sigma / 4)));
+  };
+
+  auto is_equal = [](const grammar::Chunks<> &_pts) {
+    return grammar::BuildSamplingPredicate(grammar::ChildrenSetSource<grammar::Chunks<>>(_pts),
+                                           grammar::IsEqual<grammar::Chunks<>>(_pts, 16));
+  };
+
+  const std::vector<int64_t> kBlockSizes = {16, 64, 256};
+  const std::vector<int64_t> kThreads = {1, 4};
+
+  benchmark::RegisterBenchmark("Construct_SLP", BM_construct_slp, seq)->Unit(benchmark::kMillisecond);
+
+  benchmark::RegisterBenchmark("Construct_PTS", BM_construct_pts, slp)->Unit(benchmark::kMillisecond);
+
+  benchmark::RegisterBenchmark("Construct_SampledPTS", BM_construct_sampled_pts, slp)
+      ->ArgsProduct({kBlockSizes})->Unit(benchmark::kMillisecond);
+
+  benchmark::RegisterBenchmark("Construct_SampledSLP/AreChildrenTooBig", BM_construct_sampled_slp, slp,
+                               are_children_too_big)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+  benchmark::RegisterBenchmark("Construct_SampledSLP/IsTooBig", BM_construct_sampled_slp, slp, is_too_big)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+  benchmark::RegisterBenchmark("Construct_SampledSLP/IsEqual", BM_construct_sampled_slp, slp, is_equal)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+  benchmark::RegisterBenchmark("Construct_CombinedSLP/AreChildrenTooBig", BM_construct_combined_slp, slp,
+                               are_children_too_big)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+  benchmark::RegisterBenchmark("Construct_CombinedSLP/IsTooBig", BM_construct_combined_slp, slp, is_too_big)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+  benchmark::RegisterBenchmark("Construct_CombinedSLP/IsEqual", BM_construct_combined_slp, slp, is_equal)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+  benchmark::RegisterBenchmark("Construct_LightSLP", BM_construct_light_slp, seq, slp, are_children_too_big)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+  benchmark::RegisterBenchmark("Construct_GCChunks", BM_construct_gcchunks, slp, are_children_too_big)
+      ->ArgsProduct({kBlockSizes, kThreads})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+
+  return 0;
+}
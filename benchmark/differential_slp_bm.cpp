@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <random>
+#include <thread>
 
 #include <boost/filesystem.hpp>
 
@@ -20,7 +21,13 @@
 
 #include "../tool/definitions.h"
 
+#include "synthetic_data.h"
+#include "perf_counters.h"
+
 DEFINE_string(data, "", "Data file. (MANDATORY)");
+DEFINE_uint64(seed, 42, "Seed of the query positions.");
+DEFINE_uint64(n_positions, 100000, "Number of query positions.");
+DEFINE_uint64(max_size, 64, "Maximum size of sampled intervals of the concurrent benchmarks.");
 
 // Benchmark Warm-up
 static void BM_WarmUp(benchmark::State &state) {
@@ -48,97 +55,166 @@ auto BM_Access = [](benchmark::State &_state, const auto &_seq, const auto &_pos
   _state.counters["Size"] = sdsl::size_in_bytes(_seq);
 };
 
-auto BM_ExpandDSLP = [](benchmark::State &_state,
-                        const auto &_seq_size,
-                        const auto &_slp,
-                        const auto &_roots,
-                        const auto &_diff_base_seq,
-                        const auto &_span_sums,
-                        const auto &_diff_base_sums,
-                        const auto &_positions,
-                        auto _config) {
+/**
+ * Run an operation (_op(dslp, position) -> value) of the differential SLP for each position
+ *
+ * The samples cover intervals of at most range(0) positions. If range(1) is 0, they are single-level
+ * (DifferentialSLPSamples); otherwise, they are hierarchical with a coarse sample every range(1) samples
+ * (HierarchicalDifferentialSLPSamples).
+ */
+auto BM_DSLPOperation = [](benchmark::State &_state,
+                           const auto &_op,
+                           const auto &_seq_size,
+                           const auto &_slp,
+                           const auto &_roots,
+                           const auto &_diff_base_seq,
+                           const auto &_span_sums,
+                           const auto &_diff_base_sums,
+                           const auto &_positions) {
   std::size_t max_span_len = _state.range(0);
+  std::size_t coarse_rate = _state.range(1);
 
-  using BitVector = sdsl::sd_vector<>;
-  sdsl::int_vector<> samples;
-  sdsl::int_vector<> sample_roots_pos;
-  BitVector samples_pos;
-  {
-    auto get_span_sum = [&_slp, &_diff_base_seq, &_span_sums, &_diff_base_sums](auto _var) {
-      return _slp.IsTerminal(_var) ? (_var - _diff_base_seq) : (_span_sums[_var - _slp.Sigma() - 1] - _diff_base_sums);
-    };
+  auto get_span_sum = [&_slp, &_diff_base_seq, &_span_sums, &_diff_base_sums](auto _var) {
+    return _slp.IsTerminal(_var) ? (_var - _diff_base_seq) : (_span_sums[_var - _slp.Sigma() - 1] - _diff_base_sums);
+  };
+
+  auto run = [&](const auto &_samples) {
+    auto dslp = grammar::MakeDifferentialSLPWrapper(_seq_size,
+                                                    _slp,
+                                                    _roots,
+                                                    _diff_base_seq,
+                                                    _span_sums,
+                                                    _diff_base_sums,
+                                                    _samples);
+
+    std::vector<int64_t> values;
+    values.reserve(_positions.size());
+    benchmark_helper::PerfCounters perf_counters;
+    perf_counters.Start();
+    for (auto _ : _state) {
+      values.clear();
+      for (const auto &position : _positions) {
+        values.emplace_back(_op(dslp, position));
+      }
+    }
+    perf_counters.Stop();
+    perf_counters.Report(_state);
+
+    _state.counters["Size"] = sizeof(_seq_size) + sdsl::size_in_bytes(_slp) + sdsl::size_in_bytes(_roots)
+        + sizeof(_diff_base_seq) + sdsl::size_in_bytes(_span_sums) + sizeof(_diff_base_sums)
+        + sdsl::size_in_bytes(_samples);
+    _state.counters["SamplesSize"] = sdsl::size_in_bytes(_samples);
+    _state.counters["Samples"] = _samples.size();
+  };
 
-    sdsl::bit_vector tmp_sample_pos(_seq_size, 0);
-    std::vector<std::size_t> tmp_samples;
-    tmp_samples.reserve(_roots.size());
-    std::vector<std::size_t> tmp_sample_roots_pos;
-    tmp_sample_roots_pos.reserve(_roots.size());
-    auto report_sample =
-        [&tmp_sample_pos, &tmp_samples, &tmp_sample_roots_pos](auto _pos_seq, auto _sum, auto _pos_root) {
-          tmp_sample_pos[_pos_seq] = 1;
-          tmp_samples.emplace_back(_sum);
-          tmp_sample_roots_pos.emplace_back(_pos_root);
-        };
-
-    grammar::ComputeSamplesOnCompactSequence(_roots, _slp, get_span_sum, max_span_len, report_sample);
-
-    grammar::Construct(samples, tmp_samples);
-    sdsl::util::bit_compress(samples);
-//    sdsl::store_to_cache(samples, KEY_GRM_SAMPLE_VALUES + ("_" + std::to_string(max_span_len)), _config);
-
-    grammar::Construct(sample_roots_pos, tmp_sample_roots_pos);
-    sdsl::util::bit_compress(sample_roots_pos);
-//    sdsl::store_to_cache(sample_roots_pos,
-//                         KEY_GRM_SAMPLE_ROOTS_POSITIONS + ("_" + std::to_string(max_span_len)),
-//                         _config);
-
-    grammar::Construct(samples_pos, tmp_sample_pos);
-//    sdsl::store_to_cache(samples_pos, KEY_GRM_SAMPLE_POSITIONS + ("_" + std::to_string(max_span_len)), _config);
+  if (coarse_rate == 0) {
+    run(grammar::DifferentialSLPSamples<>(_seq_size, _roots, _slp, get_span_sum, max_span_len));
+  } else {
+    run(grammar::HierarchicalDifferentialSLPSamples<>(
+        _seq_size, _roots, _slp, get_span_sum, max_span_len, coarse_rate));
   }
-  BitVector::rank_1_type samples_pos_rank(&samples_pos);
-  BitVector::select_1_type samples_pos_select(&samples_pos);
-
-  auto dslp = grammar::MakeDifferentialSLPWrapper(_seq_size,
-                                                  _slp,
-                                                  _roots,
-                                                  _diff_base_seq,
-                                                  _span_sums,
-                                                  _diff_base_sums,
-                                                  samples,
-                                                  sample_roots_pos,
-                                                  samples_pos,
-                                                  samples_pos_rank,
-                                                  samples_pos_select);
-
-  std::size_t value;
-  auto report_value = [&value](std::size_t _suffix) {
-    value = _suffix;
+};
+
+auto BM_ExpandDSLP = [](benchmark::State &_state, auto &&..._args) {
+  auto get_value = [](const auto &_dslp, std::size_t _i) {
+    std::size_t value;
+    grammar::ExpandDifferentialSLP(_dslp, _i, _i, [&value](std::size_t _suffix) { value = _suffix; });
+    return int64_t(value);
   };
 
-  auto get_value = [&dslp, &report_value, &value](std::size_t _i) {
-    grammar::ExpandDifferentialSLP(dslp, _i, _i, report_value);
-    return value;
+  BM_DSLPOperation(_state, get_value, _args...);
+};
+
+auto BM_ValueAtDSLP = [](benchmark::State &_state, auto &&..._args) {
+  auto get_value = [](const auto &_dslp, std::size_t _i) {
+    return _dslp.ValueAt(_i);
   };
 
-  std::vector<std::size_t> values;
-  values.reserve(_positions.size());
+  BM_DSLPOperation(_state, get_value, _args...);
+};
+
+/**
+ * Range operations on [position, position + range length)
+ */
+auto BM_RangeSumDSLP = [](benchmark::State &_state, std::size_t _range_len, auto &&..._args) {
+  auto get_sum = [_range_len](const auto &_dslp, std::size_t _i) {
+    return _dslp.RangeSum(_i, _i + _range_len - 1);
+  };
+
+  BM_DSLPOperation(_state, get_sum, _args...);
+};
+
+auto BM_SumOfValuesDSLP = [](benchmark::State &_state,
+                             std::size_t _range_len,
+                             const auto &_value_sums,
+                             auto &&..._args) {
+  auto get_sum = [_range_len, &_value_sums](const auto &_dslp, std::size_t _i) {
+    return _dslp.SumOfValues(_i, _i + _range_len - 1, _value_sums);
+  };
+
+  BM_DSLPOperation(_state, get_sum, _args...);
+};
+
+auto BM_SumOfValuesExpandDSLP = [](benchmark::State &_state, std::size_t _range_len, auto &&..._args) {
+  auto get_sum = [_range_len](const auto &_dslp, std::size_t _i) {
+    return _dslp.SumOfValues(_i, _i + _range_len - 1);
+  };
+
+  BM_DSLPOperation(_state, get_sum, _args...);
+};
+
+auto BM_ExpandRangeDSLP = [](benchmark::State &_state, std::size_t _range_len, auto &&..._args) {
+  auto get_last = [_range_len](const auto &_dslp, std::size_t _i) {
+    int64_t last = 0;
+    grammar::ExpandDifferentialSLP(_dslp, _i, _i + _range_len - 1, [&last](auto _value) { last = _value; });
+    return last;
+  };
+
+  BM_DSLPOperation(_state, get_last, _args...);
+};
+
+/**
+ * Expand the ranges into a buffer, copying the given leaf blocks (or grammar::NoLeafBlocks)
+ */
+auto BM_ExpandToBufferDSLP = [](benchmark::State &_state,
+                                std::size_t _range_len,
+                                const auto &_leaf_blocks,
+                                auto &&..._args) {
+  std::vector<int64_t> buffer(_range_len);
+  auto get_last = [_range_len, &_leaf_blocks, &buffer](const auto &_dslp, std::size_t _i) {
+    _dslp.ExpandToBuffer(_i, _i + _range_len - 1, buffer.data(), _leaf_blocks);
+    return buffer.back();
+  };
+
+  BM_DSLPOperation(_state, get_last, _args...);
+};
+
+/**
+ * Expand ranges of range(0) positions concurrently over a shared (read-only) differential SLP
+ *
+ * Each thread expands all the ranges into its own buffer, starting at a different offset of the positions, so the
+ * items per second are the aggregated throughput.
+ */
+auto BM_ConcurrentExpandDSLP = [](benchmark::State &_state, const auto &_dslp, const auto &_positions) {
+  std::size_t range_len = _state.range(0);
+  std::vector<int64_t> buffer(range_len);
+
+  auto offset = _positions.size() * _state.thread_index() / _state.threads();
+  benchmark_helper::PerfCounters perf_counters;
+  perf_counters.Start();
   for (auto _ : _state) {
-    values.clear();
-    for (const auto &position : _positions) {
-      auto v = get_value(position);
-      values.emplace_back(v);
+    for (std::size_t i = 0; i < _positions.size(); ++i) {
+      auto position = _positions[(offset + i) % _positions.size()];
+      _dslp.ExpandToBuffer(position, position + range_len - 1, buffer.data());
+      benchmark::DoNotOptimize(buffer.data());
     }
+    benchmark::ClobberMemory();
   }
+  perf_counters.Stop();
+  perf_counters.Report(_state);
 
-//  std::ofstream out("values-" + std::to_string(max_span_len) + ".txt");
-//  for (const auto &v: values) {
-//    out << v << std::endl;
-//  }
-
-  _state.counters["Size"] = sizeof(_seq_size) + sdsl::size_in_bytes(_slp) + sdsl::size_in_bytes(_roots)
-      + sizeof(_diff_base_seq) + sdsl::size_in_bytes(_span_sums) + sizeof(_diff_base_sums)
-      + sdsl::size_in_bytes(samples) + sdsl::size_in_bytes(sample_roots_pos) + sdsl::size_in_bytes(samples_pos)
-      + sdsl::size_in_bytes(samples_pos_rank) + sdsl::size_in_bytes(samples_pos_select);
+  _state.SetItemsProcessed(_state.iterations() * _positions.size());
+  _state.SetBytesProcessed(_state.iterations() * _positions.size() * range_len * sizeof(int64_t));
 };
 
 
@@ -204,20 +280,19 @@ int main(int argc, char *argv[]) {
     diff_base_sums = minimal < 0 ? std::abs(minimal) : 0;
   }
 
-  const std::size_t kNPositions = 100000;
   std::vector<std::size_t> positions;
-  positions.reserve(kNPositions + 2);
+  positions.reserve(FLAGS_n_positions + 2);
   positions.emplace_back(0);
   positions.emplace_back(seq_size - 1);
   {
-    std::random_device rd; // obtain a random number from hardware
-    std::mt19937 eng(rd()); // seed the generator
-    std::uniform_int_distribution<> distr(0, seq_size); // define the range
-
-    for (std::size_t i = 0; i < kNPositions; ++i)
-      positions.emplace_back(distr(eng)); // generate numbers
+    auto uniform = benchmark_helper::GeneratePositions(
+        benchmark_helper::PositionDistribution::kUniform, FLAGS_n_positions, seq_size - 1, FLAGS_seed);
+    positions.insert(positions.end(), uniform.begin(), uniform.end());
   }
 
+  // Single-level samples (0) and hierarchical samples with a coarse sample every 16/64 samples
+  const std::vector<int64_t> kCoarseRates = {0, 16, 64};
+
   benchmark::RegisterBenchmark("BM_ExpandDSLP",
                                BM_ExpandDSLP,
                                seq_size,
@@ -226,9 +301,140 @@ int main(int argc, char *argv[]) {
                                diff_base_seq,
                                span_sums,
                                diff_base_sums,
-                               positions,
-                               config)
-      ->RangeMultiplier(2)->Range(1, 1 << 12);
+                               positions)
+      ->ArgsProduct({benchmark::CreateRange(1, 1 << 12, 2), kCoarseRates});
+
+  benchmark::RegisterBenchmark("BM_ValueAtDSLP",
+                               BM_ValueAtDSLP,
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               positions)
+      ->ArgsProduct({benchmark::CreateRange(1, 1 << 12, 2), kCoarseRates});
+
+  // Range queries: the positions are the beginnings of the ranges
+  const std::size_t kRangeLength = 1000;
+  std::vector<std::size_t> range_positions;
+  range_positions.reserve(positions.size());
+  for (const auto &position : positions) {
+    if (position + kRangeLength <= seq_size) {
+      range_positions.emplace_back(position);
+    }
+  }
+
+  auto value_sums = grammar::BuildValueSums(slp, diff_base_seq);
+  std::cout << "Size of value sums: " << sdsl::size_in_bytes(value_sums) << std::endl;
+
+  benchmark::RegisterBenchmark("BM_RangeSumDSLP",
+                               BM_RangeSumDSLP,
+                               kRangeLength,
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               range_positions)
+      ->ArgsProduct({benchmark::CreateRange(16, 1 << 12, 4), kCoarseRates});
+
+  benchmark::RegisterBenchmark("BM_SumOfValuesDSLP",
+                               BM_SumOfValuesDSLP,
+                               kRangeLength,
+                               value_sums,
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               range_positions)
+      ->ArgsProduct({benchmark::CreateRange(16, 1 << 12, 4), kCoarseRates});
+
+  benchmark::RegisterBenchmark("BM_SumOfValuesExpandDSLP",
+                               BM_SumOfValuesExpandDSLP,
+                               kRangeLength,
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               range_positions)
+      ->ArgsProduct({benchmark::CreateRange(16, 1 << 12, 4), kCoarseRates});
+
+  benchmark::RegisterBenchmark("BM_ExpandRangeDSLP",
+                               BM_ExpandRangeDSLP,
+                               kRangeLength,
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               range_positions)
+      ->ArgsProduct({benchmark::CreateRange(16, 1 << 12, 4), {0}});
+
+  benchmark::RegisterBenchmark("BM_ExpandToBufferDSLP",
+                               BM_ExpandToBufferDSLP,
+                               kRangeLength,
+                               grammar::NoLeafBlocks(),
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               range_positions)
+      ->ArgsProduct({benchmark::CreateRange(16, 1 << 12, 4), {0}});
+
+  auto leaf_blocks = grammar::DifferentialSLPLeafBlocks<>(slp, diff_base_seq, 16);
+  std::cout << "Size of leaf blocks: " << sdsl::size_in_bytes(leaf_blocks) << std::endl;
+
+  benchmark::RegisterBenchmark("BM_ExpandToBufferLeafBlocksDSLP",
+                               BM_ExpandToBufferDSLP,
+                               kRangeLength,
+                               leaf_blocks,
+                               seq_size,
+                               slp,
+                               compact_seq,
+                               diff_base_seq,
+                               span_sums,
+                               diff_base_sums,
+                               range_positions)
+      ->ArgsProduct({benchmark::CreateRange(16, 1 << 12, 4), {0}});
+
+  // Concurrent expansions over a shared differential SLP, for each distribution of the positions
+  auto get_span_sum = [&slp, &diff_base_seq, &span_sums, &diff_base_sums](auto _var) {
+    return slp.IsTerminal(_var) ? (_var - diff_base_seq) : (span_sums[_var - slp.Sigma() - 1] - diff_base_sums);
+  };
+  grammar::DifferentialSLPSamples<> samples(seq_size, compact_seq, slp, get_span_sum, FLAGS_max_size);
+  auto dslp = grammar::MakeDifferentialSLPWrapper(seq_size, slp, compact_seq, diff_base_seq, span_sums,
+                                                  diff_base_sums, samples);
+
+  // Sequential ranges are consecutive, and clustered/Zipfian windows hold several ranges
+  for (auto dist : {benchmark_helper::PositionDistribution::kUniform,
+                    benchmark_helper::PositionDistribution::kSequential,
+                    benchmark_helper::PositionDistribution::kClustered,
+                    benchmark_helper::PositionDistribution::kZipfian}) {
+    for (std::size_t range_len : {1, 16, 256, 4096}) {
+      range_len = std::min(range_len, seq_size);
+      auto window = std::max<std::size_t>(range_len * 16, 1 << 12);
+      auto concurrent_positions = benchmark_helper::GeneratePositions(
+          dist, FLAGS_n_positions, seq_size - range_len, FLAGS_seed, range_len, window);
+
+      benchmark::RegisterBenchmark(
+          (std::string("BM_ConcurrentExpandDSLP/") + benchmark_helper::ToString(dist)).c_str(),
+          BM_ConcurrentExpandDSLP,
+          dslp,
+          concurrent_positions)
+          ->Arg(range_len)
+          ->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))
+          ->UseRealTime();
+    }
+  }
 
 //  sdsl::int_vector<> sa;
 //  sdsl::load_from_file(sa, (datafile.parent_path() / "sa_data.sdsl").string());
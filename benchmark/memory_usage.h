@@ -0,0 +1,75 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#ifndef GRAMMAR_BENCHMARK_MEMORY_USAGE_H
+#define GRAMMAR_BENCHMARK_MEMORY_USAGE_H
+
+#include <cstddef>
+#include <limits>
+#include <fstream>
+#include <string>
+
+#include <sys/resource.h>
+
+namespace benchmark_helper {
+
+/**
+ * Read a field (in kB) of /proc/self/status
+ *
+ * @return bytes (0 if it is not available)
+ */
+inline std::size_t ReadProcStatus(const std::string &_field) {
+  std::ifstream in("/proc/self/status");
+  std::string key;
+  while (in >> key) {
+    if (key == _field + ":") {
+      std::size_t kb = 0;
+      in >> kb;
+      return kb * 1024;
+    }
+    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+
+  return 0;
+}
+
+/**
+ * Current resident set size in bytes (0 if it is not available)
+ */
+inline std::size_t CurrentRSS() {
+  return ReadProcStatus("VmRSS");
+}
+
+/**
+ * Peak resident set size in bytes since the start of the process or the last ResetPeakRSS
+ */
+inline std::size_t PeakRSS() {
+  auto peak = ReadProcStatus("VmHWM");
+  if (peak != 0)
+    return peak;
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss; // Bytes
+#else
+  return usage.ru_maxrss * 1024; // Kilobytes
+#endif
+}
+
+/**
+ * Reset the peak resident set size to the current one (Linux 4.0 or later)
+ *
+ * @return false if the peak cannot be reset, so PeakRSS is the peak of the whole process
+ */
+inline bool ResetPeakRSS() {
+  std::ofstream out("/proc/self/clear_refs");
+  out << "5";
+  out.flush();
+  return bool(out);
+}
+
+}
+
+#endif //GRAMMAR_BENCHMARK_MEMORY_USAGE_H
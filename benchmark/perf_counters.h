@@ -0,0 +1,129 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#ifndef GRAMMAR_BENCHMARK_PERF_COUNTERS_H
+#define GRAMMAR_BENCHMARK_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+namespace benchmark_helper {
+
+/**
+ * Last-level cache counters of the calling thread (Linux perf_event): references and misses.
+ *
+ * If perf_event is not available (other systems, no hardware counters, or restricted by perf_event_paranoid), the
+ * counters are not opened and nothing is reported.
+ */
+class PerfCounters {
+ public:
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  PerfCounters() {
+#ifdef __linux__
+    fds_[0] = Open(PERF_COUNT_HW_CACHE_REFERENCES);
+    fds_[1] = Open(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (auto fd : fds_) {
+      if (fd != -1) close(fd);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool Valid() const {
+    return fds_[0] != -1 && fds_[1] != -1;
+  }
+
+  void Start() {
+#ifdef __linux__
+    if (!Valid()) return;
+
+    for (auto fd : fds_) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void Stop() {
+#ifdef __linux__
+    if (!Valid()) return;
+
+    for (auto fd : fds_) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t References() const {
+    return Read(fds_[0]);
+  }
+
+  uint64_t Misses() const {
+    return Read(fds_[1]);
+  }
+
+  /**
+   * Add the counters to the benchmark state: LLC references and misses per iteration, and the memory bandwidth
+   * estimated from the misses (a cache line each)
+   */
+  void Report(benchmark::State &_state) const {
+    if (!Valid()) return;
+
+    auto misses = double(Misses());
+    _state.counters["LLCRefs"] = benchmark::Counter(double(References()), benchmark::Counter::kAvgIterations);
+    _state.counters["LLCMisses"] = benchmark::Counter(misses, benchmark::Counter::kAvgIterations);
+    _state.counters["MemBW"] = benchmark::Counter(misses * kCacheLineSize,
+                                                  benchmark::Counter::kIsRate,
+                                                  benchmark::Counter::kIs1024);
+  }
+
+ private:
+  int fds_[2] = {-1, -1};
+
+#ifdef __linux__
+  static int Open(uint64_t _config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = _config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // Calling thread, any CPU
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+  static uint64_t Read(int _fd) {
+    uint64_t value = 0;
+#ifdef __linux__
+    if (_fd == -1 || read(_fd, &value, sizeof(value)) != sizeof(value))
+      return 0;
+#endif
+    return value;
+  }
+};
+
+}
+
+#endif //GRAMMAR_BENCHMARK_PERF_COUNTERS_H
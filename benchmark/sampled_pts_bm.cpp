@@ -0,0 +1,127 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#include <iostream>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <gflags/gflags.h>
+
+#include <sdsl/io.hpp>
+
+#include "grammar/slp_metadata.h"
+#include "grammar/slp.h"
+#include "grammar/re_pair.h"
+
+#include "allocation_counter.h"
+
+
+DEFINE_string(data, "", "Data file (Chunks).");
+DEFINE_uint64(n_queries, 1000, "Number of queried variables.");
+
+
+static void BM_Empty(benchmark::State &state) {
+  for (auto _ : state)
+    std::string empty_string;
+}
+// Register the function as a benchmark
+BENCHMARK(BM_Empty);
+
+
+template<typename _SLP>
+auto GenerateQueries(const _SLP &_slp) {
+  std::vector<uint32_t> queries;
+
+  std::default_random_engine gen(FLAGS_n_queries);
+  std::uniform_int_distribution<uint32_t> uniform_dist(_slp.Sigma() + 1, _slp.Variables());
+  for (int i = 0; i < FLAGS_n_queries; ++i) {
+    queries.push_back(uniform_dist(gen));
+  }
+
+  return queries;
+}
+
+
+auto BM_lookup = [](benchmark::State &state, const auto &pts, const auto &queries) {
+  std::size_t n_items = 0;
+
+  auto n_allocs = benchmark_helper::AllocationCount().load();
+  for (auto _ : state) {
+    for (const auto &query : queries) {
+      auto set = pts[query];
+      n_items += set.size();
+    }
+  }
+  n_allocs = benchmark_helper::AllocationCount().load() - n_allocs;
+
+  auto n = double(state.iterations() * queries.size());
+  state.counters["Items"] = n_items / n;
+  state.counters["AllocsPerQuery"] = n_allocs / n;
+  state.counters["Latency"] = benchmark::Counter(n, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+};
+
+
+auto BM_lookup_context = [](benchmark::State &state, const auto &pts, const auto &queries) {
+  std::size_t n_items = 0;
+
+  typename std::decay_t<decltype(pts)>::QueryContext context;
+  std::vector<uint32_t> set;
+
+  auto n_allocs = benchmark_helper::AllocationCount().load();
+  for (auto _ : state) {
+    for (const auto &query : queries) {
+      set.clear();
+      pts.GetSet(query, context, back_inserter(set));
+      n_items += set.size();
+    }
+  }
+  n_allocs = benchmark_helper::AllocationCount().load() - n_allocs;
+
+  auto n = double(state.iterations() * queries.size());
+  state.counters["Items"] = n_items / n;
+  state.counters["AllocsPerQuery"] = n_allocs / n;
+  state.counters["Latency"] = benchmark::Counter(n, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+};
+
+
+int main(int argc, char *argv[]) {
+  gflags::AllowCommandLineReparsing();
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+  if (FLAGS_data.empty()) {
+    std::cerr << "Command-line error!!!" << std::endl;
+    return 1;
+  }
+
+  grammar::Chunks<> chunks;
+  std::ifstream in(FLAGS_data, std::ios::binary | std::ios::in);
+  sdsl::load(chunks, in);
+
+  grammar::RePairEncoder<false> encoder;
+  grammar::GCChunks<grammar::SLP<>> gcchunks(
+      chunks.GetObjects().begin(), chunks.GetObjects().end(), chunks, encoder);
+  const auto &slp = gcchunks.GetSLP();
+  std::cout << "  *** |SLP| = " << sdsl::size_in_bytes(slp) << std::endl;
+
+  auto queries = GenerateQueries(slp);
+
+  grammar::PTS<> pts(&slp);
+  std::cout << "  *** |PTS| = " << sdsl::size_in_bytes(pts) << std::endl;
+  benchmark::RegisterBenchmark("PTS", BM_lookup, pts, queries);
+
+  for (uint32_t block_size : {16, 64, 256}) {
+    grammar::SampledPTS<grammar::SLP<>> sampled_pts(&slp, block_size);
+    auto name = "SampledPTS<" + std::to_string(block_size) + ">";
+    std::cout << "  *** |" << name << "| = " << sdsl::size_in_bytes(sampled_pts) << std::endl;
+
+    benchmark::RegisterBenchmark(name.c_str(), BM_lookup, sampled_pts, queries);
+    benchmark::RegisterBenchmark((name + "_Context").c_str(), BM_lookup_context, sampled_pts, queries);
+  }
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+
+  return 0;
+}
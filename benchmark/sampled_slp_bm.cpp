@@ -0,0 +1,335 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#include <iostream>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <gflags/gflags.h>
+
+#include "grammar/slp.h"
+#include "grammar/slp_helper.h"
+#include "grammar/re_pair.h"
+#include "grammar/sampled_slp.h"
+#include "grammar/cardinality_sketch.h"
+
+#include "allocation_counter.h"
+#include "synthetic_data.h"
+
+
+DEFINE_uint64(n, 1 << 22, "Length of the synthetic sequence.");
+DEFINE_int32(sigma, 64, "Alphabet size of the synthetic sequence.");
+DEFINE_uint32(seed, 17, "Seed of the synthetic sequence.");
+
+
+static void BM_Empty(benchmark::State &state) {
+  for (auto _ : state)
+    std::string empty_string;
+}
+// Register the function as a benchmark
+BENCHMARK(BM_Empty);
+
+
+// Former implementation of ComputeSampledSLPNodes (vectors of children per call), kept as baseline.
+template<typename _SLP, typename _SLPValueType, typename _Predicate, typename _Action>
+std::vector<std::size_t> ComputeSampledSLPNodesRecursive(const _SLP &_slp,
+                                                         std::size_t _curr_var,
+                                                         uint32_t _block_size,
+                                                         std::vector<_SLPValueType> &_nodes,
+                                                         std::size_t &_curr_leaf,
+                                                         const _Predicate &_pred,
+                                                         _Action &&_action) {
+  auto length = _slp.SpanLength(_curr_var);
+  if (length <= _block_size) {
+    return {_curr_leaf++};
+  }
+
+  const auto &children = _slp[_curr_var];
+
+  auto left_children =
+      ComputeSampledSLPNodesRecursive(_slp, children.first, _block_size, _nodes, _curr_leaf, _pred, _action);
+  auto right_children =
+      ComputeSampledSLPNodesRecursive(_slp, children.second, _block_size, _nodes, _curr_leaf, _pred, _action);
+
+  if (_pred(_slp, _curr_var, left_children, right_children) || _curr_var == _slp.Start()) {
+    _nodes.emplace_back(_curr_var);
+    auto new_node = _nodes.size() - 1;
+    _action(_slp, _curr_var, _nodes, new_node, left_children, right_children);
+    return {new_node};
+  } else {
+    left_children.insert(left_children.end(), right_children.begin(), right_children.end());
+    return left_children;
+  }
+}
+
+
+auto BM_compute_nodes = [](benchmark::State &state, const auto &slp, auto compute) {
+  uint32_t block_size = state.range(0);
+  std::size_t max_children = state.range(1);
+
+  // Sample the nodes with too many children
+  auto pred = [max_children](const auto &_slp, auto _var, const auto &_left, const auto &_right) {
+    return max_children < _left.size() + _right.size();
+  };
+
+  std::vector<uint32_t> leaves;
+  grammar::ComputeSampledSLPLeaves(slp, block_size, back_inserter(leaves));
+
+  std::vector<uint32_t> nodes;
+  std::size_t n_allocs = 0;
+  for (auto _ : state) {
+    nodes = leaves;
+
+    auto allocs = benchmark_helper::AllocationCount().load();
+    compute(slp, block_size, nodes, pred);
+    n_allocs += benchmark_helper::AllocationCount().load() - allocs;
+  }
+
+  state.counters["Leaves"] = leaves.size();
+  state.counters["Nodes"] = nodes.size() - leaves.size();
+  state.counters["Allocs"] = double(n_allocs) / state.iterations();
+};
+
+
+auto BM_construct_sampled_slp = [](benchmark::State &state, const auto &slp, auto build_pred) {
+  uint32_t block_size = state.range(0);
+  const float storing_factor = 2;
+
+  std::size_t n_allocs = 0;
+  std::size_t n_sets = 0;
+  for (auto _ : state) {
+    grammar::Chunks<> pts;
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+
+    auto allocs = benchmark_helper::AllocationCount().load();
+    grammar::SampledSLP<> sslp(slp, block_size, add_set, add_set, build_pred(pts, storing_factor));
+    n_allocs += benchmark_helper::AllocationCount().load() - allocs;
+
+    n_sets = pts.size();
+  }
+
+  state.counters["Sets"] = n_sets;
+  state.counters["Allocs"] = double(n_allocs) / state.iterations();
+};
+
+
+auto BM_construct_sampled_slp_sketches = [](benchmark::State &state, const auto &slp) {
+  uint32_t block_size = state.range(0);
+  const float storing_factor = 2;
+
+  std::size_t n_allocs = 0;
+  std::size_t n_sets = 0;
+  for (auto _ : state) {
+    auto allocs = benchmark_helper::AllocationCount().load();
+
+    grammar::CardinalitySketches<> sketches(slp);
+    grammar::Cardinalities cardinalities;
+    grammar::AddCardinality<decltype(sketches)> add_cardinality(sketches, cardinalities);
+    auto pred = grammar::BuildSamplingPredicate(
+        grammar::SketchSetSource<decltype(sketches)>(sketches),
+        grammar::AreChildrenTooBig<grammar::Cardinalities>(cardinalities, storing_factor));
+
+    grammar::SampledSLP<> sslp(slp, block_size, add_cardinality, add_cardinality, pred);
+    n_allocs += benchmark_helper::AllocationCount().load() - allocs;
+
+    n_sets = cardinalities.size();
+  }
+
+  state.counters["Sets"] = n_sets;
+  state.counters["Allocs"] = double(n_allocs) / state.iterations();
+};
+
+
+auto BM_cover_from_bottom = [](benchmark::State &state, const auto &slp, auto sslp) {
+  uint32_t block_size = state.range(0);
+  std::size_t range_length = state.range(1);
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  sslp.Compute(slp, block_size, add_set, add_set,
+               grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)));
+
+  auto length = slp.SpanLength(slp.Start());
+  range_length = std::min<std::size_t>(range_length, length);
+  std::mt19937 gen(FLAGS_seed);
+  std::uniform_int_distribution<std::size_t> dist(0, length - range_length);
+  std::vector<std::size_t> queries(1 << 12);
+  for (auto &item : queries) {
+    item = dist(gen);
+  }
+
+  std::size_t n_nodes = 0;
+  auto report = [&n_nodes](auto _node) {
+    ++n_nodes;
+  };
+
+  std::size_t i = 0;
+  for (auto _ : state) {
+    auto bp = queries[i++ & (queries.size() - 1)];
+    auto range = grammar::ComputeCoverFromBottom(sslp, bp, bp + range_length, report);
+    benchmark::DoNotOptimize(range);
+  }
+
+  state.counters["Nodes"] = double(n_nodes) / state.iterations();
+  state.counters["Size(B)"] = sdsl::size_in_bytes(sslp);
+};
+
+
+auto BM_cover_functor = [](benchmark::State &state, const auto &slp, auto compute) {
+  uint32_t block_size = state.range(0);
+  std::size_t range_length = 1 << 12;
+  std::size_t n_threads = state.range(1);
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  grammar::SampledSLP<> sslp(slp, block_size, add_set, add_set,
+                             grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)));
+
+  auto length = slp.SpanLength(slp.Start());
+  range_length = std::min<std::size_t>(range_length, length);
+  std::mt19937 gen(FLAGS_seed);
+  std::uniform_int_distribution<std::size_t> dist(0, length - range_length);
+  std::vector<std::pair<std::size_t, std::size_t>> intervals(1 << 12);
+  for (auto &item : intervals) {
+    item.first = dist(gen);
+    item.second = item.first + range_length;
+  }
+
+  auto functor = grammar::BuildComputeCoverBottomFunctor(sslp);
+  grammar::ThreadPool pool(n_threads);
+  grammar::CoverArena arena;
+
+  std::size_t n_allocs = 0;
+  for (auto _ : state) {
+    auto allocs = benchmark_helper::AllocationCount().load();
+    compute(functor, intervals, arena, pool);
+    n_allocs += benchmark_helper::AllocationCount().load() - allocs;
+  }
+
+  state.SetItemsProcessed(state.iterations() * intervals.size());
+  state.counters["Allocs"] = double(n_allocs) / (state.iterations() * intervals.size());
+};
+
+
+auto BM_leaves = [](benchmark::State &state, const auto &slp, auto sslp, bool batch) {
+  uint32_t block_size = 16;
+  auto order = state.range(0); // 0: random, 1: sorted, 2: clustered
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  sslp.Compute(slp, block_size, add_set, add_set,
+               grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)));
+
+  auto length = slp.SpanLength(slp.Start());
+  std::mt19937 gen(FLAGS_seed);
+  std::uniform_int_distribution<std::size_t> dist(0, length - 1);
+  std::vector<std::size_t> positions(1 << 14);
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    positions[i] = (order == 2 && i % 16 != 0) ? std::min<std::size_t>(positions[i - 1] + dist(gen) % 64, length - 1) : dist(gen);
+  }
+  if (order == 1) {
+    std::sort(positions.begin(), positions.end());
+  }
+
+  std::vector<std::size_t> leaves(positions.size());
+  for (auto _ : state) {
+    if (batch) {
+      sslp.Leaves(positions.begin(), positions.end(), leaves.begin());
+    } else {
+      for (std::size_t i = 0; i < positions.size(); ++i) {
+        leaves[i] = sslp.Leaf(positions[i]);
+      }
+    }
+    benchmark::DoNotOptimize(leaves.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * positions.size());
+  state.counters["Size(B)"] = sdsl::size_in_bytes(sslp);
+};
+
+
+int main(int argc, char *argv[]) {
+  gflags::AllowCommandLineReparsing();
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+  auto seq = benchmark_helper::GenerateRepetitiveSequence(FLAGS_n, FLAGS_sigma, FLAGS_seed);
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(seq.begin(), seq.end(), encoder, slp);
+  std::cout << "  *** |Seq| = " << seq.size() << ", |SLP| = " << slp.Variables() << std::endl;
+
+  auto compute_recursive = [](const auto &_slp, auto _block_size, auto &_nodes, const auto &_pred) {
+    std::size_t curr_leaf = 0;
+    ComputeSampledSLPNodesRecursive(_slp, _slp.Start(), _block_size, _nodes, curr_leaf, _pred, grammar::NoAction());
+  };
+
+  auto compute = [](const auto &_slp, auto _block_size, auto &_nodes, const auto &_pred) {
+    grammar::ComputeSampledSLPNodes(_slp, _block_size, _nodes, _pred);
+  };
+
+  benchmark::RegisterBenchmark("ComputeSampledSLPNodes_Recursive", BM_compute_nodes, slp, compute_recursive)
+      ->ArgsProduct({{16, 64, 256}, {4, 64}});
+  benchmark::RegisterBenchmark("ComputeSampledSLPNodes", BM_compute_nodes, slp, compute)
+      ->ArgsProduct({{16, 64, 256}, {4, 64}});
+
+  auto must_be_sampled = [](const auto &_pts, auto _storing_factor) {
+    using PTS = std::decay_t<decltype(_pts)>;
+    return grammar::MustBeSampled<PTS>(grammar::AreChildrenTooBig<PTS>(_pts, _storing_factor));
+  };
+
+  auto sampling_predicate = [](const auto &_pts, auto _storing_factor) {
+    using PTS = std::decay_t<decltype(_pts)>;
+    return grammar::BuildSamplingPredicate(grammar::ChildrenSetSource<PTS>(_pts),
+                                           grammar::AreChildrenTooBig<PTS>(_pts, _storing_factor));
+  };
+
+  benchmark::RegisterBenchmark("SampledSLP_MustBeSampled", BM_construct_sampled_slp, slp, must_be_sampled)
+      ->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("SampledSLP_SamplingPredicate", BM_construct_sampled_slp, slp, sampling_predicate)
+      ->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMillisecond);
+
+  benchmark::RegisterBenchmark("SampledSLP_Sketches", BM_construct_sampled_slp_sketches, slp)
+      ->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMillisecond);
+
+  benchmark::RegisterBenchmark("CoverFromBottom_SampledSLP", BM_cover_from_bottom, slp, grammar::SampledSLP<>())
+      ->ArgsProduct({{16, 64}, {1 << 10, 1 << 16}});
+  benchmark::RegisterBenchmark("CoverFromBottom_FlatParents<int_vector>", BM_cover_from_bottom, slp,
+                               grammar::FlatParentsSampledSLP<>())
+      ->ArgsProduct({{16, 64}, {1 << 10, 1 << 16}});
+  benchmark::RegisterBenchmark("CoverFromBottom_FlatParents<vector>", BM_cover_from_bottom, slp,
+                               grammar::FlatParentsSampledSLP<grammar::SampledSLP<>, std::vector<uint32_t>>())
+      ->ArgsProduct({{16, 64}, {1 << 10, 1 << 16}});
+
+  auto compute_single = [](const auto &_functor, const auto &_intervals, auto &_arena, auto &_pool) {
+    for (const auto &interval : _intervals) {
+      auto cover = _functor(interval.first, interval.second);
+      benchmark::DoNotOptimize(cover);
+    }
+  };
+
+  auto compute_batch = [](const auto &_functor, const auto &_intervals, auto &_arena, auto &_pool) {
+    _arena.Clear();
+    _functor.Compute(_intervals.begin(), _intervals.end(), _arena, _pool);
+    benchmark::DoNotOptimize(_arena);
+  };
+
+  benchmark::RegisterBenchmark("CoverBottomFunctor_Single", BM_cover_functor, slp, compute_single)
+      ->ArgsProduct({{16, 64}, {1}})->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("CoverBottomFunctor_Batch", BM_cover_functor, slp, compute_batch)
+      ->ArgsProduct({{16, 64}, {1, 2, 4}})->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+  benchmark::RegisterBenchmark("Leaf_SampledSLP", BM_leaves, slp, grammar::SampledSLP<>(), false)
+      ->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("Leaf_LeafMarks", BM_leaves, slp, grammar::SampledSLP<grammar::SampledLeafMarks<>>(), false)
+      ->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("Leaves_LeafMarks", BM_leaves, slp, grammar::SampledSLP<grammar::SampledLeafMarks<>>(), true)
+      ->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+
+  return 0;
+}
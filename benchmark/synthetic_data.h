@@ -0,0 +1,172 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#ifndef GRAMMAR_BENCHMARK_SYNTHETIC_DATA_H
+#define GRAMMAR_BENCHMARK_SYNTHETIC_DATA_H
+
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <numeric>
+#include <algorithm>
+
+namespace benchmark_helper {
+
+/**
+ * Generate a repetitive sequence over [1..sigma]: each block is either fresh random symbols or a (possibly mutated)
+ * copy of a previous block, so the grammar compresses it into a deep parse tree.
+ *
+ * @param _n Length of the sequence
+ * @param _sigma Alphabet size
+ * @param _seed
+ * @param _copy_prob Probability of copying a previous block
+ * @param _block_length Maximum length of a block
+ */
+inline std::vector<int> GenerateRepetitiveSequence(std::size_t _n,
+                                                   int _sigma,
+                                                   uint32_t _seed,
+                                                   double _copy_prob = 0.9,
+                                                   std::size_t _block_length = 256) {
+  std::vector<int> seq;
+  seq.reserve(_n);
+
+  std::mt19937 gen(_seed);
+  std::uniform_int_distribution<int> symbol_dist(1, _sigma);
+  std::uniform_real_distribution<double> prob_dist(0, 1);
+  std::uniform_int_distribution<std::size_t> length_dist(1, _block_length);
+
+  while (seq.size() < _n) {
+    auto length = std::min(length_dist(gen), _n - seq.size());
+
+    if (seq.size() < length || _copy_prob <= prob_dist(gen)) {
+      for (std::size_t i = 0; i < length; ++i) {
+        seq.push_back(symbol_dist(gen));
+      }
+    } else {
+      std::uniform_int_distribution<std::size_t> pos_dist(0, seq.size() - length);
+      auto pos = pos_dist(gen);
+      for (std::size_t i = 0; i < length; ++i) {
+        // Small mutations
+        seq.push_back(prob_dist(gen) < 0.01 ? symbol_dist(gen) : seq[pos + i]);
+      }
+    }
+  }
+
+  // All the symbols in [1..sigma] must appear
+  for (int c = 1; c <= _sigma && c <= seq.size(); ++c) {
+    seq[c - 1] = c;
+  }
+
+  return seq;
+}
+
+
+/**
+ * Distributions of query positions
+ */
+enum class PositionDistribution {
+  kUniform, // Uniform over the sequence
+  kSequential, // Consecutive positions from a random start (wrapping around)
+  kClustered, // Uniform inside a few random windows
+  kZipfian // Zipfian over the blocks of the sequence (random rank of the blocks), uniform inside each block
+};
+
+inline const char *ToString(PositionDistribution _dist) {
+  switch (_dist) {
+    case PositionDistribution::kUniform: return "Uniform";
+    case PositionDistribution::kSequential: return "Sequential";
+    case PositionDistribution::kClustered: return "Clustered";
+    case PositionDistribution::kZipfian: return "Zipfian";
+  }
+  return "";
+}
+
+/**
+ * Generate query positions in [0, _max_pos]
+ *
+ * @param _dist Distribution
+ * @param _n Number of positions
+ * @param _max_pos Maximum position
+ * @param _seed
+ * @param _stride Distance between consecutive positions (sequential)
+ * @param _window Length of the windows (clustered) and blocks (Zipfian)
+ */
+inline std::vector<std::size_t> GeneratePositions(PositionDistribution _dist,
+                                                  std::size_t _n,
+                                                  std::size_t _max_pos,
+                                                  uint32_t _seed,
+                                                  std::size_t _stride = 1,
+                                                  std::size_t _window = 1 << 12) {
+  std::vector<std::size_t> positions;
+  positions.reserve(_n);
+
+  std::mt19937_64 gen(_seed);
+  std::uniform_int_distribution<std::size_t> pos_dist(0, _max_pos);
+  _window = std::max<std::size_t>(1, std::min(_window, _max_pos + 1));
+
+  switch (_dist) {
+    case PositionDistribution::kUniform: {
+      for (std::size_t i = 0; i < _n; ++i) {
+        positions.emplace_back(pos_dist(gen));
+      }
+      break;
+    }
+
+    case PositionDistribution::kSequential: {
+      auto pos = pos_dist(gen);
+      for (std::size_t i = 0; i < _n; ++i) {
+        positions.emplace_back(pos);
+        pos = (_max_pos - pos < _stride) ? 0 : pos + _stride;
+      }
+      break;
+    }
+
+    case PositionDistribution::kClustered: {
+      const std::size_t kNClusters = 16;
+      std::vector<std::size_t> clusters(kNClusters);
+      std::uniform_int_distribution<std::size_t> begin_dist(0, _max_pos + 1 - _window);
+      for (auto &cluster : clusters) {
+        cluster = begin_dist(gen);
+      }
+
+      std::uniform_int_distribution<std::size_t> cluster_dist(0, kNClusters - 1), offset_dist(0, _window - 1);
+      for (std::size_t i = 0; i < _n; ++i) {
+        positions.emplace_back(clusters[cluster_dist(gen)] + offset_dist(gen));
+      }
+      break;
+    }
+
+    case PositionDistribution::kZipfian: {
+      // At most 2^20 blocks, so the distribution of the ranks stays small
+      const std::size_t kMaxBlocks = 1 << 20;
+      auto block_size = std::max(_window, (_max_pos + kMaxBlocks) / kMaxBlocks);
+      auto n_blocks = (_max_pos + block_size) / block_size;
+
+      const double kExponent = 0.99;
+      std::vector<double> weights(n_blocks);
+      for (std::size_t k = 0; k < n_blocks; ++k) {
+        weights[k] = 1.0 / std::pow(double(k + 1), kExponent);
+      }
+      std::discrete_distribution<std::size_t> rank_dist(weights.begin(), weights.end());
+
+      std::vector<std::size_t> blocks(n_blocks);
+      std::iota(blocks.begin(), blocks.end(), 0);
+      std::shuffle(blocks.begin(), blocks.end(), gen);
+
+      std::uniform_int_distribution<std::size_t> offset_dist(0, block_size - 1);
+      for (std::size_t i = 0; i < _n; ++i) {
+        auto pos = blocks[rank_dist(gen)] * block_size + offset_dist(gen);
+        positions.emplace_back(std::min(pos, _max_pos));
+      }
+      break;
+    }
+  }
+
+  return positions;
+}
+
+}
+
+#endif //GRAMMAR_BENCHMARK_SYNTHETIC_DATA_H
@@ -7,6 +7,10 @@
 
 #include <vector>
 #include <algorithm>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <functional>
 
 
 namespace grammar {
@@ -345,6 +349,175 @@ class MergeSetsBinaryTreeFunctor {
   }
 };
 
+
+/**
+ * Merge (union without duplicates) k sorted ranges in one pass using a min-heap of cursors.
+ *
+ * The ranges are given as pairs of iterators [first, last) and are used as cursors, so they are modified.
+ *
+ * @tparam _RangesIt Random access iterator to pairs of iterators
+ * @tparam _OI Output iterator
+ * @param _first
+ * @param _last
+ * @param _result
+ * @return output iterator past the last written element
+ */
+template<typename _RangesIt, typename _OI>
+_OI MergeRangesKWay(_RangesIt _first, _RangesIt _last, _OI _result) {
+  _last = std::remove_if(_first, _last, [](const auto &_range) { return _range.first == _range.second; });
+
+  if (_first == _last)
+    return _result;
+
+  if (std::next(_first) == _last)
+    return std::copy(_first->first, _first->second, _result);
+
+  auto greater = [](const auto &_r1, const auto &_r2) { return *_r2.first < *_r1.first; };
+  std::make_heap(_first, _last, greater);
+
+  auto prev = *_first->first;
+  *_result = prev;
+  ++_result;
+
+  while (_first != _last) {
+    std::pop_heap(_first, _last, greater);
+    auto &range = *std::prev(_last);
+
+    auto value = *range.first;
+    if (prev < value) {
+      *_result = value;
+      ++_result;
+      prev = value;
+    }
+
+    if (++range.first == range.second) {
+      --_last;
+    } else {
+      std::push_heap(_first, _last, greater);
+    }
+  }
+
+  return _result;
+}
+
+
+template<typename _II, typename _Sets, typename _Result>
+void MergeSetsKWay(_II _first, _II _last, const _Sets &_sets, _Result &_result) {
+  using SetRef = decltype(_sets[*_first]);
+  using Set = std::decay_t<SetRef>;
+  using Iterator = decltype(std::declval<const Set &>().begin());
+
+  // Keep the sets alive during the merge: copies only when they are returned by value
+  using Holder = std::conditional_t<std::is_lvalue_reference<SetRef>::value, std::reference_wrapper<const Set>, Set>;
+  std::vector<Holder> sets;
+  sets.reserve(std::distance(_first, _last));
+  std::vector<std::pair<Iterator, Iterator>> ranges;
+  ranges.reserve(std::distance(_first, _last));
+  for (auto it = _first; it != _last; ++it) {
+    sets.emplace_back(_sets[*it]);
+    const Set &set = sets.back();
+    ranges.emplace_back(set.begin(), set.end());
+  }
+
+  _Result merged;
+  MergeRangesKWay(ranges.begin(), ranges.end(), back_inserter(merged));
+
+  if (_result.empty()) {
+    _result.swap(merged);
+    return;
+  }
+
+  _Result tmp_result(_result.size() + merged.size());
+  auto last_it = std::set_union(_result.begin(), _result.end(), merged.begin(), merged.end(), tmp_result.begin());
+  tmp_result.resize(last_it - tmp_result.begin());
+  _result.swap(tmp_result);
+}
+
+
+class MergeSetsKWayFunctor {
+ public:
+  template<typename _II, typename _Sets, typename _Result, typename _SetUnion>
+  inline void operator()(_II _first,
+                         _II _last,
+                         const _Sets &_sets,
+                         _Result &_result,
+                         const _SetUnion &) const {
+    MergeSetsKWay(_first, _last, _sets, _result);
+  }
+};
+
+
+/**
+ * Sets Buffer
+ *
+ * Holds a group of sets decoded in bulk into one contiguous buffer, which is reused between calls to avoid
+ * allocations. The sets container must provide ChunkLength(i) and Decode(i, out).
+ *
+ * @tparam _Value
+ */
+template<typename _Value = uint32_t>
+class SetsBuffer {
+ public:
+  class Set {
+   public:
+    Set(const _Value *_first, const _Value *_last) : first_(_first), last_(_last) {}
+
+    const _Value *begin() const {
+      return first_;
+    }
+
+    const _Value *end() const {
+      return last_;
+    }
+
+    std::size_t size() const {
+      return last_ - first_;
+    }
+
+   private:
+    const _Value *first_;
+    const _Value *last_;
+  };
+
+  /**
+   * Decode the sets with ids in [_first, _last). Previous sets are discarded.
+   */
+  template<typename _II, typename _Sets>
+  void Decode(_II _first, _II _last, const _Sets &_sets) {
+    offsets_.clear();
+    offsets_.push_back(0);
+
+    for (auto it = _first; it != _last; ++it) {
+      auto begin = offsets_.back();
+      auto end = begin + _sets.ChunkLength(*it);
+      if (values_.size() < end) {
+        values_.resize(2 * end);
+      }
+
+      _sets.Decode(*it, values_.data() + begin);
+      offsets_.push_back(end);
+    }
+  }
+
+  /**
+   * Get the k-th decoded set
+   */
+  Set operator[](std::size_t k) const {
+    return Set(values_.data() + offsets_[k], values_.data() + offsets_[k + 1]);
+  }
+
+  /**
+   * Get number of decoded sets
+   */
+  std::size_t size() const {
+    return offsets_.size() - 1;
+  }
+
+ private:
+  std::vector<_Value> values_;
+  std::vector<std::size_t> offsets_ = {0};
+};
+
 }
 
 #endif //GRAMMAR_COMPLETE_TREE_H
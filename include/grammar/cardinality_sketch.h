@@ -0,0 +1,306 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#ifndef GRAMMAR_CARDINALITY_SKETCH_H
+#define GRAMMAR_CARDINALITY_SKETCH_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+
+namespace grammar {
+
+/**
+ * Hash of a value into 64 bits (SplitMix64 finalizer)
+ */
+inline uint64_t HashValue(uint64_t _value) {
+  _value += 0x9e3779b97f4a7c15ULL;
+  _value = (_value ^ (_value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  _value = (_value ^ (_value >> 27)) * 0x94d049bb133111ebULL;
+  return _value ^ (_value >> 31);
+}
+
+
+/**
+ * Estimate the number of distinct elements from the sorted k minimum values (KMV) of their hashes.
+ * It is exact when there are fewer than k values.
+ */
+template<typename _II>
+double EstimateCardinality(_II _first, _II _last, std::size_t _k) {
+  std::size_t n = std::distance(_first, _last);
+  if (n < _k)
+    return n;
+
+  auto kth = *std::next(_first, _k - 1);
+  return (_k - 1) * (18446744073709551616.0L / ((long double) kth + 1));
+}
+
+
+/**
+ * Cardinality
+ *
+ * Set-like object that only knows its size, used where the predicates need set sizes.
+ */
+class Cardinality {
+ public:
+  Cardinality(std::size_t _size = 0) : size_(_size) {}
+
+  std::size_t size() const {
+    return size_;
+  }
+
+ private:
+  std::size_t size_;
+};
+
+
+/**
+ * K Minimum Values Sketch
+ *
+ * Mergeable sketch of the number of distinct elements of a set: it keeps the k smallest hashes of the elements
+ * (at most k * 8 bytes).
+ *
+ * @tparam __k Number of kept values
+ */
+template<std::size_t __k = 64>
+class KMVSketch {
+ public:
+  KMVSketch() = default;
+
+  void Insert(uint64_t _value) {
+    auto hash = HashValue(_value);
+    auto it = std::lower_bound(hashes_.begin(), hashes_.end(), hash);
+    if (it != hashes_.end() && *it == hash)
+      return;
+
+    if (hashes_.size() < __k) {
+      hashes_.insert(it, hash);
+    } else if (it != hashes_.end()) {
+      hashes_.insert(it, hash);
+      hashes_.pop_back();
+    }
+  }
+
+  void Merge(const KMVSketch<__k> &_sketch) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(__k);
+    MergeHashes(hashes_.begin(), hashes_.end(),
+                _sketch.hashes_.begin(), _sketch.hashes_.end(),
+                back_inserter(hashes), __k);
+    hashes_.swap(hashes);
+  }
+
+  /**
+   * Get the estimated number of distinct elements
+   */
+  std::size_t size() const {
+    return EstimateCardinality(hashes_.begin(), hashes_.end(), __k) + 0.5;
+  }
+
+  const auto &GetHashes() const {
+    return hashes_;
+  }
+
+  /**
+   * Merge (union) two sorted sequences of hashes keeping at most _k values
+   */
+  template<typename _II1, typename _II2, typename _OI>
+  static _OI MergeHashes(_II1 _first1, _II1 _last1, _II2 _first2, _II2 _last2, _OI _out, std::size_t _k) {
+    std::size_t n = 0;
+    while (n < _k && (_first1 != _last1 || _first2 != _last2)) {
+      if (_first2 == _last2 || (_first1 != _last1 && *_first1 < *_first2)) {
+        *_out = *_first1++;
+      } else if (_first1 == _last1 || *_first2 < *_first1) {
+        *_out = *_first2++;
+      } else {
+        *_out = *_first1++;
+        ++_first2;
+      }
+      ++_out;
+      ++n;
+    }
+
+    return _out;
+  }
+
+ private:
+  std::vector<uint64_t> hashes_; // Sorted
+};
+
+
+/**
+ * Cardinality Sketches
+ *
+ * KMV sketch of the set of distinct terminals of each variable of an SLP, computed bottom-up in one pass over the
+ * rules (the sketch of a rule is the merge of the sketches of its right-hand side). Sketches are stored contiguously,
+ * using at most k hashes per variable.
+ *
+ * @tparam __k Number of kept values per sketch
+ */
+template<std::size_t __k = 64>
+class CardinalitySketches {
+ public:
+  CardinalitySketches() = default;
+
+  template<typename _SLP>
+  CardinalitySketches(const _SLP &_slp) {
+    Compute(_slp);
+  }
+
+  template<typename _SLP>
+  void Compute(const _SLP &_slp) {
+    hashes_.clear();
+    offsets_.clear();
+    offsets_.reserve(_slp.Variables() + 2);
+
+    offsets_.push_back(0);
+    offsets_.push_back(0); // Variable 0 is not used
+
+    std::size_t i = 1;
+    for (; i <= _slp.Sigma(); ++i) {
+      hashes_.push_back(HashValue(i));
+      offsets_.push_back(hashes_.size());
+    }
+
+    for (; i <= _slp.Variables(); ++i) {
+      const auto &right_hand = _slp[i];
+
+      // Resize first, so the iterators stay valid during the merge
+      auto first = hashes_.size();
+      hashes_.resize(first + __k);
+
+      auto lb = offsets_[right_hand.first], le = offsets_[right_hand.first + 1];
+      auto rb = offsets_[right_hand.second], re = offsets_[right_hand.second + 1];
+      auto last = KMVSketch<__k>::MergeHashes(hashes_.begin() + lb,
+                                              hashes_.begin() + le,
+                                              hashes_.begin() + rb,
+                                              hashes_.begin() + re,
+                                              hashes_.begin() + first,
+                                              __k);
+
+      hashes_.resize(last - hashes_.begin());
+      offsets_.push_back(hashes_.size());
+    }
+
+    hashes_.shrink_to_fit();
+  }
+
+  /**
+   * Get the estimated number of distinct terminals of variable i
+   */
+  std::size_t Estimate(std::size_t i) const {
+    assert(0 < i && i + 1 < offsets_.size());
+
+    return EstimateCardinality(hashes_.begin() + offsets_[i], hashes_.begin() + offsets_[i + 1], __k) + 0.5;
+  }
+
+  /**
+   * Get the cardinality (set-like object with size) of variable i
+   */
+  Cardinality operator[](std::size_t i) const {
+    return Cardinality(Estimate(i));
+  }
+
+  std::size_t Variables() const {
+    return offsets_.size() - 2;
+  }
+
+ private:
+  std::vector<uint64_t> hashes_;
+  std::vector<std::size_t> offsets_;
+};
+
+
+/**
+ * Set Source from Cardinality Sketches
+ *
+ * Set source for SamplingPredicate that only provides the estimated size of the set of a variable, so the sampling
+ * can be decided without materializing exact sets.
+ *
+ * @tparam _Sketches
+ */
+template<typename _Sketches>
+class SketchSetSource {
+ public:
+  typedef Cardinality Set;
+
+  SketchSetSource(const _Sketches &_sketches) : sketches_(_sketches) {}
+
+  template<typename _SLP, typename _Children>
+  void operator()(const _SLP &_slp, std::size_t _var, const _Children &, const _Children &, Set &_set) const {
+    _set = sketches_[_var];
+  }
+
+ private:
+  const _Sketches &sketches_;
+};
+
+
+/**
+ * Cardinalities of the nodes of a sampled tree
+ *
+ * Container of set sizes that can replace a PTS in the size-based predicates (e.g. AreChildrenTooBig). It is filled by
+ * the AddCardinality action.
+ */
+class Cardinalities {
+ public:
+  void Insert(std::size_t _size) {
+    sizes_.push_back(_size);
+  }
+
+  /**
+   * Get the cardinality of node i (starting at 1, as in Chunks)
+   */
+  Cardinality operator[](std::size_t i) const {
+    return Cardinality(sizes_[i - 1]);
+  }
+
+  std::size_t size() const {
+    return sizes_.size();
+  }
+
+ private:
+  std::vector<std::size_t> sizes_;
+};
+
+
+/**
+ * Add Cardinality Action
+ *
+ * Leaf and node action that stores the estimated cardinality of each node of the sampled tree.
+ *
+ * @tparam _Sketches
+ */
+template<typename _Sketches>
+class AddCardinality {
+ public:
+  AddCardinality(const _Sketches &_sketches, Cardinalities &_cardinalities)
+      : sketches_(_sketches), cardinalities_(_cardinalities) {}
+
+  template<typename _SLP>
+  void operator()(const _SLP &_slp, std::size_t _curr_var) {
+    cardinalities_.Insert(sketches_.Estimate(_curr_var));
+  }
+
+  template<typename _SLP, typename _Nodes, typename _RangeContainer>
+  void operator()(const _SLP &_slp,
+                  std::size_t _curr_var,
+                  const _Nodes &_nodes,
+                  std::size_t _new_node,
+                  const _RangeContainer &_left_ranges,
+                  const _RangeContainer &_right_ranges) {
+    (*this)(_slp, _curr_var);
+  }
+
+ private:
+  const _Sketches &sketches_;
+  Cardinalities &cardinalities_;
+};
+
+}
+
+#endif //GRAMMAR_CARDINALITY_SKETCH_H
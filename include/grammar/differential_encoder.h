@@ -0,0 +1,239 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#ifndef GRAMMAR_DIFFERENTIAL_ENCODER_H
+#define GRAMMAR_DIFFERENTIAL_ENCODER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <limits>
+#include <istream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "slp.h"
+#include "slp_helper.h"
+#include "re_pair.h"
+#include "incremental_slp.h"
+#include "differential_slp.h"
+
+
+namespace grammar {
+
+/**
+ * Differential reader of a raw integer series
+ *
+ * Reads a binary series of integers of type _T in chunks and reports their differences: the first difference is 0
+ * (the first value is kept apart, see First), so the values are First() plus the prefix sums of the differences.
+ *
+ * @tparam _T Type of the integers of the series
+ */
+template<typename _T = int32_t>
+class DifferentialReader {
+ public:
+  explicit DifferentialReader(std::istream &_in) : in_(_in) {}
+
+  /**
+   * Read the differences of the next (at most) _n values
+   *
+   * @param _diffs Differences (cleared)
+   * @return false if there are no more values
+   */
+  bool Read(std::size_t _n, std::vector<int64_t> &_diffs) {
+    _diffs.clear();
+    buffer_.resize(_n);
+    in_.read(reinterpret_cast<char *>(buffer_.data()), _n * sizeof(_T));
+    std::size_t n = in_.gcount() / sizeof(_T);
+
+    for (std::size_t i = 0; i < n; ++i) {
+      if (size_ == 0) {
+        first_ = buffer_[i];
+        prev_ = buffer_[i];
+      }
+
+      int64_t diff = int64_t(buffer_[i]) - int64_t(prev_);
+      prev_ = buffer_[i];
+      ++size_;
+
+      min_ = std::min(min_, diff);
+      max_ = std::max(max_, diff);
+      _diffs.emplace_back(diff);
+    }
+
+    return 0 < n;
+  }
+
+  /**
+   * Get the number of values read
+   */
+  std::size_t Size() const {
+    return size_;
+  }
+
+  /**
+   * Get the first value of the series
+   */
+  _T First() const {
+    return first_;
+  }
+
+  /**
+   * Get the minimum difference read
+   */
+  int64_t Min() const {
+    return min_;
+  }
+
+  /**
+   * Get the maximum difference read
+   */
+  int64_t Max() const {
+    return max_;
+  }
+
+ private:
+  std::istream &in_;
+  std::vector<_T> buffer_;
+
+  std::size_t size_ = 0;
+  _T first_ = 0;
+  _T prev_ = 0;
+  int64_t min_ = 0;
+  int64_t max_ = 0;
+};
+
+
+/**
+ * Information of a compressed series
+ */
+struct SeriesInfo {
+  std::size_t size = 0; // Number of values
+  int64_t first = 0; // First value
+  int64_t min = 0; // Minimum difference
+  int64_t max = 0; // Maximum difference
+  std::size_t diff_base = 0; // Differential base of the terminals (terminal = difference + diff_base)
+};
+
+
+/**
+ * Compress a raw integer series into a differential SLP, reading it in one pass
+ *
+ * If _chunk_size is 0 or the series fits in one chunk, the differences are computed while the series is read and the
+ * whole differential sequence is encoded with RePair (the differential base is its minimum). Otherwise, each chunk is
+ * appended to an IncrementalSLP (see IncrementalSLP::Append), so RePair works on one chunk at a time; the alphabet of
+ * the terminals must be fixed in advance, so the differences must be in [-_max_diff, _max_diff].
+ *
+ * The values of the series are info.first + _dslp.ValueAt(i).
+ *
+ * @tparam _T Type of the integers of the series
+ * @param _in Binary series
+ * @param _dslp Differential SLP (e.g., DifferentialSLP<>)
+ * @param _max_span_length Maximum length of sampled intervals
+ * @param _chunk_size Number of values per chunk (0 for the whole series)
+ * @param _max_diff Maximum absolute difference (for chunks)
+ * @param _n_threads Number of threads to compute the span sums
+ *
+ * @return information of the series
+ */
+template<typename _T = int32_t, typename _DSLP>
+SeriesInfo CompressSeries(std::istream &_in,
+                          _DSLP &_dslp,
+                          std::size_t _max_span_length,
+                          std::size_t _chunk_size = 0,
+                          std::size_t _max_diff = 0,
+                          std::size_t _n_threads = 1) {
+  const std::size_t kReadSize = 1 << 16;
+
+  DifferentialReader<_T> reader(_in);
+  SeriesInfo info;
+
+  // Terminals of the differences [_first, _last)
+  auto to_terminals = [&info](auto _first, auto _last, std::vector<int> &_terminals) {
+    _terminals.resize(std::distance(_first, _last));
+    std::transform(_first, _last, _terminals.begin(), [&info](int64_t _diff) {
+      return int(_diff + int64_t(info.diff_base));
+    });
+  };
+
+  std::vector<int64_t> diffs, chunk;
+  auto read_size = (_chunk_size == 0) ? kReadSize : _chunk_size;
+  while (reader.Read(read_size, chunk)) {
+    diffs.insert(diffs.end(), chunk.begin(), chunk.end());
+    if (0 < _chunk_size && _chunk_size < diffs.size())
+      break;
+  }
+
+  if (diffs.empty())
+    throw std::invalid_argument("Empty series");
+
+  std::vector<int> terminals;
+  if (diffs.size() <= _chunk_size || _chunk_size == 0) {
+    // Whole series
+    if (std::numeric_limits<int>::max() / 2 < reader.Max() - reader.Min())
+      throw std::overflow_error("Differences of the series out of the range of RePair symbols");
+    info.diff_base = 1 - reader.Min(); // Terminals >= 1
+
+    to_terminals(diffs.begin(), diffs.end(), terminals);
+    std::vector<int64_t>().swap(diffs);
+
+    SLP<> slp;
+    std::vector<std::size_t> compact_seq;
+    {
+      RePairEncoder<false> encoder;
+      auto slp_wrapper = BuildSLPWrapper(slp);
+      auto report_compact_seq = [&compact_seq](const auto &_var) {
+        compact_seq.emplace_back(_var);
+      };
+      encoder.Encode(terminals.begin(), terminals.end(), slp_wrapper, report_compact_seq);
+    }
+    std::vector<int>().swap(terminals);
+
+    _dslp.Compute(reader.Size(), slp, compact_seq, info.diff_base, _max_span_length, _n_threads);
+  } else {
+    // Chunks over a fixed alphabet: terminals in [1, 2 * _max_diff + 1]
+    if (_chunk_size < 2)
+      throw std::invalid_argument("Chunks must have at least two values");
+    if (std::numeric_limits<int>::max() / 2 < _max_diff)
+      throw std::overflow_error("Maximum difference out of the range of RePair symbols");
+    info.diff_base = _max_diff + 1;
+
+    IncrementalSLP<> slp(2 * _max_diff + 1);
+    RePairEncoder<false> encoder;
+    auto append = [&](auto _first, auto _last) {
+      auto out = std::find_if(_first, _last, [_max_diff](int64_t _diff) {
+        return int64_t(_max_diff) < std::abs(_diff);
+      });
+      if (out != _last)
+        throw std::out_of_range("Difference " + std::to_string(*out) + " out of [-max_diff, max_diff]");
+
+      to_terminals(_first, _last, terminals);
+      slp.Append(terminals.begin(), terminals.end(), encoder);
+    };
+
+    // The first chunks were already read
+    for (std::size_t i = 0; i < diffs.size(); i += _chunk_size) {
+      append(diffs.begin() + i, diffs.begin() + std::min(i + _chunk_size, diffs.size()));
+    }
+    std::vector<int64_t>().swap(diffs);
+
+    while (reader.Read(_chunk_size, chunk)) {
+      append(chunk.begin(), chunk.end());
+    }
+
+    _dslp.Compute(reader.Size(), slp, slp.GetSegments(), info.diff_base, _max_span_length, _n_threads);
+  }
+
+  info.size = reader.Size();
+  info.first = reader.First();
+  info.min = reader.Min();
+  info.max = reader.Max();
+
+  return info;
+}
+
+}
+
+#endif //GRAMMAR_DIFFERENTIAL_ENCODER_H
@@ -5,24 +5,45 @@
 #ifndef GRAMMAR_DIFFERENTIAL_SLP_H_
 #define GRAMMAR_DIFFERENTIAL_SLP_H_
 
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) && defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
 #include <sdsl/bit_vectors.hpp>
 
 #include <grammar/slp.h>
+#include <grammar/parallel.h>
+#include <grammar/slp_aggregates.h>
 
 namespace grammar {
+/**
+ * Bit-compress the given container, if it supports it (sdsl::int_vector<>)
+ */
+template<typename V>
+void Compress(V &_v) {
+}
+
+inline void Compress(sdsl::int_vector<> &_v) {
+  sdsl::util::bit_compress(_v);
+}
+
 template<typename SLP, typename ReportSpanSum>
 auto ComputeSpanSums(const SLP &_slp, std::size_t _diff_base, ReportSpanSum &_report_span_sum) {
-  auto rules = _slp.GetRules();
+  auto sigma = _slp.Sigma();
+  std::size_t n_rules = _slp.Variables() - sigma;
+
   std::vector<int64_t> cover_sums;
-  cover_sums.reserve(rules.size());
+  cover_sums.reserve(n_rules);
 
-  auto sigma = _slp.Sigma();
   auto get_cover_sum = [&_slp, &_diff_base, &cover_sums, &sigma](auto _var) {
     return _slp.IsTerminal(_var) ? (_var - _diff_base) : (cover_sums[_var - sigma - 1]);
   };
 
   // Compute cover sum for each non-terminal
-  for (std::size_t i = 0, j = sigma + 1; i < rules.size() / 2; ++i, ++j) {
+  for (std::size_t i = 0, j = sigma + 1; i < n_rules; ++i, ++j) {
     auto children = _slp[j];
     cover_sums.emplace_back(get_cover_sum(children.first) + get_cover_sum(children.second));
   }
@@ -37,6 +58,101 @@ auto ComputeSpanSums(const SLP &_slp, std::size_t _diff_base, ReportSpanSum &_re
   return std::make_pair(*minmax.first, *minmax.second);
 }
 
+/**
+ * Compute the span sum of each non-terminal directly into _span_sums (variable v at v - sigma - 1), shifted by the
+ * differential base of the sums (|min| if the minimum sum is negative), and bit-compress it.
+ *
+ * The sums are first stored as 64-bit two's complement words, so no temporary vector is needed. With several threads,
+ * the rules are processed level by level: rules of the same height only depend on lower rules, so each level is
+ * computed in parallel.
+ *
+ * @return minimum and maximum span sums (without the differential base of the sums)
+ */
+template<typename SLP>
+std::pair<int64_t, int64_t> ComputeSpanSums(const SLP &_slp,
+                                            std::size_t _diff_base,
+                                            sdsl::int_vector<> &_span_sums,
+                                            std::size_t _n_threads = 1) {
+  const std::size_t sigma = _slp.Sigma();
+  const std::size_t n_rules = _slp.Variables() - sigma;
+
+  _span_sums = sdsl::int_vector<>(n_rules, 0, 64);
+  if (n_rules == 0)
+    return std::make_pair(0, 0);
+
+  auto get_span_sum = [&_slp, &_diff_base, &_span_sums, sigma](std::size_t _var) -> int64_t {
+    return _slp.IsTerminal(_var) ? (int64_t(_var) - int64_t(_diff_base)) : int64_t(_span_sums[_var - sigma - 1]);
+  };
+
+  auto compute = [&_slp, &_span_sums, &get_span_sum, sigma](std::size_t _var) {
+    auto children = _slp[_var];
+    _span_sums[_var - sigma - 1] = uint64_t(get_span_sum(children.first) + get_span_sum(children.second));
+  };
+
+  if (_n_threads <= 1) {
+    for (std::size_t var = sigma + 1; var <= sigma + n_rules; ++var) {
+      compute(var);
+    }
+  } else {
+    // Sort the rules by height (counting sort)
+    std::vector<uint32_t> heights(n_rules);
+    auto get_height = [&heights, sigma](std::size_t _var) -> uint32_t {
+      return _var <= sigma ? 0 : heights[_var - sigma - 1];
+    };
+
+    std::vector<std::size_t> levels(1, 0);
+    for (std::size_t i = 0; i < n_rules; ++i) {
+      auto children = _slp[sigma + i + 1];
+      heights[i] = std::max(get_height(children.first), get_height(children.second)) + 1;
+      if (levels.size() <= heights[i]) {
+        levels.resize(heights[i] + 1, 0);
+      }
+      ++levels[heights[i]];
+    }
+
+    levels[0] = 0; // levels[h - 1] is the first rule of height h
+    for (std::size_t h = 1; h < levels.size(); ++h) {
+      levels[h] += levels[h - 1];
+    }
+
+    std::vector<uint32_t> rules(n_rules);
+    {
+      std::vector<std::size_t> next(levels.begin(), levels.end() - 1);
+      for (std::size_t i = 0; i < n_rules; ++i) {
+        rules[next[heights[i] - 1]++] = sigma + i + 1;
+      }
+    }
+    std::vector<uint32_t>().swap(heights);
+
+    const std::size_t kBlockSize = 1 << 12;
+    ThreadPool pool(_n_threads);
+    for (std::size_t h = 1; h < levels.size(); ++h) {
+      auto first = levels[h - 1], last = levels[h];
+      pool.ParallelFor((last - first + kBlockSize - 1) / kBlockSize, [&](std::size_t _block) {
+        auto block_last = std::min(first + (_block + 1) * kBlockSize, last);
+        for (auto i = first + _block * kBlockSize; i < block_last; ++i) {
+          compute(rules[i]);
+        }
+      });
+    }
+  }
+
+  int64_t min = int64_t(_span_sums[0]), max = min;
+  for (std::size_t i = 1; i < n_rules; ++i) {
+    auto sum = int64_t(_span_sums[i]);
+    min = std::min(min, sum);
+    max = std::max(max, sum);
+  }
+
+  uint64_t diff_base_sums = min < 0 ? -min : 0;
+  for (std::size_t i = 0; i < n_rules; ++i) {
+    _span_sums[i] = _span_sums[i] + diff_base_sums;
+  }
+  sdsl::util::bit_compress(_span_sums);
+
+  return std::make_pair(min, max);
+}
+
 template<typename CompactSeq, typename SLP, typename GetSpanSum, typename ReportSample>
 void ComputeSamplesOnCompactSequence(const CompactSeq &_compact_seq,
                                      const SLP &_slp,
@@ -67,75 +183,674 @@ void ComputeSamplesOnCompactSequence(const CompactSeq &_compact_seq,
   }
 }
 
-/*
-template<typename SLP, typename CompactSeq, typename DifferentialBase, typename ReportCoverSum, typename ReportAccumulatedSum>
-void ComputeCoverSumsAndSampleSum(const SLP &_slp,
-                                  const CompactSeq &_compact_seq,
-                                  const DifferentialBase &_diff_base,
-                                  ReportCoverSum &_report_cover_sum,
-                                  ReportAccumulatedSum &_report_acc_sum) {
-  auto rules = _slp.GetRules();
-  std::vector<int64_t> cover_sums(rules.size());
+/**
+ * Compute the samples of several sampling intervals in one pass over the compact sequence. The samples of each
+ * interval are the same as those of ComputeSamplesOnCompactSequence.
+ *
+ * @param _max_span_lengths Maximum lengths of sampled intervals
+ * @param _report Reporter of samples: _report(k, pos, sum, root_pos), where k is the index of the interval length
+ */
+template<typename CompactSeq, typename SLP, typename GetSpanSum, typename ReportSample>
+void ComputeSamplesOnCompactSequence(const CompactSeq &_compact_seq,
+                                     const SLP &_slp,
+                                     const GetSpanSum &_get_span_sum,
+                                     const std::vector<std::size_t> &_max_span_lengths,
+                                     const ReportSample &_report) {
+  assert(0 < _compact_seq.size());
 
-  auto sigma = _slp.Sigma();
-  uint32_t diff_base = 0; // It is not considered for partial sums in each variable.
-  auto get_cover_sum = [&_slp, &diff_base, &cover_sums, &sigma](auto _var) {
-    return _slp.IsTerminal(_var) ? (_var - diff_base) : (cover_sums[_var - sigma - 1]
-        - _slp.SpanLength(_var) * diff_base);
+  std::vector<std::size_t> range_span_lengths(_max_span_lengths.size(), 0);
+
+  std::size_t pos = 0;
+  int64_t sum = 0;
+  for (std::size_t i = 0; i < _compact_seq.size(); ++i) {
+    auto root_span_length = _slp.SpanLength(_compact_seq[i]);
+
+    for (std::size_t k = 0; k < _max_span_lengths.size(); ++k) {
+      if (i == 0 || _max_span_lengths[k] < range_span_lengths[k] + root_span_length) {
+        _report(k, pos, sum, i);
+        range_span_lengths[k] = 0;
+      }
+      range_span_lengths[k] += root_span_length;
+    }
+
+    pos += root_span_length;
+    sum += _get_span_sum(_compact_seq[i]);
+  }
+}
+
+/**
+ * Samples of a differential SLP (see ComputeSamplesOnCompactSequence): marks of the sampled positions, value before
+ * each sampled position and index of its first root.
+ */
+template<typename Values = sdsl::int_vector<>,
+    typename RootsPos = sdsl::int_vector<>,
+    typename BitVector = sdsl::sd_vector<>,
+    typename BitVectorRank = typename BitVector::rank_1_type,
+    typename BitVectorSelect = typename BitVector::select_1_type>
+class DifferentialSLPSamples {
+ public:
+  DifferentialSLPSamples() = default;
+
+  template<typename CompactSeq, typename SLP, typename GetSpanSum>
+  DifferentialSLPSamples(std::size_t _seq_size,
+                         const CompactSeq &_compact_seq,
+                         const SLP &_slp,
+                         const GetSpanSum &_get_span_sum,
+                         std::size_t _max_span_length) {
+    Compute(_seq_size, _compact_seq, _slp, _get_span_sum, _max_span_length);
+  }
+
+  DifferentialSLPSamples(const DifferentialSLPSamples &_samples)
+      : values_(_samples.values_), roots_pos_(_samples.roots_pos_), positions_(_samples.positions_) {
+    BindSupports();
+  }
+
+  DifferentialSLPSamples &operator=(const DifferentialSLPSamples &_samples) {
+    values_ = _samples.values_;
+    roots_pos_ = _samples.roots_pos_;
+    positions_ = _samples.positions_;
+    BindSupports();
+    return *this;
+  }
+
+  template<typename CompactSeq, typename SLP, typename GetSpanSum>
+  void Compute(std::size_t _seq_size,
+               const CompactSeq &_compact_seq,
+               const SLP &_slp,
+               const GetSpanSum &_get_span_sum,
+               std::size_t _max_span_length) {
+    sdsl::bit_vector tmp_positions(_seq_size, 0);
+    std::vector<std::size_t> tmp_values;
+    std::vector<std::size_t> tmp_roots_pos;
+    auto report_sample = [&tmp_positions, &tmp_values, &tmp_roots_pos](auto _pos, auto _sum, auto _root_pos) {
+      tmp_positions[_pos] = 1;
+      tmp_values.emplace_back(_sum);
+      tmp_roots_pos.emplace_back(_root_pos);
+    };
+
+    ComputeSamplesOnCompactSequence(_compact_seq, _slp, _get_span_sum, _max_span_length, report_sample);
+
+    Construct(values_, tmp_values);
+    Compress(values_);
+    Construct(roots_pos_, tmp_roots_pos);
+    Compress(roots_pos_);
+    Construct(positions_, tmp_positions);
+    BindSupports();
+  }
+
+  auto Sample(std::size_t _pos) const {
+    return positions_rank_(_pos + 1);
+  }
+
+  auto SamplePosition(std::size_t _sample) const {
+    return positions_select_(_sample);
+  }
+
+  auto SampleFirstRoot(std::size_t _sample) const {
+    return roots_pos_[_sample - 1];
+  }
+
+  auto SampleValue(std::size_t _sample) const {
+    assert(0 < _sample);
+    return values_[_sample - 1];
+  }
+
+  std::size_t size() const {
+    return values_.size();
+  }
+
+  const Values &GetValues() const {
+    return values_;
+  }
+
+  const RootsPos &GetRootsPositions() const {
+    return roots_pos_;
+  }
+
+  const BitVector &GetPositions() const {
+    return positions_;
+  }
+
+  const BitVectorRank &GetPositionsRank() const {
+    return positions_rank_;
+  }
+
+  const BitVectorSelect &GetPositionsSelect() const {
+    return positions_select_;
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += sdsl::serialize(values_, out);
+    written_bytes += sdsl::serialize(roots_pos_, out);
+    written_bytes += sdsl::serialize(positions_, out);
+    written_bytes += sdsl::serialize(positions_rank_, out);
+    written_bytes += sdsl::serialize(positions_select_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(values_, in);
+    sdsl::load(roots_pos_, in);
+    positions_.load(in);
+    positions_rank_.load(in, &positions_);
+    positions_select_.load(in, &positions_);
+  }
+
+ private:
+  Values values_; // Values at sampled positions.
+  RootsPos roots_pos_; // Position of the first root for each sample interval.
+  BitVector positions_; // Marks sampled positions in the original sequence.
+  BitVectorRank positions_rank_;
+  BitVectorSelect positions_select_;
+
+  void BindSupports() {
+    positions_rank_ = BitVectorRank(&positions_);
+    positions_select_ = BitVectorSelect(&positions_);
+  }
+};
+
+/**
+ * Hierarchical samples of a differential SLP
+ *
+ * Two-level version of DifferentialSLPSamples: every _coarse_rate-th sample (coarse sample) stores the absolute value
+ * and index of the first root, and every sample (fine sample) stores only its offsets to the previous coarse sample,
+ * which need fewer bits. So, fine intervals are affordable: with _max_span_length = 1 each root is sampled and the root
+ * of any position is located in O(1) (a rank over the sampled positions) instead of skipping roots linearly.
+ */
+template<typename BitVector = sdsl::sd_vector<>,
+    typename BitVectorRank = typename BitVector::rank_1_type,
+    typename BitVectorSelect = typename BitVector::select_1_type>
+class HierarchicalDifferentialSLPSamples {
+ public:
+  HierarchicalDifferentialSLPSamples() = default;
+
+  template<typename CompactSeq, typename SLP, typename GetSpanSum>
+  HierarchicalDifferentialSLPSamples(std::size_t _seq_size,
+                                     const CompactSeq &_compact_seq,
+                                     const SLP &_slp,
+                                     const GetSpanSum &_get_span_sum,
+                                     std::size_t _max_span_length,
+                                     std::size_t _coarse_rate = 64) {
+    Compute(_seq_size, _compact_seq, _slp, _get_span_sum, _max_span_length, _coarse_rate);
+  }
+
+  HierarchicalDifferentialSLPSamples(const HierarchicalDifferentialSLPSamples &_samples)
+      : coarse_rate_(_samples.coarse_rate_),
+        coarse_values_(_samples.coarse_values_),
+        coarse_roots_pos_(_samples.coarse_roots_pos_),
+        fine_values_(_samples.fine_values_),
+        fine_roots_pos_(_samples.fine_roots_pos_),
+        diff_base_coarse_(_samples.diff_base_coarse_),
+        diff_base_fine_(_samples.diff_base_fine_),
+        positions_(_samples.positions_) {
+    BindSupports();
+  }
+
+  HierarchicalDifferentialSLPSamples &operator=(const HierarchicalDifferentialSLPSamples &_samples) {
+    coarse_rate_ = _samples.coarse_rate_;
+    coarse_values_ = _samples.coarse_values_;
+    coarse_roots_pos_ = _samples.coarse_roots_pos_;
+    fine_values_ = _samples.fine_values_;
+    fine_roots_pos_ = _samples.fine_roots_pos_;
+    diff_base_coarse_ = _samples.diff_base_coarse_;
+    diff_base_fine_ = _samples.diff_base_fine_;
+    positions_ = _samples.positions_;
+    BindSupports();
+    return *this;
+  }
+
+  template<typename CompactSeq, typename SLP, typename GetSpanSum>
+  void Compute(std::size_t _seq_size,
+               const CompactSeq &_compact_seq,
+               const SLP &_slp,
+               const GetSpanSum &_get_span_sum,
+               std::size_t _max_span_length,
+               std::size_t _coarse_rate = 64) {
+    assert(0 < _coarse_rate);
+    coarse_rate_ = _coarse_rate;
+
+    sdsl::bit_vector tmp_positions(_seq_size, 0);
+    std::vector<int64_t> tmp_values;
+    std::vector<std::size_t> tmp_roots_pos;
+    auto report_sample = [&tmp_positions, &tmp_values, &tmp_roots_pos](auto _pos, auto _sum, auto _root_pos) {
+      tmp_positions[_pos] = 1;
+      tmp_values.emplace_back(_sum);
+      tmp_roots_pos.emplace_back(_root_pos);
+    };
+
+    ComputeSamplesOnCompactSequence(_compact_seq, _slp, _get_span_sum, _max_span_length, report_sample);
+
+    auto n_samples = tmp_values.size();
+    auto n_coarse = (n_samples + coarse_rate_ - 1) / coarse_rate_;
+
+    // Differential bases: minimum (absolute) value and minimum offset to the coarse samples
+    int64_t min_coarse = 0, min_fine = 0;
+    for (std::size_t i = 0; i < n_samples; ++i) {
+      auto coarse = i / coarse_rate_ * coarse_rate_;
+      min_coarse = std::min(min_coarse, tmp_values[coarse]);
+      min_fine = std::min(min_fine, tmp_values[i] - tmp_values[coarse]);
+    }
+    diff_base_coarse_ = -min_coarse;
+    diff_base_fine_ = -min_fine;
+
+    coarse_values_ = sdsl::int_vector<>(n_coarse, 0, 64);
+    coarse_roots_pos_ = sdsl::int_vector<>(n_coarse, 0, 64);
+    fine_values_ = sdsl::int_vector<>(n_samples, 0, 64);
+    fine_roots_pos_ = sdsl::int_vector<>(n_samples, 0, 64);
+    for (std::size_t i = 0; i < n_samples; ++i) {
+      auto coarse = i / coarse_rate_;
+      if (i % coarse_rate_ == 0) {
+        coarse_values_[coarse] = tmp_values[i] + diff_base_coarse_;
+        coarse_roots_pos_[coarse] = tmp_roots_pos[i];
+      }
+      fine_values_[i] = tmp_values[i] - tmp_values[coarse * coarse_rate_] + diff_base_fine_;
+      fine_roots_pos_[i] = tmp_roots_pos[i] - tmp_roots_pos[coarse * coarse_rate_];
+    }
+    sdsl::util::bit_compress(coarse_values_);
+    sdsl::util::bit_compress(coarse_roots_pos_);
+    sdsl::util::bit_compress(fine_values_);
+    sdsl::util::bit_compress(fine_roots_pos_);
+
+    Construct(positions_, tmp_positions);
+    BindSupports();
+  }
+
+  auto Sample(std::size_t _pos) const {
+    return positions_rank_(_pos + 1);
+  }
+
+  auto SamplePosition(std::size_t _sample) const {
+    return positions_select_(_sample);
+  }
+
+  std::size_t SampleFirstRoot(std::size_t _sample) const {
+    assert(0 < _sample);
+    return coarse_roots_pos_[(_sample - 1) / coarse_rate_] + fine_roots_pos_[_sample - 1];
+  }
+
+  int64_t SampleValue(std::size_t _sample) const {
+    assert(0 < _sample);
+    return int64_t(coarse_values_[(_sample - 1) / coarse_rate_]) - diff_base_coarse_
+        + int64_t(fine_values_[_sample - 1]) - diff_base_fine_;
+  }
+
+  std::size_t size() const {
+    return fine_values_.size();
+  }
+
+  std::size_t CoarseRate() const {
+    return coarse_rate_;
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += sdsl::serialize(coarse_rate_, out);
+    written_bytes += sdsl::serialize(coarse_values_, out);
+    written_bytes += sdsl::serialize(coarse_roots_pos_, out);
+    written_bytes += sdsl::serialize(fine_values_, out);
+    written_bytes += sdsl::serialize(fine_roots_pos_, out);
+    written_bytes += sdsl::serialize(diff_base_coarse_, out);
+    written_bytes += sdsl::serialize(diff_base_fine_, out);
+    written_bytes += sdsl::serialize(positions_, out);
+    written_bytes += sdsl::serialize(positions_rank_, out);
+    written_bytes += sdsl::serialize(positions_select_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(coarse_rate_, in);
+    sdsl::load(coarse_values_, in);
+    sdsl::load(coarse_roots_pos_, in);
+    sdsl::load(fine_values_, in);
+    sdsl::load(fine_roots_pos_, in);
+    sdsl::load(diff_base_coarse_, in);
+    sdsl::load(diff_base_fine_, in);
+    positions_.load(in);
+    positions_rank_.load(in, &positions_);
+    positions_select_.load(in, &positions_);
+  }
+
+ private:
+  std::size_t coarse_rate_ = 64; // Number of samples per coarse sample.
+
+  sdsl::int_vector<> coarse_values_; // Values at coarse samples (shifted by diff_base_coarse_).
+  sdsl::int_vector<> coarse_roots_pos_; // Position of the first root for each coarse sample.
+  sdsl::int_vector<> fine_values_; // Offsets of the values to their coarse samples (shifted by diff_base_fine_).
+  sdsl::int_vector<> fine_roots_pos_; // Offsets of the positions of the first roots to their coarse samples.
+  int64_t diff_base_coarse_ = 0;
+  int64_t diff_base_fine_ = 0;
+
+  BitVector positions_; // Marks sampled positions in the original sequence.
+  BitVectorRank positions_rank_;
+  BitVectorSelect positions_select_;
+
+  void BindSupports() {
+    positions_rank_ = BitVectorRank(&positions_);
+    positions_select_ = BitVectorSelect(&positions_);
+  }
+};
+
+/**
+ * Sampling candidate with its measured space and query latency
+ */
+struct SamplingCandidate {
+  std::size_t max_span_length;
+  std::size_t size_in_bytes;
+  double latency; // Average time per query (nanoseconds)
+};
+
+/**
+ * Choose the sampling interval among the measured candidates. Only the Pareto-optimal candidates (no other candidate is
+ * smaller and faster) are considered:
+ * - with a memory budget (> 0), the fastest candidate within the budget (the smallest one if none fits);
+ * - otherwise, with a latency target (> 0), the smallest candidate within the target (the fastest one if none meets
+ * it);
+ * - otherwise, the candidate with the smallest product of size and latency.
+ *
+ * @return index of the chosen candidate
+ */
+inline std::size_t ChooseSampling(const std::vector<SamplingCandidate> &_candidates,
+                                  std::size_t _memory_budget = 0,
+                                  double _latency_target = 0) {
+  assert(!_candidates.empty());
+
+  auto dominates = [](const SamplingCandidate &_a, const SamplingCandidate &_b) {
+    return _a.size_in_bytes <= _b.size_in_bytes && _a.latency <= _b.latency
+        && (_a.size_in_bytes < _b.size_in_bytes || _a.latency < _b.latency);
   };
 
-  // Compute cover sum for each non-terminal
-  for (std::size_t i = 0, j = sigma + 1; i < rules.size() / 2; ++i, ++j) {
-    auto children = _slp[j];
-    cover_sums[i] = get_cover_sum(children.first) + get_cover_sum(children.second);
-    _report_cover_sum(i, cover_sums[i]);
+  std::vector<std::size_t> front;
+  for (std::size_t i = 0; i < _candidates.size(); ++i) {
+    if (std::none_of(_candidates.begin(), _candidates.end(), [&](const auto &_c) {
+      return dominates(_c, _candidates[i]);
+    })) {
+      front.push_back(i);
+    }
   }
 
-  // Compute accumulated sums on compact sequence
-  uint32_t sum = 0;
-  std::size_t pos = 0;
-  diff_base = _diff_base; // Now, it is considered for accumulated sample sums.
-  for (std::size_t i = 0; i < _compact_seq.size(); ++i) {
-    _report_acc_sum(pos, sum);
+  auto by_size = [&_candidates](auto _i, auto _j) {
+    return _candidates[_i].size_in_bytes < _candidates[_j].size_in_bytes;
+  };
+  auto by_latency = [&_candidates](auto _i, auto _j) {
+    return _candidates[_i].latency < _candidates[_j].latency;
+  };
+
+  if (0 < _memory_budget) {
+    std::vector<std::size_t> fit;
+    std::copy_if(front.begin(), front.end(), back_inserter(fit), [&](auto _i) {
+      return _candidates[_i].size_in_bytes <= _memory_budget;
+    });
+    return fit.empty() ? *std::min_element(front.begin(), front.end(), by_size)
+                       : *std::min_element(fit.begin(), fit.end(), by_latency);
+  }
 
-    pos += _slp.SpanLength(_compact_seq[i]);
-    sum += get_cover_sum(_compact_seq[i]);
+  if (0 < _latency_target) {
+    std::vector<std::size_t> fit;
+    std::copy_if(front.begin(), front.end(), back_inserter(fit), [&](auto _i) {
+      return _candidates[_i].latency <= _latency_target;
+    });
+    return fit.empty() ? *std::min_element(front.begin(), front.end(), by_latency)
+                       : *std::min_element(fit.begin(), fit.end(), by_size);
   }
+
+  return *std::min_element(front.begin(), front.end(), [&_candidates](auto _i, auto _j) {
+    return _candidates[_i].size_in_bytes * _candidates[_i].latency
+        < _candidates[_j].size_in_bytes * _candidates[_j].latency;
+  });
 }
-*/
 
-template<typename SLP = grammar::SLP<>,
-    typename Roots = std::vector<std::size_t>,
-    typename SpanSums = std::vector<uint32_t>,
-    typename Samples = std::vector<uint32_t>,
+/**
+ * Build the sums of prefix sums of the differences (terminal - _diff_base) of each variable (see
+ * BasicDifferentialSLPWrapper::SumOfValues)
+ */
+template<typename SLP>
+SLPAggregates<PrefixSumsMonoid<>> BuildValueSums(const SLP &_slp, std::size_t _diff_base) {
+  return SLPAggregates<PrefixSumsMonoid<>>(_slp, [_diff_base](std::size_t _terminal) {
+    return PrefixSumsMonoid<>::Lift(int64_t(_terminal) - int64_t(_diff_base));
+  });
+}
+
+/**
+ * Leaf blocks of a differential SLP
+ *
+ * Differences (terminal - diff_base) of the span of each short rule (span length <= max span length), stored
+ * contiguously, so the expansion copies them instead of descending to the terminals (see
+ * ExpandDifferentialSLPToBuffer). The differences are bit-packed, shifted by the minimum difference, so each one takes
+ * the bits of the range of the differences (at most log(sigma) bits) and a rule takes at most max span length of them.
+ *
+ * @tparam Offsets Container of offsets of the blocks
+ */
+template<typename Offsets = std::vector<uint64_t>>
+class DifferentialSLPLeafBlocks {
+ public:
+  DifferentialSLPLeafBlocks() = default;
+
+  template<typename SLP>
+  DifferentialSLPLeafBlocks(const SLP &_slp, std::size_t _diff_base, std::size_t _max_span_length = 16) {
+    Compute(_slp, _diff_base, _max_span_length);
+  }
+
+  /**
+   * Compute the blocks bottom-up: the block of a short rule is the concatenation of the blocks of its children
+   */
+  template<typename SLP>
+  void Compute(const SLP &_slp, std::size_t _diff_base, std::size_t _max_span_length = 16) {
+    sigma_ = _slp.Sigma();
+    max_span_length_ = _max_span_length;
+
+    auto n_rules = _slp.Variables() - sigma_;
+    std::vector<uint64_t> offsets(n_rules + 1, 0);
+    for (std::size_t i = 0; i < n_rules; ++i) {
+      auto span_length = _slp.SpanLength(sigma_ + 1 + i);
+      offsets[i + 1] = offsets[i] + (span_length <= _max_span_length ? span_length : 0);
+    }
+
+    // The terminals are stored first and shifted by the minimum one at the end
+    deltas_ = sdsl::int_vector<>(offsets[n_rules], 0, sdsl::bits::hi(std::max<std::size_t>(sigma_, 1)) + 1);
+    std::size_t pos = 0;
+    auto append = [this, &offsets, &pos](std::size_t _var) {
+      if (_var <= sigma_) {
+        deltas_[pos++] = _var;
+      } else {
+        auto i = _var - sigma_ - 1;
+        for (auto k = offsets[i]; k < offsets[i + 1]; ++k) {
+          deltas_[pos++] = deltas_[k];
+        }
+      }
+    };
+
+    for (std::size_t i = 0; i < n_rules; ++i) {
+      if (offsets[i] < offsets[i + 1]) {
+        const auto children = _slp[sigma_ + 1 + i];
+        append(children.first);
+        append(children.second);
+      }
+    }
+
+    uint64_t min = deltas_.empty() ? 0 : *std::min_element(deltas_.begin(), deltas_.end());
+    for (std::size_t k = 0; k < deltas_.size(); ++k) {
+      deltas_[k] = deltas_[k] - min;
+    }
+    sdsl::util::bit_compress(deltas_);
+    min_delta_ = int64_t(min) - int64_t(_diff_base);
+
+    Construct(offsets_, offsets);
+  }
+
+  /**
+   * Get the length of the block of variable _var (0 if it is a terminal or it is not short)
+   */
+  std::size_t BlockLength(std::size_t _var) const {
+    if (_var <= sigma_)
+      return 0;
+
+    auto i = _var - sigma_ - 1;
+    return offsets_[i + 1] - offsets_[i];
+  }
+
+  /**
+   * Unpack the first _n differences of the block of the short variable _var into _out
+   */
+  void CopyBlock(std::size_t _var, std::size_t _n, int64_t *_out) const {
+    auto it = deltas_.begin() + offsets_[_var - sigma_ - 1];
+    for (std::size_t k = 0; k < _n; ++k, ++it) {
+      _out[k] = int64_t(*it) + min_delta_;
+    }
+  }
+
+  std::size_t MaxSpanLength() const {
+    return max_span_length_;
+  }
+
+  std::size_t size() const {
+    return deltas_.size();
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += sdsl::serialize(sigma_, out);
+    written_bytes += sdsl::serialize(max_span_length_, out);
+    written_bytes += sdsl::serialize(min_delta_, out);
+    written_bytes += sdsl::serialize(deltas_, out);
+    written_bytes += sdsl::serialize(offsets_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(sigma_, in);
+    sdsl::load(max_span_length_, in);
+    sdsl::load(min_delta_, in);
+    sdsl::load(deltas_, in);
+    sdsl::load(offsets_, in);
+  }
+
+ private:
+  std::size_t sigma_ = 0;
+  std::size_t max_span_length_ = 0;
+
+  int64_t min_delta_ = 0; // Shift of the packed differences
+  sdsl::int_vector<> deltas_; // Differences of the blocks (contiguous), minus min_delta_
+  Offsets offsets_; // For each rule, offset of its block (empty if it is not short)
+};
+
+
+/**
+ * Without leaf blocks: the expansion always descends to the terminals
+ */
+struct NoLeafBlocks {
+  std::size_t BlockLength(std::size_t _var) const {
+    return 0;
+  }
+};
+
+/**
+ * Samples of a differential SLP stored elsewhere (see ComputeSamplesOnCompactSequence). It is the default samples
+ * policy of BasicDifferentialSLPWrapper and the one of DifferentialSLPWrapper.
+ */
+template<typename Samples = std::vector<uint32_t>,
     typename SampleRootsPos = std::vector<uint32_t>,
     typename BitVector = sdsl::sd_vector<>,
     typename BitVectorRank = typename BitVector::rank_1_type,
     typename BitVectorSelect = typename BitVector::select_1_type>
-class DifferentialSLPWrapper {
+class DifferentialSLPSamplesReference {
  public:
-  DifferentialSLPWrapper(std::size_t _seq_size,
-                         const SLP &_slp,
-                         const Roots &_roots,
-                         std::size_t _diff_base_seq,
-                         const SpanSums &_span_sums,
-                         std::size_t _diff_base_sums,
-                         const Samples &_samples,
-                         const SampleRootsPos &_sample_roots_pos,
-                         const BitVector &_samples_pos,
-                         const BitVectorRank &_samples_pos_rank,
-                         const BitVectorSelect &_samples_pos_select)
+  DifferentialSLPSamplesReference(const Samples &_samples,
+                                  const SampleRootsPos &_sample_roots_pos,
+                                  const BitVector &_samples_pos,
+                                  const BitVectorRank &_samples_pos_rank,
+                                  const BitVectorSelect &_samples_pos_select)
+      : samples_{_samples},
+        sample_roots_pos_{_sample_roots_pos},
+        samples_pos_{_samples_pos},
+        samples_pos_rank_{_samples_pos_rank},
+        samples_pos_select_{_samples_pos_select} {
+  }
+
+  auto Sample(std::size_t _pos) const {
+    return samples_pos_rank_(_pos + 1);
+  }
+
+  auto SamplePosition(std::size_t _sample) const {
+    return samples_pos_select_(_sample);
+  }
+
+  auto SampleFirstRoot(std::size_t _sample) const {
+    return sample_roots_pos_[_sample - 1];
+  }
+
+  auto SampleValue(std::size_t _sample) const {
+    assert(0 < _sample);
+    return samples_[_sample - 1];
+  }
+
+ private:
+  const Samples &samples_; // Values at sampled positions.
+  const SampleRootsPos &sample_roots_pos_; // Position of the first root for each sample interval.
+  const BitVector &samples_pos_; // Marks sampled positions in the original sequence.
+  const BitVectorRank &samples_pos_rank_;
+  const BitVectorSelect &samples_pos_select_;
+};
+
+/**
+ * Differential SLP over existing structures
+ *
+ * @tparam Samples Samples policy: Sample(pos), SamplePosition(sample), SampleFirstRoot(sample) and SampleValue(sample),
+ * e.g., DifferentialSLPSamplesReference, or a (const) reference to DifferentialSLPSamples or
+ * HierarchicalDifferentialSLPSamples.
+ */
+template<typename SLP = grammar::SLP<>,
+    typename Roots = std::vector<std::size_t>,
+    typename SpanSums = std::vector<uint32_t>,
+    typename Samples = DifferentialSLPSamplesReference<>>
+class BasicDifferentialSLPWrapper {
+ public:
+  BasicDifferentialSLPWrapper(std::size_t _seq_size,
+                              const SLP &_slp,
+                              const Roots &_roots,
+                              std::size_t _diff_base_seq,
+                              const SpanSums &_span_sums,
+                              std::size_t _diff_base_sums,
+                              const Samples &_samples)
       : seq_size_{_seq_size},
         slp_{_slp},
         roots_{_roots},
         diff_base_seq_{_diff_base_seq},
         span_sums_{_span_sums},
         diff_base_sums_{_diff_base_sums},
-        samples_{_samples},
-        sample_roots_pos_{_sample_roots_pos},
-        samples_pos_{_samples_pos},
-        samples_pos_rank_{_samples_pos_rank},
-        samples_pos_select_{_samples_pos_select} {
+        samples_{_samples} {
+  }
+
+  /**
+   * Constructor over the sample structures stored separately (see DifferentialSLPSamplesReference)
+   */
+  template<typename SampleValues,
+      typename SampleRootsPos,
+      typename BitVector,
+      typename BitVectorRank,
+      typename BitVectorSelect>
+  BasicDifferentialSLPWrapper(std::size_t _seq_size,
+                              const SLP &_slp,
+                              const Roots &_roots,
+                              std::size_t _diff_base_seq,
+                              const SpanSums &_span_sums,
+                              std::size_t _diff_base_sums,
+                              const SampleValues &_samples,
+                              const SampleRootsPos &_sample_roots_pos,
+                              const BitVector &_samples_pos,
+                              const BitVectorRank &_samples_pos_rank,
+                              const BitVectorSelect &_samples_pos_select)
+      : BasicDifferentialSLPWrapper(
+      _seq_size,
+      _slp,
+      _roots,
+      _diff_base_seq,
+      _span_sums,
+      _diff_base_sums,
+      Samples(_samples, _sample_roots_pos, _samples_pos, _samples_pos_rank, _samples_pos_select)) {
   }
 
   auto IsTerminal(std::size_t _var) const {
@@ -150,6 +865,10 @@ class DifferentialSLPWrapper {
     return slp_.SpanLength(_var);
   }
 
+  void Prefetch(std::size_t _var) const {
+    PrefetchRule(slp_, _var, 0);
+  }
+
   auto Root(std::size_t _i) const {
     assert(_i < roots_.size());
     return roots_[_i];
@@ -164,20 +883,104 @@ class DifferentialSLPWrapper {
   }
 
   auto Sample(std::size_t _pos) const {
-    return samples_pos_rank_(_pos + 1);
+    return samples_.Sample(_pos);
   }
 
   auto SamplePosition(std::size_t _sample) const {
-    return samples_pos_select_(_sample);
+    return samples_.SamplePosition(_sample);
   }
 
   auto SampleFirstRoot(std::size_t _sample) const {
-    return sample_roots_pos_[_sample - 1];
+    return samples_.SampleFirstRoot(_sample);
   }
 
   auto SampleValue(std::size_t _sample) const {
-    assert(0 < _sample);
-    return samples_[_sample - 1];
+    return samples_.SampleValue(_sample);
+  }
+
+  /**
+   * Get the value at position _pos of the original sequence in O(height + roots crossed): the whole roots and subtrees
+   * before the position are skipped with their span sums.
+   */
+  int64_t ValueAt(std::size_t _pos) const {
+    assert(_pos < seq_size_);
+
+    auto location = LocateRoot(_pos);
+    return location.value + PrefixSpanSum(roots_[location.idx], _pos - location.pos + 1);
+  }
+
+  /**
+   * Get the sum of the differences in [_sp, _ep], i.e., ValueAt(_ep) - ValueAt(_sp - 1)
+   */
+  int64_t RangeSum(std::size_t _sp, std::size_t _ep) const {
+    assert(_sp <= _ep);
+
+    return ValueAt(_ep) - (_sp == 0 ? 0 : ValueAt(_sp - 1));
+  }
+
+  /**
+   * Get the sum of the values in [_sp, _ep] in O(height + roots crossed), using the sums of prefix sums of the
+   * variables (see BuildValueSums)
+   */
+  template<typename ValueSums>
+  int64_t SumOfValues(std::size_t _sp, std::size_t _ep, const ValueSums &_value_sums) const {
+    assert(_sp <= _ep && _ep < seq_size_);
+
+    auto location = LocateRoot(_sp);
+    auto i = location.idx;
+    auto bp = _sp - location.pos;
+    int64_t prev_value = location.value + PrefixSpanSum(roots_[i], bp); // Value at _sp - 1
+
+    auto remaining = _ep - _sp + 1;
+    auto prefix_sums = PrefixSumsMonoid<>::Identity();
+    for (; 0 < remaining; ++i, bp = 0) {
+      auto ep = std::min<std::size_t>(slp_.SpanLength(roots_[i]), bp + remaining);
+      prefix_sums = PrefixSumsMonoid<>::Combine(prefix_sums, _value_sums.Aggregate(slp_, roots_[i], bp, ep));
+      remaining -= ep - bp;
+    }
+
+    return int64_t(_ep - _sp + 1) * prev_value + prefix_sums.prefix_sums;
+  }
+
+  /**
+   * Get the sum of the values in [_sp, _ep] expanding the range (without the sums of prefix sums)
+   */
+  int64_t SumOfValues(std::size_t _sp, std::size_t _ep) const {
+    int64_t sum = 0;
+    ExpandDifferentialSLP(*this, _sp, _ep, [&sum](auto _value) { sum += int64_t(_value); });
+    return sum;
+  }
+
+  /**
+   * Build the sums of prefix sums of the differences of each variable (for SumOfValues)
+   */
+  auto BuildValueSums() const {
+    return grammar::BuildValueSums(slp_, diff_base_seq_);
+  }
+
+  /**
+   * Expand the values in [_sp, _ep] into the buffer _out (see ExpandDifferentialSLPToBuffer)
+   *
+   * @return number of values
+   */
+  std::size_t ExpandToBuffer(std::size_t _sp, std::size_t _ep, int64_t *_out) const {
+    return ExpandDifferentialSLPToBuffer(*this, _sp, _ep, _out);
+  }
+
+  /**
+   * Expand the values in [_sp, _ep] into the buffer _out, copying the leaf blocks of the short rules (see
+   * BuildLeafBlocks)
+   */
+  template<typename LeafBlocks>
+  std::size_t ExpandToBuffer(std::size_t _sp, std::size_t _ep, int64_t *_out, const LeafBlocks &_leaf_blocks) const {
+    return ExpandDifferentialSLPToBuffer(*this, _sp, _ep, _out, _leaf_blocks);
+  }
+
+  /**
+   * Build the leaf blocks of the rules with span length <= _max_span_length (for ExpandToBuffer)
+   */
+  auto BuildLeafBlocks(std::size_t _max_span_length = 16) const {
+    return DifferentialSLPLeafBlocks<>(slp_, diff_base_seq_, _max_span_length);
   }
 
  private:
@@ -191,13 +994,76 @@ class DifferentialSLPWrapper {
   const SpanSums &span_sums_; // For each non-terminal.
   std::size_t diff_base_sums_; // Differential base added to span sums.
 
-  const Samples &samples_; // Values at sampled positions.
-  const SampleRootsPos &sample_roots_pos_; // Position of the first root for each sample interval.
-  const BitVector &samples_pos_; // Marks sampled positions in the original sequence.
-  const BitVectorRank &samples_pos_rank_;
-  const BitVectorSelect &samples_pos_select_;
+  Samples samples_; // Samples policy (a reference type for samples stored elsewhere).
+
+  struct RootLocation {
+    std::size_t idx; // Index of the root
+    int64_t value; // Value before the root
+    std::size_t pos; // Position of the root
+  };
+
+  /**
+   * Locate the root that contains position _pos, skipping the whole roots of its sample interval
+   */
+  RootLocation LocateRoot(std::size_t _pos) const {
+    auto sample = Sample(_pos);
+    RootLocation location{SampleFirstRoot(sample), int64_t(SampleValue(sample)), SamplePosition(sample)};
+
+    std::size_t span_length;
+    while (location.pos + (span_length = slp_.SpanLength(roots_[location.idx])) <= _pos) {
+      location.value += int64_t(SpanSum(roots_[location.idx]));
+      location.pos += span_length;
+      ++location.idx;
+    }
+
+    return location;
+  }
+
+  /**
+   * Get the sum of the differences of the prefix [0, _ep) of the span of variable _var
+   */
+  int64_t PrefixSpanSum(std::size_t _var, std::size_t _ep) const {
+    if (_ep == 0)
+      return 0;
+
+    int64_t sum = 0;
+    while (_ep != slp_.SpanLength(_var)) {
+      const auto &children = slp_[_var];
+      auto left_length = slp_.SpanLength(children.first);
+
+      if (_ep <= left_length) {
+        _var = children.first;
+      } else {
+        sum += int64_t(SpanSum(children.first));
+        _var = children.second;
+        _ep -= left_length;
+      }
+    }
+
+    return sum + int64_t(SpanSum(_var));
+  }
 };
 
+/**
+ * Differential SLP over the sample structures stored separately (original interface)
+ */
+template<typename SLP = grammar::SLP<>,
+    typename Roots = std::vector<std::size_t>,
+    typename SpanSums = std::vector<uint32_t>,
+    typename Samples = std::vector<uint32_t>,
+    typename SampleRootsPos = std::vector<uint32_t>,
+    typename BitVector = sdsl::sd_vector<>,
+    typename BitVectorRank = typename BitVector::rank_1_type,
+    typename BitVectorSelect = typename BitVector::select_1_type>
+using DifferentialSLPWrapper = BasicDifferentialSLPWrapper<SLP,
+                                                           Roots,
+                                                           SpanSums,
+                                                           DifferentialSLPSamplesReference<Samples,
+                                                                                           SampleRootsPos,
+                                                                                           BitVector,
+                                                                                           BitVectorRank,
+                                                                                           BitVectorSelect>>;
+
 template<typename SLP, typename Roots, typename SpanSums, typename Samples, typename SampleRootsPos, typename BitVector, typename BitVectorRank, typename BitVectorSelect>
 auto MakeDifferentialSLPWrapper(std::size_t _seq_size,
                                 const SLP &_slp,
@@ -231,75 +1097,106 @@ auto MakeDifferentialSLPWrapper(std::size_t _seq_size,
       _samples_pos_select);
 }
 
-/*
-template<typename SLP = grammar::SLP<>,
-    typename Roots = std::vector<std::size_t>,
-    typename SpanSums = std::vector<uint32_t>,
-    typename SampleSums = std::vector<uint32_t>,
-    typename BitVector = sdsl::sd_vector<>,
-    typename BitVectorRank = typename BitVector::rank_1_type,
-    typename BitVectorSelect = typename BitVector::select_1_type>
-class DifferentialSLP : public SLP {
+/**
+ * Make a differential SLP wrapper over samples (e.g., DifferentialSLPSamples or HierarchicalDifferentialSLPSamples)
+ */
+template<typename SLP, typename Roots, typename SpanSums, typename Samples>
+auto MakeDifferentialSLPWrapper(std::size_t _seq_size,
+                                const SLP &_slp,
+                                const Roots &_roots,
+                                std::size_t _diff_base_seq,
+                                const SpanSums &_span_sums,
+                                std::size_t _diff_base_sums,
+                                const Samples &_samples) {
+  return BasicDifferentialSLPWrapper<SLP, Roots, SpanSums, const Samples &>(
+      _seq_size, _slp, _roots, _diff_base_seq, _span_sums, _diff_base_sums, _samples);
+}
+
+/**
+ * Differential SLP
+ *
+ * Owning counterpart of BasicDifferentialSLPWrapper: SLP of the differential sequence, its compact sequence (roots),
+ * span sums of the non-terminals and samples, bit-compressed by default. It is built in one call from the RePair grammar
+ * (span sums and samples are computed in memory) and stored with a single serialize/load.
+ *
+ * @tparam Samples DifferentialSLPSamples or HierarchicalDifferentialSLPSamples
+ */
+template<typename SLP = grammar::SLP<sdsl::int_vector<>, sdsl::int_vector<>>,
+    typename Roots = sdsl::int_vector<>,
+    typename SpanSums = sdsl::int_vector<>,
+    typename Samples = DifferentialSLPSamples<>>
+class DifferentialSLP {
  public:
   using size_type = std::size_t;
 
   DifferentialSLP() = default;
 
-  template<typename OriginalSLP, typename CompactSeq, typename SpanSumsAction = NoAction, typename SampleSumsAction = NoAction, typename RootsAction = NoAction>
+  template<typename OriginalSLP, typename CompactSeq>
+  DifferentialSLP(std::size_t _seq_size,
+                  const OriginalSLP &_slp,
+                  const CompactSeq &_compact_seq,
+                  std::size_t _diff_base_seq,
+                  std::size_t _max_span_length,
+                  std::size_t _n_threads = 1) {
+    Compute(_seq_size, _slp, _compact_seq, _diff_base_seq, _max_span_length, _n_threads);
+  }
+
+  /**
+   * Compute the differential SLP
+   *
+   * @param _seq_size Length of the sequence
+   * @param _slp SLP of the differential sequence (terminal = difference + _diff_base_seq)
+   * @param _compact_seq Compact sequence (roots) of the RePair encoding
+   * @param _diff_base_seq Differential base added to the differential sequence
+   * @param _max_span_length Maximum length of sampled intervals
+   * @param _n_threads Number of threads to compute the span sums
+   */
+  template<typename OriginalSLP, typename CompactSeq>
   void Compute(std::size_t _seq_size,
                const OriginalSLP &_slp,
                const CompactSeq &_compact_seq,
-               uint64_t _differential_base,
-               SpanSumsAction &&_span_sums_action = NoAction(),
-               SampleSumsAction &&_sample_sums_action = NoAction(),
-               RootsAction &&_roots_action = NoAction()) {
-
-    differential_base_ = _differential_base;
-
-    std::vector<typename SpanSums::value_type> span_sums;
-    span_sums.reserve(_slp.GetRules().size());
-    auto report_cover_sum = [&span_sums](auto _rule, auto _sum) {
-      span_sums.emplace_back(_sum);
-    };
-
-    sdsl::bit_vector tmp_sample_pos(_seq_size + 1, 0);
-    std::vector<typename SampleSums::value_type> sample_sums;
-    auto report_acc_sum = [&tmp_sample_pos, &sample_sums](auto _pos, auto _sum) {
-      tmp_sample_pos[_pos] = 1;
-      sample_sums.emplace_back(_sum);
-    };
-
-    ComputeCoverSumsAndSampleSum(_slp, _compact_seq, _differential_base, report_cover_sum, report_acc_sum);
-    tmp_sample_pos[tmp_sample_pos.size() - 1] = 1;
-
-    OriginalSLP::operator=(_slp);
+               std::size_t _diff_base_seq,
+               std::size_t _max_span_length,
+               std::size_t _n_threads = 1) {
+    seq_size_ = _seq_size;
+    diff_base_seq_ = _diff_base_seq;
+
+    {
+      sdsl::int_vector<> span_sums;
+      auto minmax = ComputeSpanSums(_slp, _diff_base_seq, span_sums, _n_threads);
+      diff_base_sums_ = minmax.first < 0 ? -minmax.first : 0;
+      Construct(span_sums_, span_sums);
+      Compress(span_sums_);
+    }
+
+    auto compress = [](auto &_v) { Compress(_v); };
+    slp_ = SLP(_slp, compress, compress);
 
-//    span_sums_ = SpanSums(span_sums);
-    Construct(span_sums_, span_sums);
-    _span_sums_action(span_sums_);
-    span_sums.clear();
+    Construct(roots_, _compact_seq);
+    Compress(roots_);
 
-//    sample_sums_ = SampleSums(sample_sums);
-    Construct(sample_sums_, sample_sums);
-    _sample_sums_action(sample_sums_);
-    sample_sums.clear();
+    auto get_span_sum = [this](auto _var) { return int64_t(SpanSum(_var)); };
+    samples_.Compute(seq_size_, roots_, slp_, get_span_sum, _max_span_length);
+  }
 
-    sample_pos_ = BitVector(tmp_sample_pos);
-    sample_pos_rank_ = BitVectorRank(&sample_pos_);
-    sample_pos_select_ = BitVectorSelect(&sample_pos_);
+  std::size_t size() const {
+    return seq_size_;
+  }
 
-//    roots_ = Roots(_compact_seq);
-    Construct(roots_, _compact_seq);
-    _roots_action(roots_);
+  auto IsTerminal(std::size_t _var) const {
+    return slp_.IsTerminal(_var);
+  }
 
+  auto operator[](std::size_t _var) const {
+    return slp_[_var];
   }
 
-  auto DifferentialBase() const {
-    return differential_base_;
+  auto SpanLength(std::size_t _var) const {
+    return slp_.SpanLength(_var);
   }
 
-  auto SpanSum(std::size_t _var) const {
-    return SLP::IsTerminal(_var) ? _var : span_sums_[_var - SLP::sigma_ - 1];
+  void Prefetch(std::size_t _var) const {
+    PrefetchRule(slp_, _var, 0);
   }
 
   auto Root(std::size_t _i) const {
@@ -307,86 +1204,237 @@ class DifferentialSLP : public SLP {
     return roots_[_i];
   }
 
-  std::size_t Sample(std::size_t _pos) const {
-    return sample_pos_rank_(_pos + 1);
+  auto SpanSum(std::size_t _var) const {
+    return slp_.IsTerminal(_var) ? (_var - diff_base_seq_) : (span_sums_[_var - slp_.Sigma() - 1] - diff_base_sums_);
+  }
+
+  auto DifferentialBase() const {
+    return diff_base_seq_;
+  }
+
+  auto Sample(std::size_t _pos) const {
+    return samples_.Sample(_pos);
   }
 
   auto SamplePosition(std::size_t _sample) const {
-    return sample_pos_select_(_sample);
+    return samples_.SamplePosition(_sample);
   }
 
   auto SampleFirstRoot(std::size_t _sample) const {
-    return _sample - 1;
+    return samples_.SampleFirstRoot(_sample);
   }
 
-  auto SampleSum(std::size_t _sample) const {
-    assert(0 < _sample);
-    return sample_sums_[_sample - 1];
+  auto SampleValue(std::size_t _sample) const {
+    return samples_.SampleValue(_sample);
+  }
+
+  /**
+   * Get the value at position _pos (see BasicDifferentialSLPWrapper::ValueAt)
+   */
+  int64_t ValueAt(std::size_t _pos) const {
+    return Wrapper().ValueAt(_pos);
+  }
+
+  /**
+   * Get the sum of the differences in [_sp, _ep] (see BasicDifferentialSLPWrapper::RangeSum)
+   */
+  int64_t RangeSum(std::size_t _sp, std::size_t _ep) const {
+    return Wrapper().RangeSum(_sp, _ep);
+  }
+
+  /**
+   * Get the sum of the values in [_sp, _ep] (see BasicDifferentialSLPWrapper::SumOfValues)
+   */
+  template<typename ValueSums>
+  int64_t SumOfValues(std::size_t _sp, std::size_t _ep, const ValueSums &_value_sums) const {
+    return Wrapper().SumOfValues(_sp, _ep, _value_sums);
+  }
+
+  int64_t SumOfValues(std::size_t _sp, std::size_t _ep) const {
+    return Wrapper().SumOfValues(_sp, _ep);
+  }
+
+  auto BuildValueSums() const {
+    return grammar::BuildValueSums(slp_, diff_base_seq_);
+  }
+
+  std::size_t ExpandToBuffer(std::size_t _sp, std::size_t _ep, int64_t *_out) const {
+    return Wrapper().ExpandToBuffer(_sp, _ep, _out);
+  }
+
+  template<typename LeafBlocks>
+  std::size_t ExpandToBuffer(std::size_t _sp, std::size_t _ep, int64_t *_out, const LeafBlocks &_leaf_blocks) const {
+    return Wrapper().ExpandToBuffer(_sp, _ep, _out, _leaf_blocks);
+  }
+
+  auto BuildLeafBlocks(std::size_t _max_span_length = 16) const {
+    return DifferentialSLPLeafBlocks<>(slp_, diff_base_seq_, _max_span_length);
+  }
+
+  /**
+   * Get a wrapper over the structures of this differential SLP
+   */
+  auto Wrapper() const {
+    return MakeDifferentialSLPWrapper(seq_size_, slp_, roots_, diff_base_seq_, span_sums_, diff_base_sums_, samples_);
+  }
+
+  const SLP &GetSLP() const {
+    return slp_;
+  }
+
+  const Roots &GetRoots() const {
+    return roots_;
+  }
+
+  const SpanSums &GetSpanSums() const {
+    return span_sums_;
+  }
+
+  const Samples &GetSamples() const {
+    return samples_;
   }
 
   std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
     std::size_t written_bytes = 0;
-    written_bytes += SLP::serialize(out);
-
+    written_bytes += sdsl::serialize(seq_size_, out);
+    written_bytes += sdsl::serialize(diff_base_seq_, out);
+    written_bytes += sdsl::serialize(diff_base_sums_, out);
+    written_bytes += sdsl::serialize(slp_, out);
     written_bytes += sdsl::serialize(roots_, out);
-
-    written_bytes += sdsl::serialize(differential_base_, out);
     written_bytes += sdsl::serialize(span_sums_, out);
-
-    written_bytes += sample_pos_.serialize(out);
-    written_bytes += sample_pos_rank_.serialize(out);
-    written_bytes += sample_pos_select_.serialize(out);
-    written_bytes += sdsl::serialize(sample_sums_, out);
+    written_bytes += sdsl::serialize(samples_, out);
 
     return written_bytes;
   }
 
   void load(std::istream &in) {
-    SLP::load(in);
-
+    sdsl::load(seq_size_, in);
+    sdsl::load(diff_base_seq_, in);
+    sdsl::load(diff_base_sums_, in);
+    sdsl::load(slp_, in);
     sdsl::load(roots_, in);
-
-    sdsl::load(differential_base_, in);
     sdsl::load(span_sums_, in);
-
-    sample_pos_.load(in);
-//    sample_pos_rank_.load(in);
-    sample_pos_rank_ = BitVectorRank(&sample_pos_);
-//    sample_pos_select_.load(in);
-    sample_pos_select_ = BitVectorSelect(&sample_pos_);
-    sdsl::load(sample_sums_, in);
+    sdsl::load(samples_, in);
   }
 
  private:
-  Roots roots_; // Compact sequence. It is a sequence of variables (terminals/non-terminals), i.e. a forest.
+  std::size_t seq_size_ = 0;
+  std::size_t diff_base_seq_ = 0; // Differential base added to differential sequence.
+  std::size_t diff_base_sums_ = 0; // Differential base added to span sums.
 
-  uint64_t differential_base_;
+  SLP slp_;
+  Roots roots_; // Compact sequence. It is a sequence of variables (terminals/non-terminals), i.e. a forest.
   SpanSums span_sums_; // For each non-terminal.
-
-  BitVector sample_pos_; // Marks sampled positions in the original sequence.
-  BitVectorRank sample_pos_rank_;
-  BitVectorSelect sample_pos_select_;
-  SampleSums sample_sums_;
+  Samples samples_;
 };
+
+
+/**
+ * Stack with a fixed capacity stored inline (no allocation). Pushes beyond the capacity spill to the heap, so it is
+ * only slower, but still correct, for grammars higher than the capacity.
  */
+template<typename T, std::size_t __capacity = 64>
+class BoundedStack {
+ public:
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
 
+  void push(const T &_value) {
+    if (size_ < __capacity) {
+      buffer_[size_] = _value;
+    } else {
+      overflow_.push_back(_value);
+    }
+    ++size_;
+  }
 
-template<typename DiffSLP, typename Report>
-void ExpandSLPFromLeft(const DiffSLP &_slp, std::size_t _var, std::size_t &_length, const Report &_report) {
-  assert(0 < _length);
+  T pop() {
+    assert(0 < size_);
+    --size_;
+    if (size_ < __capacity) {
+      return buffer_[size_];
+    }
 
-  if (_slp.IsTerminal(_var)) {
-    _report(_var);
-    --_length;
-    return;
+    auto value = overflow_.back();
+    overflow_.pop_back();
+    return value;
   }
 
-  const auto &children = _slp[_var];
-  ExpandSLPFromLeft(_slp, children.first, _length, _report);
+  void clear() {
+    size_ = 0;
+    overflow_.clear();
+  }
 
-  if (0 < _length) {
-    ExpandSLPFromLeft(_slp, children.second, _length, _report);
+ private:
+  T buffer_[__capacity];
+  std::size_t size_ = 0;
+  std::vector<T> overflow_;
+};
+
+
+/**
+ * Expand the range [_sp, _sp + _length) of the span of variable _var, iteratively (in-order traversal with an
+ * explicit stack).
+ *
+ * The subtrees before _sp are skipped (_skip), and the right children beyond the range are never pushed, so when the
+ * remaining length fits inside the left child (e.g., single positions) the descent is a single path. The rules of both
+ * children are prefetched before reading the span length of the left child, so the next level is loaded meanwhile.
+ *
+ * @return number of reported terminals
+ */
+template<typename DiffSLP, typename Report, typename Skip, typename Stack>
+std::size_t ExpandSLPRange(const DiffSLP &_slp,
+                           std::size_t _var,
+                           std::size_t _sp,
+                           std::size_t _length,
+                           const Report &_report,
+                           const Skip &_skip,
+                           Stack &_stack) {
+  assert(_sp < _slp.SpanLength(_var));
+
+  std::size_t n_reported = 0;
+  _stack.clear();
+  _stack.push(_var);
+  while (n_reported < _length && !_stack.empty()) {
+    auto var = _stack.pop();
+
+    while (!_slp.IsTerminal(var)) {
+      const auto children = _slp[var];
+      PrefetchRule(_slp, children.first, 0);
+      PrefetchRule(_slp, children.second, 0);
+
+      std::size_t left_child_len = _slp.SpanLength(children.first);
+      if (left_child_len <= _sp) {
+        _skip(children.first);
+        _sp -= left_child_len;
+        var = children.second;
+      } else {
+        if (left_child_len < _sp + (_length - n_reported)) {
+          _stack.push(children.second);
+        }
+        var = children.first;
+      }
+    }
+
+    assert(_sp == 0);
+    _report(var);
+    ++n_reported;
   }
+
+  return n_reported;
+}
+
+template<typename DiffSLP, typename Report>
+void ExpandSLPFromLeft(const DiffSLP &_slp, std::size_t _var, std::size_t &_length, const Report &_report) {
+  assert(0 < _length);
+
+  BoundedStack<std::size_t> stack;
+  _length -= ExpandSLPRange(_slp, _var, 0, _length, _report, NoAction(), stack);
 }
 
 template<typename DiffSLP, typename Report, typename Skip>
@@ -399,20 +1447,9 @@ void ExpandSLPFromLeft(const DiffSLP &_slp,
   assert(0 < _sp);
   assert(0 < _length);
 
-  const auto &children = _slp[_var];
-  auto left_child_len = _slp.SpanLength(children.first);
-  if (_sp < left_child_len) {
-    ExpandSLPFromLeft(_slp, children.first, _sp, _length, _report, _skip);
-  } else {
-    _skip(children.first);
-    _sp -= left_child_len;
-  }
-
-  if (0 < _sp) {
-    ExpandSLPFromLeft(_slp, children.second, _sp, _length, _report, _skip);
-  } else if (0 < _length) {
-    ExpandSLPFromLeft(_slp, children.second, _length, _report);
-  }
+  BoundedStack<std::size_t> stack;
+  _length -= ExpandSLPRange(_slp, _var, _sp, _length, _report, _skip, stack);
+  _sp = 0;
 }
 
 template<typename DiffSLP, typename Report, typename Skip>
@@ -433,14 +1470,11 @@ void ExpandSLPFromFront(const DiffSLP &_slp,
     ++_idx_root;
   }
 
-  if (0 < _sp) {
-    ExpandSLPFromLeft(_slp, root, _sp, _length, _report, _skip);
-    ++_idx_root;
-  }
+  BoundedStack<std::size_t> stack;
+  _length -= ExpandSLPRange(_slp, root, _sp, _length, _report, _skip, stack);
 
   while (0 < _length) {
-    ExpandSLPFromLeft(_slp, _slp.Root(_idx_root), _length, _report);
-    ++_idx_root;
+    _length -= ExpandSLPRange(_slp, _slp.Root(++_idx_root), 0, _length, _report, _skip, stack);
   }
 }
 
@@ -468,5 +1502,149 @@ void ExpandDifferentialSLP(const DiffSLP &_slp, std::size_t _sp, std::size_t _ep
   ExpandSLPFromFront(_slp, idx_root, sp, len, report, skip);
 }
 
+/**
+ * Inclusive prefix sum of [_first, _last) in place, starting from _init. It uses SSE2 (two 64-bit lanes per step) when
+ * it is available, and a scalar loop otherwise.
+ */
+inline void PrefixSum(int64_t *_first, int64_t *_last, int64_t _init) {
+#if defined(__SSE2__) && defined(__x86_64__)
+  __m128i carry = _mm_set1_epi64x(_init);
+  for (; _first + 2 <= _last; _first += 2) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(_first));
+    x = _mm_add_epi64(x, _mm_slli_si128(x, 8)); // [a, a + b]
+    x = _mm_add_epi64(x, carry);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(_first), x);
+    carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 2, 3, 2)); // Broadcast the last sum
+  }
+  _init = _mm_cvtsi128_si64(carry);
+#endif
+
+  for (; _first != _last; ++_first) {
+    _init += *_first;
+    *_first = _init;
+  }
+}
+
+/**
+ * Copy the first _n differences of the leaf block of _var into _out
+ */
+template<typename LeafBlocks>
+void CopyLeafBlock(const LeafBlocks &_leaf_blocks, std::size_t _var, std::size_t _n, int64_t *_out) {
+  _leaf_blocks.CopyBlock(_var, _n, _out);
+}
+
+/**
+ * Without leaf blocks there is nothing to copy (BlockLength is always 0, so it is never reached)
+ */
+inline void CopyLeafBlock(const NoLeafBlocks &_leaf_blocks, std::size_t _var, std::size_t _n, int64_t *_out) {
+  assert(false);
+}
+
+/**
+ * Write the differences of the range [_sp, _sp + _length) of the span of variable _var into _out, iteratively (as
+ * ExpandSLPRange). The variables with a leaf block that start inside the range are copied without descending.
+ *
+ * @return number of written differences
+ */
+template<typename DiffSLP, typename LeafBlocks, typename Skip, typename Stack>
+std::size_t ExpandSLPRangeToBuffer(const DiffSLP &_slp,
+                                   std::size_t _var,
+                                   std::size_t _sp,
+                                   std::size_t _length,
+                                   const LeafBlocks &_leaf_blocks,
+                                   int64_t *_out,
+                                   const Skip &_skip,
+                                   Stack &_stack) {
+  assert(_sp < _slp.SpanLength(_var));
+
+  const auto diff_base = int64_t(_slp.DifferentialBase());
+  std::size_t n_written = 0;
+  _stack.clear();
+  _stack.push(_var);
+  while (n_written < _length && !_stack.empty()) {
+    auto var = _stack.pop();
+
+    std::size_t block_length = 0;
+    while (!_slp.IsTerminal(var) && (_sp != 0 || (block_length = _leaf_blocks.BlockLength(var)) == 0)) {
+      const auto children = _slp[var];
+      PrefetchRule(_slp, children.first, 0);
+      PrefetchRule(_slp, children.second, 0);
+
+      std::size_t left_child_len = _slp.SpanLength(children.first);
+      if (left_child_len <= _sp) {
+        _skip(children.first);
+        _sp -= left_child_len;
+        var = children.second;
+      } else {
+        if (left_child_len < _sp + (_length - n_written)) {
+          _stack.push(children.second);
+        }
+        var = children.first;
+      }
+    }
+
+    assert(_sp == 0);
+    if (_slp.IsTerminal(var)) {
+      _out[n_written++] = int64_t(var) - diff_base;
+    } else {
+      auto n = std::min(block_length, _length - n_written);
+      CopyLeafBlock(_leaf_blocks, var, n, _out + n_written);
+      n_written += n;
+    }
+  }
+
+  return n_written;
+}
+
+/**
+ * Expand the values in [_sp, _ep] into the buffer _out (of at least _ep - _sp + 1 values): the differences are written
+ * first (copying the leaf blocks of the short rules) and then they are added with a vectorized prefix sum.
+ *
+ * @param _leaf_blocks Leaf blocks (e.g., DifferentialSLPLeafBlocks) or NoLeafBlocks
+ * @return number of values
+ */
+template<typename DiffSLP, typename LeafBlocks>
+std::size_t ExpandDifferentialSLPToBuffer(const DiffSLP &_slp,
+                                          std::size_t _sp,
+                                          std::size_t _ep,
+                                          int64_t *_out,
+                                          const LeafBlocks &_leaf_blocks) {
+  assert(_sp <= _ep);
+
+  auto sample = _slp.Sample(_sp);
+  auto idx_root = _slp.SampleFirstRoot(sample);
+  auto sp = _sp - _slp.SamplePosition(sample);
+  auto len = _ep - _sp + 1;
+
+  int64_t sum = _slp.SampleValue(sample);
+  auto skip = [&sum, &_slp](const auto _var) {
+    sum += int64_t(_slp.SpanSum(_var));
+  };
+
+  std::size_t root;
+  std::size_t span_length;
+  while (root = _slp.Root(idx_root), (span_length = _slp.SpanLength(root)) <= sp) {
+    skip(root);
+
+    sp -= span_length;
+    ++idx_root;
+  }
+
+  BoundedStack<std::size_t> stack;
+  auto n = ExpandSLPRangeToBuffer(_slp, root, sp, len, _leaf_blocks, _out, skip, stack);
+  while (n < len) {
+    n += ExpandSLPRangeToBuffer(_slp, _slp.Root(++idx_root), 0, len - n, _leaf_blocks, _out + n, skip, stack);
+  }
+
+  PrefixSum(_out, _out + len, sum);
+
+  return len;
+}
+
+template<typename DiffSLP>
+std::size_t ExpandDifferentialSLPToBuffer(const DiffSLP &_slp, std::size_t _sp, std::size_t _ep, int64_t *_out) {
+  return ExpandDifferentialSLPToBuffer(_slp, _sp, _ep, _out, NoLeafBlocks());
+}
+
 } // namespace grammar
 #endif //GRAMMAR_DIFFERENTIAL_SLP_H_
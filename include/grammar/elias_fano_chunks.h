@@ -0,0 +1,245 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#ifndef GRAMMAR_ELIAS_FANO_CHUNKS_H
+#define GRAMMAR_ELIAS_FANO_CHUNKS_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include "io.h"
+
+
+namespace grammar {
+
+/**
+ * Elias-Fano Chunks
+ *
+ * Sequence of sorted chunks (sets) where each chunk is encoded independently with Elias-Fano: the lower bits of each
+ * element are stored packed and the upper bits in unary, so a whole chunk is decoded sequentially with a linear scan of
+ * a few words. The chunks are stored in a single bit stream as
+ *
+ *    [length (32 bits)][low width (8 bits)][lower bits][upper bits]
+ *
+ * @tparam _Value Type of elements
+ */
+template<typename _Value = uint32_t>
+class EliasFanoChunks {
+ public:
+  typedef std::size_t size_type;
+
+  EliasFanoChunks() = default;
+
+  /**
+   * Construct from chunks of a set container (e.g., Chunks)
+   *
+   * @tparam _Chunks
+   * @param _chunks
+   */
+  template<typename _Chunks>
+  explicit EliasFanoChunks(const _Chunks &_chunks) {
+    for (std::size_t i = 1; i <= _chunks.size(); ++i) {
+      const auto &chunk = _chunks[i];
+      Insert(chunk.begin(), chunk.end());
+    }
+  }
+
+  auto size() const {
+    return pos_.size();
+  }
+
+  /**
+   * Insert a new chunk with a single element
+   *
+   * @return number of chunks
+   */
+  std::size_t Insert(_Value _value) {
+    return Insert(&_value, &_value + 1);
+  }
+
+  /**
+   * Insert a new chunk. The elements must be sorted in non-decreasing order.
+   *
+   * @return number of chunks
+   */
+  template<typename _II>
+  std::size_t Insert(_II _first, _II _last) {
+    pos_.push_back(n_bits_);
+
+    uint64_t length = std::distance(_first, _last);
+    uint64_t universe = (length == 0) ? 0 : uint64_t(*std::prev(_last)) + 1;
+    uint8_t low_width = LowWidth(universe, length);
+
+    Write(length, kLengthWidth);
+    Write(low_width, kLowWidthWidth);
+
+    // Lower bits
+    if (0 < low_width) {
+      const uint64_t low_mask = (1ULL << low_width) - 1;
+      for (auto it = _first; it != _last; ++it) {
+        Write(uint64_t(*it) & low_mask, low_width);
+      }
+    }
+
+    // Upper bits: element i sets bit (high_i + i)
+    if (0 < length) {
+      auto high_begin = n_bits_;
+      uint64_t i = 0;
+      for (auto it = _first; it != _last; ++it, ++i) {
+        assert(it == _first || *std::prev(it) <= *it);
+        SetBit(high_begin + (uint64_t(*it) >> low_width) + i);
+      }
+    }
+
+    return pos_.size();
+  }
+
+  /**
+   * Get the number of elements of chunk i
+   */
+  std::size_t ChunkLength(std::size_t i) const {
+    assert(0 < i && i <= pos_.size());
+
+    return Read(pos_[i - 1], kLengthWidth);
+  }
+
+  /**
+   * Decode chunk i into the given buffer. The buffer must have room for ChunkLength(i) elements.
+   *
+   * @return pointer past the last decoded element
+   */
+  template<typename __Value>
+  __Value *Decode(std::size_t i, __Value *_out) const {
+    assert(0 < i && i <= pos_.size());
+
+    auto bit = pos_[i - 1];
+    uint64_t length = Read(bit, kLengthWidth);
+    bit += kLengthWidth;
+    uint8_t low_width = Read(bit, kLowWidthWidth);
+    bit += kLowWidthWidth;
+
+    if (length == 0)
+      return _out;
+
+    // Lower bits
+    if (0 < low_width) {
+      auto out = _out;
+      for (uint64_t k = 0; k < length; ++k, ++out, bit += low_width) {
+        *out = Read(bit, low_width);
+      }
+    } else {
+      std::fill(_out, _out + length, 0);
+    }
+
+    // Upper bits: scan set bits word by word
+    auto word_idx = bit >> 6;
+    uint64_t word = words_[word_idx] & (~0ULL << (bit & 63));
+    uint64_t high_base = (word_idx << 6) - bit;
+    for (uint64_t k = 0; k < length; ++k, ++_out) {
+      while (word == 0) {
+        word = words_[++word_idx];
+        high_base += 64;
+      }
+
+      uint64_t high = high_base + __builtin_ctzll(word) - k;
+      *_out |= high << low_width;
+
+      word &= word - 1;
+    }
+
+    return _out;
+  }
+
+  /**
+   * Get chunk i decoded
+   */
+  std::vector<_Value> operator[](std::size_t i) const {
+    std::vector<_Value> chunk(ChunkLength(i));
+    Decode(i, chunk.data());
+    return chunk;
+  }
+
+  bool operator==(const EliasFanoChunks<_Value> &_chunks) const {
+    return n_bits_ == _chunks.n_bits_ && words_ == _chunks.words_ && pos_ == _chunks.pos_;
+  }
+
+  bool operator!=(const EliasFanoChunks<_Value> &_chunks) const {
+    return !(*this == _chunks);
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += sdsl::serialize(n_bits_, out);
+    written_bytes += sdsl::serialize(words_, out);
+    written_bytes += sdsl::serialize(pos_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(n_bits_, in);
+    sdsl::load(words_, in);
+    sdsl::load(pos_, in);
+  }
+
+ private:
+  static const uint8_t kLengthWidth = 32;
+  static const uint8_t kLowWidthWidth = 8;
+
+  uint64_t n_bits_ = 0;
+  std::vector<uint64_t> words_;
+  std::vector<uint64_t> pos_; // Starting bit of each chunk
+
+  static uint8_t LowWidth(uint64_t _universe, uint64_t _length) {
+    uint8_t width = 0;
+    if (0 < _length) {
+      auto ratio = _universe / _length;
+      while (1ULL < (ratio >> width)) ++width;
+    }
+    return width;
+  }
+
+  void Reserve(uint64_t _n_bits) {
+    auto n_words = (_n_bits >> 6) + 2; // One extra word so reads never go beyond the end
+    if (words_.size() < n_words) {
+      words_.resize(n_words, 0);
+    }
+  }
+
+  void Write(uint64_t _value, uint8_t _width) {
+    Reserve(n_bits_ + _width);
+
+    auto offset = n_bits_ & 63;
+    words_[n_bits_ >> 6] |= _value << offset;
+    if (64 < offset + _width) {
+      words_[(n_bits_ >> 6) + 1] |= _value >> (64 - offset);
+    }
+
+    n_bits_ += _width;
+  }
+
+  void SetBit(uint64_t _bit) {
+    Reserve(_bit + 1);
+
+    words_[_bit >> 6] |= 1ULL << (_bit & 63);
+    n_bits_ = std::max(n_bits_, _bit + 1);
+  }
+
+  uint64_t Read(uint64_t _bit, uint8_t _width) const {
+    auto offset = _bit & 63;
+    uint64_t value = words_[_bit >> 6] >> offset;
+    if (64 < offset + _width) {
+      value |= words_[(_bit >> 6) + 1] << (64 - offset);
+    }
+
+    return (_width == 64) ? value : value & ((1ULL << _width) - 1);
+  }
+};
+
+}
+
+#endif //GRAMMAR_ELIAS_FANO_CHUNKS_H
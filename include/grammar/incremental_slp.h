@@ -0,0 +1,401 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#ifndef GRAMMAR_INCREMENTAL_SLP_H
+#define GRAMMAR_INCREMENTAL_SLP_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "slp.h"
+
+
+namespace grammar {
+
+/**
+ * Rule Index
+ *
+ * Hash index of the right-hand sides of the rules of an SLP, used to reuse existing rules when new data is compressed
+ * against the SLP. The index is updated incrementally: only the rules added since the last update are indexed.
+ */
+class RuleIndex {
+ public:
+  /**
+   * Index the rules added to the SLP since the last update
+   */
+  template<typename _SLP>
+  void Update(const _SLP &_slp) {
+    if (n_rules_ == 0) {
+      sigma_ = _slp.Sigma();
+    }
+    assert(sigma_ == _slp.Sigma());
+
+    for (auto var = _slp.Sigma() + n_rules_ + 1; var <= _slp.Variables(); ++var) {
+      const auto &right_hand = _slp[var];
+      Insert(right_hand.first, right_hand.second, var);
+    }
+    n_rules_ = _slp.Variables() - _slp.Sigma();
+  }
+
+  /**
+   * Get the variable with right-hand side (_left, _right), or 0 if there is none
+   */
+  std::size_t Find(std::size_t _left, std::size_t _right) const {
+    auto it = index_.find(Key(_left, _right));
+    return (it != index_.end()) ? it->second : 0;
+  }
+
+  /**
+   * Get the number of indexed rules
+   */
+  std::size_t Rules() const {
+    return n_rules_;
+  }
+
+  void Clear() {
+    index_.clear();
+    n_rules_ = 0;
+  }
+
+ private:
+  std::unordered_map<uint64_t, std::size_t> index_;
+  std::size_t n_rules_ = 0;
+  std::size_t sigma_ = 0;
+
+  static uint64_t Key(uint64_t _left, uint64_t _right) {
+    return (_left << 32) | _right;
+  }
+
+  void Insert(std::size_t _left, std::size_t _right, std::size_t _var) {
+    index_.emplace(Key(_left, _right), _var); // Keep the first variable for repeated right-hand sides
+  }
+};
+
+
+/**
+ * Replace the pairs of adjacent symbols of _seq that are right-hand sides of existing rules, repeatedly (bottom-up)
+ * until no pair is replaced. Each pass is linear and greedy from left to right, but a pair overlapping the next one is
+ * left for the next one when the latter was created first (as RePair would have replaced it first).
+ */
+template<typename _Seq>
+void ReduceWithRules(const RuleIndex &_index, _Seq &_seq) {
+  bool changed = true;
+  while (changed && 1 < _seq.size()) {
+    changed = false;
+
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < _seq.size(); ++j) {
+      std::size_t var = (i + 1 < _seq.size()) ? _index.Find(_seq[i], _seq[i + 1]) : 0;
+      if (var != 0 && i + 2 < _seq.size()) {
+        auto next_var = _index.Find(_seq[i + 1], _seq[i + 2]);
+        if (next_var != 0 && next_var < var) {
+          var = 0;
+        }
+      }
+
+      if (var != 0) {
+        _seq[j] = var;
+        i += 2;
+        changed = true;
+      } else {
+        _seq[j] = _seq[i];
+        ++i;
+      }
+    }
+    _seq.resize(j);
+  }
+}
+
+
+/**
+ * Compress the sequence [_first, _last) against the rules of an existing SLP and report its compact sequence.
+ *
+ * First, the pairs that are right-hand sides of existing rules are replaced (see ReduceWithRules). Then, the
+ * remaining sequence is encoded (e.g., RePairEncoder<false>) over a dense alphabet of its distinct symbols, and the
+ * new rules are added to the SLP and to the index. The cost depends only on the length of the sequence, not on the
+ * size of the SLP.
+ *
+ * @param _slp SLP with the existing rules (its sigma bounds the terminal symbols of the sequence)
+ * @param _index Index of the rules of _slp (it is updated)
+ * @param _encoder Encoder that reports the rules and the final compact sequence
+ * @param _report_cseq Reporter of the compact sequence of [_first, _last)
+ */
+template<typename _SLP, typename _II, typename _Encoder, typename _ReportCSeq>
+void AppendToSLP(_SLP &_slp, RuleIndex &_index, _II _first, _II _last, _Encoder &_encoder, _ReportCSeq &&_report_cseq) {
+  typedef typename _SLP::VariableType VariableType;
+
+  _index.Update(_slp);
+
+  std::vector<VariableType> seq;
+  seq.reserve(std::distance(_first, _last));
+  for (; _first != _last; ++_first) {
+    auto symbol = int64_t(*_first);
+    if (symbol < 1 || int64_t(_slp.Sigma()) < symbol)
+      throw std::out_of_range("Symbol out of the alphabet of the SLP");
+    seq.emplace_back(*_first);
+  }
+
+  ReduceWithRules(_index, seq);
+
+  if (seq.size() < 2) {
+    for (const auto &item : seq) {
+      _report_cseq(item);
+    }
+    return;
+  }
+
+  // Encode over a dense alphabet
+  std::vector<VariableType> alphabet(seq);
+  std::sort(alphabet.begin(), alphabet.end());
+  alphabet.erase(std::unique(alphabet.begin(), alphabet.end()), alphabet.end());
+
+  std::vector<int> dense_seq;
+  dense_seq.reserve(seq.size());
+  for (const auto &item : seq) {
+    dense_seq.emplace_back(std::lower_bound(alphabet.begin(), alphabet.end(), item) - alphabet.begin() + 1);
+  }
+
+  struct ReportRule {
+    _SLP &slp;
+    const std::vector<VariableType> &alphabet;
+    std::vector<VariableType> new_vars;
+    std::size_t sigma = 0;
+
+    VariableType Map(std::size_t _id) const {
+      return (_id <= sigma) ? alphabet[_id - 1] : new_vars[_id - sigma - 1];
+    }
+
+    void operator()(int _sigma) {
+      sigma = _sigma;
+    }
+
+    void operator()(int _left, int _right, int _length) {
+      new_vars.emplace_back(slp.AddRule(Map(_left), Map(_right)));
+    }
+  } report_rule{_slp, alphabet};
+
+  auto report_cseq = [&report_rule, &_report_cseq](int _id) {
+    _report_cseq(report_rule.Map(_id));
+  };
+
+  _encoder.Encode(dense_seq.begin(), dense_seq.end(), report_rule, report_cseq);
+
+  _index.Update(_slp);
+}
+
+
+/**
+ * Add rules that derive the sequence [_first, _last) as a balanced binary tree, reusing the existing rules
+ *
+ * @return root of the tree
+ */
+template<typename _SLP, typename _II>
+auto AddBalancedRules(_SLP &_slp, RuleIndex &_index, _II _first, _II _last) {
+  typedef typename _SLP::VariableType VariableType;
+  assert(_first != _last);
+
+  std::vector<VariableType> level(_first, _last);
+  while (1 < level.size()) {
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < level.size(); i += 2, ++j) {
+      if (i + 1 == level.size()) {
+        level[j] = level[i];
+        continue;
+      }
+
+      _index.Update(_slp);
+      auto var = _index.Find(level[i], level[i + 1]);
+      level[j] = (var != 0) ? var : _slp.AddRule(level[i], level[i + 1]);
+    }
+    level.resize(j);
+  }
+
+  _index.Update(_slp);
+  return level[0];
+}
+
+
+/**
+ * Rooted SLP
+ *
+ * View of an SLP whose start symbol is the given variable, so the algorithms over the parse tree of the start symbol
+ * (e.g., SampledSLP::Compute) can work on the subtree of any variable.
+ *
+ * @tparam _SLP
+ */
+template<typename _SLP>
+class RootedSLP {
+ public:
+  typedef typename _SLP::size_type size_type;
+  typedef typename _SLP::VariableType VariableType;
+
+  RootedSLP(const _SLP &_slp, VariableType _root) : slp_(_slp), root_(_root) {}
+
+  auto Sigma() const {
+    return slp_.Sigma();
+  }
+
+  VariableType Variables() const {
+    return slp_.Variables();
+  }
+
+  VariableType Start() const {
+    return root_;
+  }
+
+  bool IsTerminal(VariableType i) const {
+    return slp_.IsTerminal(i);
+  }
+
+  auto operator[](VariableType i) const {
+    return slp_[i];
+  }
+
+  auto SpanLength(VariableType i) const {
+    return slp_.SpanLength(i);
+  }
+
+  auto Span(VariableType i) const {
+    return slp_.Span(i);
+  }
+
+  template<typename _OI>
+  void Span(VariableType i, _OI &&_out) const {
+    slp_.Span(i, _out);
+  }
+
+ private:
+  const _SLP &slp_;
+  VariableType root_;
+};
+
+
+template<typename _SLP>
+auto BuildRootedSLP(const _SLP &_slp, typename _SLP::VariableType _root) {
+  return RootedSLP<_SLP>(_slp, _root);
+}
+
+
+/**
+ * Incremental SLP
+ *
+ * Append-only SLP: each appended block of symbols is compressed against the existing rules (see AppendToSLP) and a
+ * balanced tree of rules is added over its compact sequence. The roots of the blocks (segments) form a forest that
+ * derives the whole sequence, as the compact sequence of a RePair encoding does, so an append only adds the rules of
+ * its block, and the variables of the previous sequence keep their ids and spans. A start symbol of the whole sequence
+ * is only built on demand (see BuildStart).
+ *
+ * @tparam _SLP
+ */
+template<typename _SLP = SLP<>>
+class IncrementalSLP : public _SLP {
+ public:
+  typedef typename _SLP::VariableType VariableType;
+
+  /**
+   * Constructor
+   *
+   * @param _sigma Size of alphabet == last symbol of alphabet (fixed, since variables are numbered after it)
+   */
+  explicit IncrementalSLP(VariableType _sigma = 0) : _SLP(_sigma) {}
+
+  /**
+   * Construct from an SLP of an existing sequence
+   */
+  explicit IncrementalSLP(const _SLP &_slp) : _SLP(_slp), start_(_slp.Start()) {
+    segments_.emplace_back(_slp.Start());
+    offsets_.emplace_back(0);
+    offsets_.emplace_back(_slp.SpanLength(_slp.Start()));
+  }
+
+  /**
+   * Append the sequence [_first, _last). The first block appended to an empty SLP must have at least two symbols, so
+   * the sequence always has a non-terminal start symbol.
+   *
+   * @param _encoder Encoder of the remaining sequence (e.g. RePairEncoder<false>)
+   * @return root variable of the appended block
+   */
+  template<typename _II, typename _Encoder>
+  VariableType Append(_II _first, _II _last, _Encoder &_encoder) {
+    if (_first == _last)
+      return 0;
+
+    if (segments_.empty() && std::distance(_first, _last) < 2)
+      throw std::invalid_argument("The first block must have at least two symbols");
+
+    std::vector<VariableType> cseq;
+    AppendToSLP(*this, index_, _first, _last, _encoder, [&cseq](auto _var) { cseq.emplace_back(_var); });
+
+    auto root = AddBalancedRules(*this, index_, cseq.begin(), cseq.end());
+
+    segments_.emplace_back(root);
+    if (offsets_.empty()) {
+      offsets_.emplace_back(0);
+    }
+    offsets_.emplace_back(offsets_.back() + _SLP::SpanLength(root));
+
+    // The start symbol of a single segment is its root; otherwise, it must be built again
+    start_ = (segments_.size() == 1) ? root : 0;
+
+    return root;
+  }
+
+  /**
+   * Build the start symbol of the whole sequence: a balanced tree of rules over the roots of the segments, reusing the
+   * existing rules. Consecutive calls reuse the rules over the segments that did not change, so each call adds
+   * O(log #segments) rules, and the height of the start symbol is O(log #segments) over the height of the segments.
+   *
+   * @return start symbol
+   */
+  VariableType BuildStart() {
+    if (start_ == 0 && !segments_.empty()) {
+      start_ = AddBalancedRules(*this, index_, segments_.begin(), segments_.end());
+    }
+
+    return start_;
+  }
+
+  /**
+   * Get the start symbol of the whole sequence built by BuildStart (0 if it is not built after the last append)
+   */
+  VariableType Start() const {
+    return start_;
+  }
+
+  /**
+   * Get the length of the whole sequence
+   */
+  std::size_t Length() const {
+    return offsets_.empty() ? 0 : offsets_.back();
+  }
+
+  /**
+   * Get the roots of the appended blocks (segments)
+   */
+  const std::vector<VariableType> &GetSegments() const {
+    return segments_;
+  }
+
+  /**
+   * Get the starting positions of the segments (and the length of the sequence at the end)
+   */
+  const std::vector<std::size_t> &GetSegmentsOffsets() const {
+    return offsets_;
+  }
+
+ protected:
+  RuleIndex index_;
+  std::vector<VariableType> segments_;
+  std::vector<std::size_t> offsets_;
+  VariableType start_ = 0;
+};
+
+}
+
+#endif //GRAMMAR_INCREMENTAL_SLP_H
@@ -0,0 +1,232 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#ifndef GRAMMAR_LEAF_MARKS_H
+#define GRAMMAR_LEAF_MARKS_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/iterators.hpp>
+#include <sdsl/util.hpp>
+
+#include "io.h"
+
+
+namespace grammar {
+
+template<uint32_t __sample>
+class SampledLeafMarksRank;
+
+template<uint32_t __sample>
+class SampledLeafMarksSelect;
+
+
+/**
+ * Sampled Leaf Marks
+ *
+ * Bit vector for the marks of the leaves of a sampled tree over the text (drop-in for _BVLeafNodesMarks in
+ * SampledSLP). It stores the positions of the ones (select is a single access) and a sampled array with the number of
+ * ones before every __sample text positions, so rank is a sample lookup followed by a short scan inside the block.
+ * Both arrays are bit-compressed. Sorted or clustered batches of rank queries (see SampledLeafMarksRank::Batch)
+ * continue the scan from the previous answer.
+ *
+ * @tparam __sample Number of text positions per sample
+ */
+template<uint32_t __sample = 64>
+class SampledLeafMarks {
+ public:
+  typedef std::size_t size_type;
+  typedef uint64_t value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef sdsl::random_access_const_iterator<SampledLeafMarks> const_iterator;
+  typedef const_iterator iterator;
+
+  typedef SampledLeafMarksRank<__sample> rank_1_type;
+  typedef SampledLeafMarksSelect<__sample> select_1_type;
+
+  SampledLeafMarks() = default;
+
+  explicit SampledLeafMarks(const sdsl::bit_vector &_bv) : size_(_bv.size()) {
+    std::size_t n_ones = 0;
+    for (std::size_t i = 0; i < _bv.size(); ++i) {
+      n_ones += _bv[i];
+    }
+
+    ones_ = sdsl::int_vector<>(n_ones, 0);
+    samples_ = sdsl::int_vector<>(size_ / __sample + 1, 0);
+
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < _bv.size(); ++i) {
+      if (_bv[i]) {
+        ones_[k++] = i;
+      }
+      if ((i + 1) % __sample == 0) {
+        samples_[(i + 1) / __sample] = k;
+      }
+    }
+
+    sdsl::util::bit_compress(ones_);
+    sdsl::util::bit_compress(samples_);
+  }
+
+  size_type size() const {
+    return size_;
+  }
+
+  /**
+   * Get the number of ones in [0, _i)
+   */
+  size_type Rank(size_type _i) const {
+    assert(_i <= size_);
+
+    return Scan(samples_[_i / __sample], _i);
+  }
+
+  /**
+   * Get the position of the _i-th one (starting at 1)
+   */
+  size_type Select(size_type _i) const {
+    assert(0 < _i && _i <= ones_.size());
+
+    return ones_[_i - 1];
+  }
+
+  /**
+   * Get the number of ones in [0, _i) continuing the scan from the number of ones _k in [0, _j), with _j <= _i
+   */
+  size_type Rank(size_type _i, size_type _j, size_type _k) const {
+    if (_i < _j || _j / __sample < _i / __sample)
+      return Rank(_i);
+
+    return Scan(_k, _i);
+  }
+
+  value_type operator[](size_type _i) const {
+    auto k = Rank(_i);
+    return k < ones_.size() && ones_[k] == _i;
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, size_);
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += sdsl::serialize(size_, out);
+    written_bytes += sdsl::serialize(ones_, out);
+    written_bytes += sdsl::serialize(samples_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(size_, in);
+    sdsl::load(ones_, in);
+    sdsl::load(samples_, in);
+  }
+
+ private:
+  std::size_t size_ = 0;
+  sdsl::int_vector<> ones_; // Positions of the ones
+  sdsl::int_vector<> samples_; // Number of ones before each sampled position
+
+  size_type Scan(size_type _k, size_type _i) const {
+    while (_k < ones_.size() && ones_[_k] < _i) ++_k;
+    return _k;
+  }
+};
+
+
+/**
+ * Rank support of SampledLeafMarks (the marks are kept by pointer, as in sdsl rank supports)
+ */
+template<uint32_t __sample = 64>
+class SampledLeafMarksRank {
+ public:
+  typedef std::size_t size_type;
+
+  explicit SampledLeafMarksRank(const SampledLeafMarks<__sample> *_marks = nullptr) : marks_(_marks) {}
+
+  size_type operator()(size_type _i) const {
+    return marks_->Rank(_i);
+  }
+
+  size_type rank(size_type _i) const {
+    return marks_->Rank(_i);
+  }
+
+  /**
+   * Compute the rank of a batch of positions. Each rank continues the scan of the previous one when both positions are
+   * in the same block (sorted or clustered positions).
+   *
+   * @return output iterator past the last rank
+   */
+  template<typename _II, typename _OI>
+  _OI Batch(_II _first, _II _last, _OI _out) const {
+    size_type prev_i = 0, prev_k = marks_->Rank(0);
+    for (; _first != _last; ++_first, ++_out) {
+      size_type i = *_first;
+      prev_k = marks_->Rank(i, prev_i, prev_k);
+      prev_i = i;
+      *_out = prev_k;
+    }
+
+    return _out;
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    return 0;
+  }
+
+  void load(std::istream &in, const SampledLeafMarks<__sample> *_marks = nullptr) {
+    marks_ = _marks;
+  }
+
+ private:
+  const SampledLeafMarks<__sample> *marks_;
+};
+
+
+/**
+ * Select support of SampledLeafMarks (the marks are kept by pointer, as in sdsl select supports)
+ */
+template<uint32_t __sample = 64>
+class SampledLeafMarksSelect {
+ public:
+  typedef std::size_t size_type;
+
+  explicit SampledLeafMarksSelect(const SampledLeafMarks<__sample> *_marks = nullptr) : marks_(_marks) {}
+
+  size_type operator()(size_type _i) const {
+    return marks_->Select(_i);
+  }
+
+  size_type select(size_type _i) const {
+    return marks_->Select(_i);
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    return 0;
+  }
+
+  void load(std::istream &in, const SampledLeafMarks<__sample> *_marks = nullptr) {
+    marks_ = _marks;
+  }
+
+ private:
+  const SampledLeafMarks<__sample> *marks_;
+};
+
+}
+
+#endif //GRAMMAR_LEAF_MARKS_H
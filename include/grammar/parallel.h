@@ -0,0 +1,304 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#ifndef GRAMMAR_PARALLEL_H
+#define GRAMMAR_PARALLEL_H
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+
+namespace grammar {
+
+/**
+ * Get the default number of threads (hardware concurrency)
+ */
+inline std::size_t DefaultThreads() {
+  return std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+
+/**
+ * Run _f(i) for each i in [0, _n) using up to _n_threads threads.
+ *
+ * Tasks are handed out dynamically through a shared counter, so idle threads take the next pending task (load
+ * balancing for tasks of uneven size). The calling thread takes part in the work. The first exception thrown by a
+ * task is rethrown after all threads finish.
+ *
+ * @tparam _Function
+ * @param _n Number of tasks
+ * @param _n_threads Number of threads
+ * @param _f Task function
+ */
+template<typename _Function>
+void ParallelFor(std::size_t _n, std::size_t _n_threads, _Function &&_f) {
+  _n_threads = std::max<std::size_t>(std::min(_n_threads, _n), 1);
+
+  if (_n_threads == 1) {
+    for (std::size_t i = 0; i < _n; ++i) {
+      _f(i);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  std::exception_ptr error;
+  std::atomic_flag error_lock = ATOMIC_FLAG_INIT;
+
+  auto worker = [&]() {
+    std::size_t i;
+    while ((i = next.fetch_add(1)) < _n) {
+      try {
+        _f(i);
+      } catch (...) {
+        if (!error_lock.test_and_set()) {
+          error = std::current_exception();
+        }
+        next = _n;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(_n_threads - 1);
+  for (std::size_t t = 1; t < _n_threads; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+
+
+/**
+ * Thread Pool
+ *
+ * Set of persistent worker threads to run ParallelFor jobs without creating threads on each call (for jobs issued
+ * with high frequency, e.g., query batches). The calling thread takes part in the work, so a pool of n threads has
+ * n - 1 workers. Jobs of a pool run one at a time.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t _n_threads = DefaultThreads()) {
+    _n_threads = std::max<std::size_t>(_n_threads, 1);
+
+    workers_.reserve(_n_threads - 1);
+    for (std::size_t t = 1; t < _n_threads; ++t) {
+      workers_.emplace_back([this]() { Work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+  }
+
+  /**
+   * Get the number of threads (including the calling one)
+   */
+  std::size_t Size() const {
+    return workers_.size() + 1;
+  }
+
+  /**
+   * Run _f(i) for each i in [0, _n) using the threads of the pool (see grammar::ParallelFor).
+   */
+  template<typename _Function>
+  void ParallelFor(std::size_t _n, _Function &&_f) {
+    if (workers_.empty() || _n <= 1) {
+      for (std::size_t i = 0; i < _n; ++i) {
+        _f(i);
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(job_mutex_);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = [&_f](std::size_t i) { _f(i); };
+      n_ = _n;
+      next_ = 0;
+      error_ = nullptr;
+      active_ = workers_.size();
+      ++generation_;
+    }
+    work_cv_.notify_all();
+
+    RunTasks();
+
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_cv_.wait(lock, [this]() { return active_ == 0; });
+      task_ = nullptr;
+      std::swap(error, error_);
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  std::vector<std::thread> workers_;
+
+  std::mutex job_mutex_; // Serializes the jobs
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+
+  std::function<void(std::size_t)> task_;
+  std::size_t n_ = 0;
+  std::atomic<std::size_t> next_{0};
+  std::exception_ptr error_;
+  std::size_t active_ = 0; // Workers still running the current job
+  std::size_t generation_ = 0; // Current job
+  bool stop_ = false;
+
+  void Work() {
+    std::size_t generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock, [this, generation]() { return stop_ || generation != generation_; });
+        if (stop_)
+          return;
+        generation = generation_;
+      }
+
+      RunTasks();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+          done_cv_.notify_one();
+        }
+      }
+    }
+  }
+
+  void RunTasks() {
+    std::size_t i;
+    while ((i = next_.fetch_add(1)) < n_) {
+      try {
+        task_(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+        next_ = n_;
+      }
+    }
+  }
+};
+
+
+/**
+ * Bounded Queue
+ *
+ * Blocking FIFO queue with a fixed capacity for producer/consumer pipelines (e.g., reading a file while its content is
+ * processed). Push blocks while the queue is full and Pop blocks while it is empty; after Close, Pop drains the
+ * remaining items and then fails.
+ *
+ * @tparam _T Type of the items
+ */
+template<typename _T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(std::size_t _capacity) : capacity_(std::max<std::size_t>(_capacity, 1)) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  /**
+   * Push an item, waiting while the queue is full
+   *
+   * @return false if the queue is closed (the item is discarded)
+   */
+  bool Push(_T _item) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_cv_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+      if (closed_)
+        return false;
+
+      items_.push_back(std::move(_item));
+    }
+    not_empty_cv_.notify_one();
+    return true;
+  }
+
+  /**
+   * Pop the next item, waiting while the queue is empty
+   *
+   * @return false if the queue is closed and empty
+   */
+  bool Pop(_T &_item) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_cv_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+      if (items_.empty())
+        return false;
+
+      _item = std::move(items_.front());
+      items_.pop_front();
+    }
+    not_full_cv_.notify_one();
+    return true;
+  }
+
+  /**
+   * Close the queue: no more items can be pushed
+   */
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_cv_.notify_all();
+    not_full_cv_.notify_all();
+  }
+
+ private:
+  std::size_t capacity_;
+  std::deque<_T> items_;
+  bool closed_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable not_empty_cv_;
+  std::condition_variable not_full_cv_;
+};
+
+}
+
+#endif //GRAMMAR_PARALLEL_H
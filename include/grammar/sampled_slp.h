@@ -6,8 +6,12 @@
 #define GRAMMAR_SAMPLED_SLP_H
 
 #include <cstdint>
+#include <cassert>
 #include <vector>
+#include <map>
 #include <iterator>
+#include <algorithm>
+#include <memory>
 
 #include <sdsl/bit_vectors.hpp>
 #include <sdsl/vlc_vector.hpp>
@@ -15,6 +19,7 @@
 #include "slp_helper.h"
 #include "slp.h"
 #include "slp_metadata.h"
+#include "leaf_marks.h"
 
 
 namespace grammar {
@@ -26,11 +31,27 @@ class AddSet {
 
   template<typename _SLP>
   void operator()(const _SLP &_slp, std::size_t _curr_var) {
+    Commit(_slp, _curr_var, Prepare(_slp, _curr_var));
+  }
+
+  /**
+   * Compute the set of the variable (thread-safe)
+   */
+  template<typename _SLP>
+  auto Prepare(const _SLP &_slp, std::size_t _curr_var) const {
     auto set = _slp.Span(_curr_var);
     sort(set.begin(), set.end());
     set.erase(unique(set.begin(), set.end()), set.end());
 
-    pts_.Insert(set.begin(), set.end());
+    return set;
+  }
+
+  /**
+   * Insert the computed set of the variable
+   */
+  template<typename _SLP, typename _Set>
+  void Commit(const _SLP &_slp, std::size_t _curr_var, const _Set &_set) {
+    pts_.Insert(_set.begin(), _set.end());
   }
 
   template<typename _SLP, typename _Nodes, typename _RangeContainer>
@@ -57,6 +78,20 @@ void Construct(_BV &_bv, const std::vector<bool> &_tmp_bv) {
 }
 
 
+template<typename _V>
+void Construct(_V &_v, const std::vector<std::pair<std::size_t, std::size_t>> &_tmp_v) {
+  assert(std::is_sorted(_tmp_v.begin(), _tmp_v.end()));
+
+  std::vector<std::size_t> v(0);
+  v.reserve(_tmp_v.size());
+  for (const auto &item : _tmp_v) {
+    v.emplace_back(item.second);
+  }
+
+  _v = _V(v);
+}
+
+
 template<typename _V>
 void Construct(_V &_v, const std::map<std::size_t, std::size_t> &_tmp_v) {
   std::vector<std::size_t> v(0);
@@ -69,6 +104,26 @@ void Construct(_V &_v, const std::map<std::size_t, std::size_t> &_tmp_v) {
 }
 
 
+/**
+ * Compute the ranks of a batch of positions with the batch support of the rank, if it has one
+ */
+template<typename _Rank, typename _II, typename _OI>
+auto RankBatch(const _Rank &_rank, _II _first, _II _last, _OI _out, int)
+-> decltype(_rank.Batch(_first, _last, _out)) {
+  return _rank.Batch(_first, _last, _out);
+}
+
+
+template<typename _Rank, typename _II, typename _OI>
+_OI RankBatch(const _Rank &_rank, _II _first, _II _last, _OI _out, long) {
+  for (; _first != _last; ++_first, ++_out) {
+    *_out = _rank(*_first);
+  }
+
+  return _out;
+}
+
+
 template<typename _BVLeafNodesMarks = sdsl::sd_vector<>,
     typename _BVLeafNodesMarksRank = typename _BVLeafNodesMarks::rank_1_type,
     typename _BVLeafNodesMarksSelect = typename _BVLeafNodesMarks::select_1_type,
@@ -87,19 +142,28 @@ class SampledSLP {
              uint32_t _block_size,
              _LeafAction &&_leaf_action,
              _NodeAction &&_node_action,
-             const _Predicate &_pred) {
-    Compute(_slp, _block_size, _leaf_action, _node_action, _pred);
+             const _Predicate &_pred,
+             std::size_t _n_threads = 1) {
+    Compute(_slp, _block_size, _leaf_action, _node_action, _pred, _n_threads);
   }
 
+  /**
+   * Compute the sampled tree
+   *
+   * With several threads, the leaves are computed in parallel (see ComputeSampledSLPLeavesParallel) and the result is
+   * identical to the serial one. The inner nodes are always computed serially, since the predicate may depend on the
+   * data added by the actions of the previous nodes.
+   */
   template<typename _SLP, typename _LeafAction, typename _NodeAction, typename _Predicate>
   void Compute(const _SLP &_slp,
                uint32_t _block_size,
                _LeafAction &&_leaf_action,
                _NodeAction &&_node_action,
-               const _Predicate &_pred) {
+               const _Predicate &_pred,
+               std::size_t _n_threads = 1) {
     std::vector<typename _SLP::VariableType> nodes;
 
-    ComputeSampledSLPLeaves(_slp, _block_size, back_inserter(nodes), _leaf_action);
+    ComputeSampledSLPLeavesParallel(_slp, _block_size, back_inserter(nodes), _leaf_action, _n_threads);
 
     l = nodes.size();
 
@@ -117,8 +181,8 @@ class SampledSLP {
     }
 
     std::vector<bool> tmp_b_f(nodes.size(), 0);
-    std::map<std::size_t, std::size_t> tmp_f;
-    std::map<std::size_t, std::size_t> tmp_n;
+    std::vector<std::pair<std::size_t, std::size_t>> tmp_f; // (first child, parent node)
+    std::vector<std::size_t> tmp_n; // indexed by node
 
     auto build_inner_data = [&_node_action, &tmp_b_f, &tmp_f, &tmp_n, this](
         const _SLP &_slp,
@@ -133,13 +197,16 @@ class SampledSLP {
       tmp_b_f[_left_ranges.front()] = 1;
 
       auto nn = _new_node - l;
-      tmp_f[_left_ranges.front()] = nn;
+      assert(nn == tmp_n.size());
+      tmp_f.emplace_back(_left_ranges.front(), nn);
       auto last_child = _right_ranges.back() + 1;
-      tmp_n[nn] = (last_child <= l) ? last_child : tmp_n[last_child - l - 1];
+      tmp_n.emplace_back((last_child <= l) ? last_child : tmp_n[last_child - l - 1]);
     };
 
     ComputeSampledSLPNodes(_slp, _block_size, nodes, _pred, build_inner_data);
 
+    std::sort(tmp_f.begin(), tmp_f.end());
+
     Construct(b_f, tmp_b_f);
     b_f_rank = _BVFirstChildrenRank(&b_f);
 
@@ -155,6 +222,41 @@ class SampledSLP {
     return b_l_select(_leaf);
   }
 
+  /**
+   * Get the leaves of a batch of positions. Sorted or clustered positions benefit from leaf marks with batch rank
+   * support (e.g., SampledLeafMarks).
+   *
+   * @return output iterator past the last leaf
+   */
+  template<typename _II, typename _OI>
+  _OI Leaves(_II _first, _II _last, _OI _out) const {
+    std::size_t buffer[kBatchSize];
+    while (_first != _last) {
+      std::size_t size = 0;
+      for (; size < kBatchSize && _first != _last; ++size, ++_first) {
+        buffer[size] = *_first + 1;
+      }
+
+      _out = RankBatch(b_l_rank, buffer, buffer + size, _out, 0);
+    }
+
+    return _out;
+  }
+
+  /**
+   * Get the positions of a batch of leaves
+   *
+   * @return output iterator past the last position
+   */
+  template<typename _II, typename _OI>
+  _OI Positions(_II _first, _II _last, _OI _out) const {
+    for (; _first != _last; ++_first, ++_out) {
+      *_out = b_l_select(*_first);
+    }
+
+    return _out;
+  }
+
   std::pair<std::size_t, std::size_t> Parent(std::size_t _i) const {
     auto p = f[b_f_rank(_i) - 1];
     return {l + p + 1, n[p] + 1};
@@ -225,6 +327,116 @@ class SampledSLP {
   _BVFirstChildrenRank b_f_rank;
   _Parents f;
   _NextLeaves n;
+
+  static const std::size_t kBatchSize = 256; // Positions per batch rank
+};
+
+
+/**
+ * Sampled SLP with flat parents
+ *
+ * Navigation backend for the sampled tree that trades space for speed in the bottom-up climbs (e.g.
+ * ComputeCoverFromBottom). Besides the structures of the underlying sampled SLP, it stores for each node its parent
+ * (0 if it is not a first child) and the leaf next to the parent's span, so IsFirstChild and Parent are a single
+ * access each, without rank or variable-length decoding. The space is chosen with the container: a bit-compressed
+ * sdsl::int_vector<> (default) or a plain std::vector of fixed-width integers (faster).
+ *
+ * @tparam _SampledSLP Underlying sampled SLP
+ * @tparam _Parents Container of the flat parents
+ */
+template<typename _SampledSLP = SampledSLP<>, typename _Parents = sdsl::int_vector<>>
+class FlatParentsSampledSLP : public _SampledSLP {
+ public:
+  typedef std::size_t size_type;
+
+  FlatParentsSampledSLP() = default;
+
+  template<typename _SLP, typename _LeafAction, typename _NodeAction, typename _Predicate>
+  FlatParentsSampledSLP(const _SLP &_slp,
+                        uint32_t _block_size,
+                        _LeafAction &&_leaf_action,
+                        _NodeAction &&_node_action,
+                        const _Predicate &_pred,
+                        std::size_t _n_threads = 1) {
+    Compute(_slp, _block_size, _leaf_action, _node_action, _pred, _n_threads);
+  }
+
+  template<typename _SLP, typename _LeafAction, typename _NodeAction, typename _Predicate>
+  void Compute(const _SLP &_slp,
+               uint32_t _block_size,
+               _LeafAction &&_leaf_action,
+               _NodeAction &&_node_action,
+               const _Predicate &_pred,
+               std::size_t _n_threads = 1) {
+    _SampledSLP::Compute(_slp, _block_size, _leaf_action, _node_action, _pred, _n_threads);
+
+    ComputeFlatParents();
+  }
+
+  std::pair<std::size_t, std::size_t> Parent(std::size_t _i) const {
+    return {fp_[_i - 1], fn_[_i - 1]};
+  }
+
+  bool IsFirstChild(std::size_t _i) const {
+    return fp_[_i - 1] != 0;
+  }
+
+  bool operator==(const FlatParentsSampledSLP<_SampledSLP, _Parents> &_sampled_slp) const {
+    return _SampledSLP::operator==(_sampled_slp) &&
+        fp_.size() == _sampled_slp.fp_.size() && std::equal(fp_.begin(), fp_.end(), _sampled_slp.fp_.begin()) &&
+        fn_.size() == _sampled_slp.fn_.size() && std::equal(fn_.begin(), fn_.end(), _sampled_slp.fn_.begin());
+  }
+
+  bool operator!=(const FlatParentsSampledSLP<_SampledSLP, _Parents> &_sampled_slp) const {
+    return !(*this == _sampled_slp);
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += _SampledSLP::serialize(out);
+    written_bytes += sdsl::serialize(fp_, out);
+    written_bytes += sdsl::serialize(fn_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    _SampledSLP::load(in);
+    sdsl::load(fp_, in);
+    sdsl::load(fn_, in);
+  }
+
+ protected:
+  _Parents fp_; // Parent of each node (0 if the node is not a first child)
+  _Parents fn_; // Leaf next to the span of the parent of each first child
+
+  void ComputeFlatParents() {
+    std::vector<std::size_t> tmp_fp(this->b_f.size(), 0);
+    std::vector<std::size_t> tmp_fn(this->b_f.size(), 0);
+
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < this->b_f.size(); ++i) {
+      if (this->b_f[i]) {
+        auto p = this->f[k++];
+        tmp_fp[i] = this->l + p + 1;
+        tmp_fn[i] = this->n[p] + 1;
+      }
+    }
+
+    ConstructFlat(fp_, tmp_fp);
+    ConstructFlat(fn_, tmp_fn);
+  }
+
+  template<typename _V>
+  static void ConstructFlat(_V &_v, const std::vector<std::size_t> &_tmp_v) {
+    _v = _V(_tmp_v.begin(), _tmp_v.end());
+  }
+
+  static void ConstructFlat(sdsl::int_vector<> &_v, const std::vector<std::size_t> &_tmp_v) {
+    _v = sdsl::int_vector<>(_tmp_v.size(), 0);
+    std::copy(_tmp_v.begin(), _tmp_v.end(), _v.begin());
+    sdsl::util::bit_compress(_v);
+  }
 };
 
 
@@ -240,14 +452,17 @@ class CombinedSLP : public _SLP, public _SampledSLP {
   CombinedSLP(const _SLP &_slp) : _SLP(_slp) {}
 
   template<typename _LeafAction, typename _NodeAction, typename _Predicate>
-  void Compute(uint32_t _block_size, _LeafAction &&_leaf_action, _NodeAction &&_node_action, const _Predicate &_pred) {
-    auto leaf_action = [this, &_leaf_action](const auto &_slp, auto _curr_var) {
-      _leaf_action(_slp, _curr_var);
-
+  void Compute(uint32_t _block_size,
+               _LeafAction &&_leaf_action,
+               _NodeAction &&_node_action,
+               const _Predicate &_pred,
+               std::size_t _n_threads = 1) {
+    auto report_leaf = [this](auto _curr_var) {
       leaves_.push_back(_curr_var);
     };
+    auto leaf_action = BuildReportLeafAction(_leaf_action, report_leaf);
 
-    _SampledSLP::Compute(*this, _block_size, leaf_action, _node_action, _pred);
+    _SampledSLP::Compute(*this, _block_size, leaf_action, _node_action, _pred, _n_threads);
   }
 
   auto Map(std::size_t _leaf) const {
@@ -313,7 +528,7 @@ class LightSLP : public _SLP, public _SampledSLP {
                                                       covers_(_lslp.GetCovers(), _chunks_act1, _chunks_act2) {}
 
   template<typename _II, typename _Encoder, typename _CombinedSLP>
-  void Compute(_II _first, _II _last, _Encoder _encoder, const _CombinedSLP &_cslp) {
+  void Compute(_II _first, _II _last, _Encoder _encoder, const _CombinedSLP &_cslp, std::size_t _n_threads = 1) {
     std::vector<typename _SLP::VariableType> cseq;
 
     auto report_cseq = [&cseq](auto v) {
@@ -333,13 +548,13 @@ class LightSLP : public _SLP, public _SampledSLP {
       covers_.Insert(_set.begin(), _set.end());
     };
 
-    ComputePartitionCover(*this, cseq, leaves, get_length, action, 0);
+    ComputePartitionCover(*this, cseq, leaves, get_length, action, 0, _n_threads);
 
     _SampledSLP::operator=(_cslp);
   }
 
   template<typename _CSeq, typename _CombinedSLP>
-  void Compute(const _SLP &_slp, const _CSeq &_cseq, const _CombinedSLP &_cslp) {
+  void Compute(const _SLP &_slp, const _CSeq &_cseq, const _CombinedSLP &_cslp, std::size_t _n_threads = 1) {
     _SLP::operator=(_slp);
 
     const auto &leaves = _cslp.GetLeaves();
@@ -352,7 +567,7 @@ class LightSLP : public _SLP, public _SampledSLP {
       covers_.Insert(_set.begin(), _set.end());
     };
 
-    ComputePartitionCover(*this, _cseq, leaves, get_length, action, 0);
+    ComputePartitionCover(*this, _cseq, leaves, get_length, action, 0, _n_threads);
 
     _SampledSLP::operator=(_cslp);
   }
@@ -396,6 +611,230 @@ class LightSLP : public _SLP, public _SampledSLP {
   _Chunks covers_;
 };
 
+
+
+/**
+ * Incremental Sampled SLP
+ *
+ * Sampled tree of an append-only SLP (see IncrementalSLP), kept as a sequence of segments: an immutable sampled tree
+ * (_SampledSLP) over the root of each appended block, so an append only computes the sampled tree of the new block.
+ * The nodes are numbered in the order the actions see them (leaves and then inner nodes of each segment, segment after
+ * segment, starting at 1), so containers filled by the actions (e.g., AddSet into Chunks) are indexed by these ids.
+ *
+ * @tparam _SampledSLP
+ */
+template<typename _SampledSLP = SampledSLP<>>
+class IncrementalSampledSLP {
+ public:
+  typedef std::size_t size_type;
+
+  IncrementalSampledSLP() = default;
+
+  /**
+   * Append the sampled tree of the block with root variable _root
+   */
+  template<typename _SLP, typename _LeafAction, typename _NodeAction, typename _Predicate>
+  void Append(const _SLP &_slp,
+              std::size_t _root,
+              uint32_t _block_size,
+              _LeafAction &&_leaf_action,
+              _NodeAction &&_node_action,
+              const _Predicate &_pred,
+              std::size_t _n_threads = 1) {
+    std::size_t n_nodes = 0;
+
+    auto report_leaf = [&n_nodes](auto _var) {
+      ++n_nodes;
+    };
+    auto leaf_action = BuildReportLeafAction(_leaf_action, report_leaf);
+
+    auto node_action = [&_node_action, &n_nodes](const auto &_rooted_slp,
+                                                  std::size_t _curr_var,
+                                                  const auto &_nodes,
+                                                  std::size_t _new_node,
+                                                  const auto &_left_ranges,
+                                                  const auto &_right_ranges) {
+      _node_action(_rooted_slp, _curr_var, _nodes, _new_node, _left_ranges, _right_ranges);
+      ++n_nodes;
+    };
+
+    // The children of the segment are local ids: the predicate sees them shifted to the global ids (as indexed by the
+    // containers filled by the actions). A copy of the predicate is used for each segment, so its memo does not carry
+    // the decisions of the previous segments, and its memo is flat only over the variables added since the last
+    // append (the older variables reached by the segment are memoized sparsely), so it does not depend on the size of
+    // the whole SLP.
+    const auto node_offset = node_offsets_.back();
+    auto pred = _pred;
+    ResetPredicateMemo(pred, n_vars_ + 1);
+    std::vector<std::size_t> lchildren, rchildren;
+    auto segment_pred = [&pred, node_offset, &lchildren, &rchildren](const auto &_rooted_slp,
+                                                                     std::size_t _curr_var,
+                                                                     const auto &_left_ranges,
+                                                                     const auto &_right_ranges) {
+      auto shift = [node_offset](const auto &_ranges, std::vector<std::size_t> &_shifted) {
+        _shifted.clear();
+        for (const auto &item : _ranges) {
+          _shifted.emplace_back(item + node_offset);
+        }
+      };
+      shift(_left_ranges, lchildren);
+      shift(_right_ranges, rchildren);
+
+      return pred(_rooted_slp,
+                  _curr_var,
+                  ChildrenRange(lchildren.cbegin(), lchildren.cend()),
+                  ChildrenRange(rchildren.cbegin(), rchildren.cend()));
+    };
+
+    // Segments are kept by pointer, since the rank/select supports point to their bit vectors
+    segments_.emplace_back(new _SampledSLP());
+    segments_.back()->Compute(
+        BuildRootedSLP(_slp, _root), _block_size, leaf_action, node_action, segment_pred, _n_threads);
+
+    text_offsets_.emplace_back(text_offsets_.back() + _slp.SpanLength(_root));
+    node_offsets_.emplace_back(node_offsets_.back() + n_nodes);
+    n_vars_ = _slp.Variables();
+  }
+
+  /**
+   * Append the sampled trees of the segments of an IncrementalSLP that are not sampled yet
+   */
+  template<typename _IncrementalSLP, typename _LeafAction, typename _NodeAction, typename _Predicate>
+  void Update(const _IncrementalSLP &_slp,
+              uint32_t _block_size,
+              _LeafAction &&_leaf_action,
+              _NodeAction &&_node_action,
+              const _Predicate &_pred,
+              std::size_t _n_threads = 1) {
+    const auto &roots = _slp.GetSegments();
+    for (auto i = segments_.size(); i < roots.size(); ++i) {
+      Append(_slp, roots[i], _block_size, _leaf_action, _node_action, _pred, _n_threads);
+    }
+  }
+
+  std::size_t Segments() const {
+    return segments_.size();
+  }
+
+  /**
+   * Get the length of the sampled sequence
+   */
+  std::size_t Length() const {
+    return text_offsets_.back();
+  }
+
+  /**
+   * Get the number of nodes
+   */
+  std::size_t Nodes() const {
+    return node_offsets_.back();
+  }
+
+  /**
+   * Get the leaf (node id) that contains position _pos
+   */
+  std::size_t Leaf(std::size_t _pos) const {
+    auto s = SegmentOfPosition(_pos);
+    return node_offsets_[s] + segments_[s]->Leaf(_pos - text_offsets_[s]);
+  }
+
+  /**
+   * Get the starting position of leaf _leaf (node id)
+   */
+  std::size_t Position(std::size_t _leaf) const {
+    auto s = std::upper_bound(node_offsets_.begin(), node_offsets_.end(), _leaf - 1) - node_offsets_.begin() - 1;
+    return text_offsets_[s] + segments_[s]->Position(_leaf - node_offsets_[s]);
+  }
+
+  /**
+   * Compute the cover of [_bp, _ep) with nodes (see ComputeCoverFromBottom), segment by segment
+   *
+   * @return range of positions covered by the reported nodes
+   */
+  template<typename _Report>
+  std::pair<std::size_t, std::size_t> Cover(std::size_t _bp, std::size_t _ep, _Report &&_report) const {
+    assert(_bp <= _ep && _ep <= Length());
+
+    std::pair<std::size_t, std::size_t> range{_bp, _bp};
+    for (auto s = SegmentOfPosition(_bp); s < segments_.size() && text_offsets_[s] < _ep; ++s) {
+      auto offset = text_offsets_[s];
+      auto node_offset = node_offsets_[s];
+      auto report = [&_report, node_offset](auto _node) {
+        _report(node_offset + _node);
+      };
+
+      auto local_range = ComputeCoverFromBottom(*segments_[s],
+                                                std::max(_bp, offset) - offset,
+                                                std::min(_ep, text_offsets_[s + 1]) - offset,
+                                                report);
+      if (offset <= _bp) {
+        range.first = offset + local_range.first;
+      }
+      range.second = offset + local_range.second;
+    }
+
+    return range;
+  }
+
+  const _SampledSLP &GetSegment(std::size_t i) const {
+    return *segments_[i];
+  }
+
+  bool operator==(const IncrementalSampledSLP<_SampledSLP> &_sampled_slp) const {
+    if (text_offsets_ != _sampled_slp.text_offsets_ || node_offsets_ != _sampled_slp.node_offsets_)
+      return false;
+
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+      if (*segments_[i] != *_sampled_slp.segments_[i])
+        return false;
+    }
+
+    return true;
+  }
+
+  bool operator!=(const IncrementalSampledSLP<_SampledSLP> &_sampled_slp) const {
+    return !(*this == _sampled_slp);
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    std::size_t written_bytes = 0;
+    written_bytes += sdsl::serialize(segments_.size(), out);
+    for (const auto &segment : segments_) {
+      written_bytes += segment->serialize(out);
+    }
+    written_bytes += sdsl::serialize(text_offsets_, out);
+    written_bytes += sdsl::serialize(node_offsets_, out);
+    written_bytes += sdsl::serialize(n_vars_, out);
+
+    return written_bytes;
+  }
+
+  void load(std::istream &in) {
+    std::size_t n_segments = 0;
+    sdsl::load(n_segments, in);
+
+    segments_.clear();
+    for (std::size_t i = 0; i < n_segments; ++i) {
+      segments_.emplace_back(new _SampledSLP());
+      segments_.back()->load(in);
+    }
+    sdsl::load(text_offsets_, in);
+    sdsl::load(node_offsets_, in);
+    sdsl::load(n_vars_, in);
+  }
+
+ protected:
+  std::vector<std::unique_ptr<_SampledSLP>> segments_;
+  std::vector<std::size_t> text_offsets_{0}; // Starting position of each segment (and length at the end)
+  std::vector<std::size_t> node_offsets_{0}; // Number of nodes before each segment (and total at the end)
+  std::size_t n_vars_ = 0; // Number of variables of the SLP at the last append
+
+  std::size_t SegmentOfPosition(std::size_t _pos) const {
+    auto s = std::upper_bound(text_offsets_.begin(), text_offsets_.end(), _pos) - text_offsets_.begin() - 1;
+    return std::min<std::size_t>(s, segments_.size() - 1);
+  }
+};
+
 }
 
 #endif //GRAMMAR_SAMPLED_SLP_H
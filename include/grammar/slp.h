@@ -9,12 +9,43 @@
 #include <utility>
 #include <cassert>
 
+#include <sdsl/int_vector.hpp>
+
 #include "utility.h"
 #include "io.h"
 
 
 namespace grammar {
 
+/**
+ * Prefetch (hint) the cache line of element i of a contiguous container
+ */
+template<typename _Container>
+void PrefetchElement(const _Container &_container, std::size_t i) {
+  __builtin_prefetch(_container.data() + i);
+}
+
+
+template<uint8_t __width>
+void PrefetchElement(const sdsl::int_vector<__width> &_container, std::size_t i) {
+  __builtin_prefetch(_container.data() + ((i * _container.width()) >> 6));
+}
+
+
+/**
+ * Prefetch the rule of variable _var of an SLP, if it supports it (call with 0 as last argument)
+ */
+template<typename _SLP>
+auto PrefetchRule(const _SLP &_slp, std::size_t _var, int) -> decltype(_slp.Prefetch(_var), void()) {
+  _slp.Prefetch(_var);
+}
+
+
+template<typename _SLP>
+void PrefetchRule(const _SLP &_slp, std::size_t _var, long) {
+}
+
+
 /**
  * Straight-Line Program
  *
@@ -115,6 +146,15 @@ class BasicSLP {
     return i <= sigma_;
   }
 
+  /**
+   * Prefetch the rule of i (hint for the next access)
+   */
+  void Prefetch(VariableType i) const {
+    if (!IsTerminal(i)) {
+      PrefetchElement(rules_, (i - sigma_ - 1) * 2);
+    }
+  }
+
   /**
    * Get span of rule i
    *
@@ -270,6 +310,16 @@ class SLP : public BasicSLP<_VarsContainer> {
     return lengths_[i - BasicSLP<_VarsContainer>::Sigma() - 1];
   }
 
+  /**
+   * Prefetch the rule and the span length of i (hint for the next access)
+   */
+  void Prefetch(VariableType i) const {
+    if (!BasicSLP<_VarsContainer>::IsTerminal(i)) {
+      BasicSLP<_VarsContainer>::Prefetch(i);
+      PrefetchElement(lengths_, i - BasicSLP<_VarsContainer>::Sigma() - 1);
+    }
+  }
+
   /**
    * Reset
    *
@@ -0,0 +1,456 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#ifndef GRAMMAR_SLP_AGGREGATES_H
+#define GRAMMAR_SLP_AGGREGATES_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "io.h"
+
+
+namespace grammar {
+
+/**
+ * Monoids for SLPAggregates. Each one defines its value_type, the identity and the (associative) combine operation.
+ */
+template<typename _T = int64_t>
+struct SumMonoid {
+  typedef _T value_type;
+
+  static value_type Identity() {
+    return 0;
+  }
+
+  static value_type Combine(const value_type &_a, const value_type &_b) {
+    return _a + _b;
+  }
+};
+
+
+template<typename _T = int64_t>
+struct MinMonoid {
+  typedef _T value_type;
+
+  static value_type Identity() {
+    return std::numeric_limits<value_type>::max();
+  }
+
+  static value_type Combine(const value_type &_a, const value_type &_b) {
+    return std::min(_a, _b);
+  }
+};
+
+
+template<typename _T = int64_t>
+struct MaxMonoid {
+  typedef _T value_type;
+
+  static value_type Identity() {
+    return std::numeric_limits<value_type>::lowest();
+  }
+
+  static value_type Combine(const value_type &_a, const value_type &_b) {
+    return std::max(_a, _b);
+  }
+};
+
+
+template<typename _T = uint64_t>
+struct XorMonoid {
+  typedef _T value_type;
+
+  static value_type Identity() {
+    return 0;
+  }
+
+  static value_type Combine(const value_type &_a, const value_type &_b) {
+    return _a ^ _b;
+  }
+};
+
+
+/**
+ * Count monoid: the value of a terminal is 1 if it satisfies a predicate and 0 otherwise (see CountLift)
+ */
+template<typename _T = uint64_t>
+using CountMonoid = SumMonoid<_T>;
+
+
+/**
+ * Prefix extrema of a sequence of differences
+ *
+ * Sum of the differences and minimum/maximum of their (non-empty) prefix sums, i.e., the minimum/maximum of the values
+ * decoded from the differences relative to the value before them. The combine is associative but not commutative.
+ */
+template<typename _T = int64_t>
+struct PrefixExtrema {
+  _T sum;
+  _T min;
+  _T max;
+
+  bool operator==(const PrefixExtrema &_pe) const {
+    return sum == _pe.sum && min == _pe.min && max == _pe.max;
+  }
+
+  bool operator!=(const PrefixExtrema &_pe) const {
+    return !(*this == _pe);
+  }
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    return sdsl::serialize(sum, out) + sdsl::serialize(min, out) + sdsl::serialize(max, out);
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(sum, in);
+    sdsl::load(min, in);
+    sdsl::load(max, in);
+  }
+};
+
+
+template<typename _T = int64_t>
+struct PrefixExtremaMonoid {
+  typedef PrefixExtrema<_T> value_type;
+
+  static value_type Identity() {
+    return {0, std::numeric_limits<_T>::max(), std::numeric_limits<_T>::lowest()};
+  }
+
+  static value_type Combine(const value_type &_a, const value_type &_b) {
+    // The extrema of the identity (empty sequence) are not shifted, to avoid overflows
+    return {_a.sum + _b.sum,
+            std::min(_a.min, _b.min == std::numeric_limits<_T>::max() ? _b.min : _a.sum + _b.min),
+            std::max(_a.max, _b.max == std::numeric_limits<_T>::lowest() ? _b.max : _a.sum + _b.max)};
+  }
+
+  /**
+   * Value of a single difference
+   */
+  static value_type Lift(_T _diff) {
+    return {_diff, _diff, _diff};
+  }
+};
+
+
+/**
+ * Prefix sums of a sequence of differences
+ *
+ * Length and sum of the differences, and sum of their prefix sums, i.e., the sum of the values decoded from the
+ * differences relative to the value before them. The combine is associative but not commutative.
+ */
+template<typename _T = int64_t>
+struct PrefixSums {
+  _T length;
+  _T sum;
+  _T prefix_sums;
+
+  bool operator==(const PrefixSums &_ps) const {
+    return length == _ps.length && sum == _ps.sum && prefix_sums == _ps.prefix_sums;
+  }
+
+  bool operator!=(const PrefixSums &_ps) const {
+    return !(*this == _ps);
+  }
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    return sdsl::serialize(length, out) + sdsl::serialize(sum, out) + sdsl::serialize(prefix_sums, out);
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(length, in);
+    sdsl::load(sum, in);
+    sdsl::load(prefix_sums, in);
+  }
+};
+
+
+template<typename _T = int64_t>
+struct PrefixSumsMonoid {
+  typedef PrefixSums<_T> value_type;
+
+  static value_type Identity() {
+    return {0, 0, 0};
+  }
+
+  static value_type Combine(const value_type &_a, const value_type &_b) {
+    return {_a.length + _b.length, _a.sum + _b.sum, _a.prefix_sums + _b.prefix_sums + _b.length * _a.sum};
+  }
+
+  /**
+   * Value of a single difference
+   */
+  static value_type Lift(_T _diff) {
+    return {1, _diff, _diff};
+  }
+};
+
+
+/**
+ * Lift of the terminals for the count monoid
+ */
+template<typename _Predicate>
+class CountLift {
+ public:
+  CountLift(const _Predicate &_pred) : pred_(_pred) {}
+
+  uint64_t operator()(std::size_t _terminal) const {
+    return pred_(_terminal) ? 1 : 0;
+  }
+
+ private:
+  _Predicate pred_;
+};
+
+
+template<typename _Predicate>
+auto BuildCountLift(const _Predicate &_pred) {
+  return CountLift<_Predicate>(_pred);
+}
+
+
+/**
+ * SLP Aggregates
+ *
+ * Aggregate (over a monoid) of the span of each variable of an SLP, computed bottom-up in one pass over the rules. It
+ * answers the aggregate of any range of the span of a variable in O(height), combining the aggregates of the maximal
+ * subtrees covered by the range (as the span-sum skip of ExpandSLPFromFront does for sums).
+ *
+ * @tparam _Monoid Monoid (value_type, Identity, Combine)
+ * @tparam _Container Container of values
+ */
+template<typename _Monoid, typename _Container = std::vector<typename _Monoid::value_type>>
+class SLPAggregates {
+ public:
+  typedef _Monoid monoid_type;
+  typedef typename _Monoid::value_type value_type;
+  typedef std::size_t size_type;
+
+  SLPAggregates() = default;
+
+  template<typename _SLP, typename _Lift>
+  SLPAggregates(const _SLP &_slp, const _Lift &_lift) {
+    Compute(_slp, _lift);
+  }
+
+  /**
+   * Compute the aggregates
+   *
+   * @param _slp
+   * @param _lift Value of each terminal (_lift(terminal) -> value_type)
+   */
+  template<typename _SLP, typename _Lift>
+  void Compute(const _SLP &_slp, const _Lift &_lift) {
+    values_ = _Container(_slp.Variables() + 1);
+    values_[0] = _Monoid::Identity();
+
+    std::size_t i = 1;
+    for (; i <= _slp.Sigma(); ++i) {
+      values_[i] = _lift(i);
+    }
+
+    for (; i <= _slp.Variables(); ++i) {
+      const auto &children = _slp[i];
+      values_[i] = _Monoid::Combine(values_[children.first], values_[children.second]);
+    }
+  }
+
+  /**
+   * Get the aggregate of the span of variable _var
+   */
+  value_type operator[](std::size_t _var) const {
+    return values_[_var];
+  }
+
+  std::size_t size() const {
+    return values_.size();
+  }
+
+  /**
+   * Get the aggregate of the range [_bp, _ep) of the span of variable _var
+   */
+  template<typename _SLP>
+  value_type Aggregate(const _SLP &_slp, std::size_t _var, std::size_t _bp, std::size_t _ep) const {
+    assert(_bp <= _ep && _ep <= _slp.SpanLength(_var));
+
+    if (_bp == _ep)
+      return _Monoid::Identity();
+
+    // Descend until the range is split between the children
+    while (_bp != 0 || _ep != _slp.SpanLength(_var)) {
+      const auto &children = _slp[_var];
+      auto left_length = _slp.SpanLength(children.first);
+
+      if (_ep <= left_length) {
+        _var = children.first;
+      } else if (left_length <= _bp) {
+        _var = children.second;
+        _bp -= left_length;
+        _ep -= left_length;
+      } else {
+        return _Monoid::Combine(Suffix(_slp, children.first, _bp), Prefix(_slp, children.second, _ep - left_length));
+      }
+    }
+
+    return values_[_var];
+  }
+
+  /**
+   * Get the aggregate of the suffix [_bp, |span|) of the span of variable _var
+   */
+  template<typename _SLP>
+  value_type Suffix(const _SLP &_slp, std::size_t _var, std::size_t _bp) const {
+    auto result = _Monoid::Identity();
+    while (_bp != 0) {
+      const auto &children = _slp[_var];
+      auto left_length = _slp.SpanLength(children.first);
+
+      if (_bp < left_length) {
+        result = _Monoid::Combine(values_[children.second], result);
+        _var = children.first;
+      } else {
+        _var = children.second;
+        _bp -= left_length;
+      }
+    }
+
+    return _Monoid::Combine(values_[_var], result);
+  }
+
+  /**
+   * Get the aggregate of the prefix [0, _ep) of the span of variable _var
+   */
+  template<typename _SLP>
+  value_type Prefix(const _SLP &_slp, std::size_t _var, std::size_t _ep) const {
+    if (_ep == 0)
+      return _Monoid::Identity();
+
+    auto result = _Monoid::Identity();
+    while (_ep != _slp.SpanLength(_var)) {
+      const auto &children = _slp[_var];
+      auto left_length = _slp.SpanLength(children.first);
+
+      if (_ep <= left_length) {
+        _var = children.first;
+      } else {
+        result = _Monoid::Combine(result, values_[children.first]);
+        _var = children.second;
+        _ep -= left_length;
+      }
+    }
+
+    return _Monoid::Combine(result, values_[_var]);
+  }
+
+  bool operator==(const SLPAggregates &_aggregates) const {
+    return values_ == _aggregates.values_;
+  }
+
+  bool operator!=(const SLPAggregates &_aggregates) const {
+    return !(*this == _aggregates);
+  }
+
+  std::size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, const std::string &name = "") const {
+    return sdsl::serialize(values_, out);
+  }
+
+  void load(std::istream &in) {
+    sdsl::load(values_, in);
+  }
+
+ private:
+  _Container values_; // Aggregate of each variable (0 is not used)
+};
+
+
+/**
+ * Get the aggregate of the range [_bp, _ep) of the sequence of an SLP (span of its start symbol)
+ */
+template<typename _SLP, typename _Aggregates>
+auto RangeAggregate(const _SLP &_slp, const _Aggregates &_aggregates, std::size_t _bp, std::size_t _ep) {
+  return _aggregates.Aggregate(_slp, _slp.Start(), _bp, _ep);
+}
+
+
+/**
+ * Get the aggregate of the range [_bp, _ep) of the sequence represented by a forest of roots (e.g., the compact
+ * sequence of a RePair encoding). The roots fully covered by the range are aggregated without descending.
+ *
+ * The roots are scanned from the first one to locate the range, so it takes O(#roots + height); for many queries, see
+ * the overload with the offsets of the roots.
+ */
+template<typename _SLP, typename _Aggregates, typename _Roots>
+auto RangeAggregate(const _SLP &_slp,
+                    const _Aggregates &_aggregates,
+                    const _Roots &_roots,
+                    std::size_t _bp,
+                    std::size_t _ep) -> typename _Aggregates::value_type {
+  typedef typename _Aggregates::monoid_type Monoid;
+  auto result = Monoid::Identity();
+
+  std::size_t pos = 0;
+  for (std::size_t i = 0; i < _roots.size() && pos < _ep; ++i) {
+    auto length = _slp.SpanLength(_roots[i]);
+    if (_bp < pos + length) {
+      auto bp = std::max(_bp, pos) - pos;
+      auto ep = std::min(_ep, pos + length) - pos;
+      result = Monoid::Combine(result, _aggregates.Aggregate(_slp, _roots[i], bp, ep));
+    }
+    pos += length;
+  }
+
+  return result;
+}
+
+
+/**
+ * Compute the offsets of the roots of a forest: starting position of each root in the sequence, plus its length at
+ * the end
+ */
+template<typename _SLP, typename _Roots>
+std::vector<std::size_t> ComputeRootsOffsets(const _SLP &_slp, const _Roots &_roots) {
+  std::vector<std::size_t> offsets(_roots.size() + 1, 0);
+  for (std::size_t i = 0; i < _roots.size(); ++i) {
+    offsets[i + 1] = offsets[i] + _slp.SpanLength(_roots[i]);
+  }
+
+  return offsets;
+}
+
+
+/**
+ * Get the aggregate of the range [_bp, _ep) of the sequence represented by a forest of roots, given their offsets
+ * (see ComputeRootsOffsets). The first root of the range is located with a binary search over the offsets, so it takes
+ * O(log #roots + height + k), where k is the number of roots fully covered by the range.
+ */
+template<typename _SLP, typename _Aggregates, typename _Roots, typename _Offsets>
+auto RangeAggregate(const _SLP &_slp,
+                    const _Aggregates &_aggregates,
+                    const _Roots &_roots,
+                    const _Offsets &_roots_offsets,
+                    std::size_t _bp,
+                    std::size_t _ep) -> typename _Aggregates::value_type {
+  typedef typename _Aggregates::monoid_type Monoid;
+  auto result = Monoid::Identity();
+
+  if (_ep <= _bp) {
+    return result;
+  }
+
+  std::size_t i = std::upper_bound(_roots_offsets.begin(), _roots_offsets.end(), _bp) - _roots_offsets.begin() - 1;
+  for (; i < _roots.size() && _roots_offsets[i] < _ep; ++i) {
+    auto pos = _roots_offsets[i];
+    auto bp = std::max(_bp, pos) - pos;
+    auto ep = std::min<std::size_t>(_ep, _roots_offsets[i + 1]) - pos;
+    result = Monoid::Combine(result, _aggregates.Aggregate(_slp, _roots[i], bp, ep));
+  }
+
+  return result;
+}
+
+}
+
+#endif //GRAMMAR_SLP_AGGREGATES_H
@@ -11,8 +11,15 @@
 #include <unordered_map>
 #include <algorithm>
 #include <functional>
+#include <iterator>
+#include <type_traits>
+#include <tuple>
+#include <initializer_list>
+#include <numeric>
 
 #include "utility.h"
+#include "algorithm.h"
+#include "parallel.h"
 
 
 namespace grammar {
@@ -189,6 +196,170 @@ void ComputeSampledSLPLeaves(const _SLP &_slp,
 }
 
 
+/**
+ * Leaf actions may split their work in two phases: Prepare(slp, var), which must be thread-safe and returns the
+ * prepared data, and Commit(slp, var, prepared), which is called in order. Actions without these members are called
+ * as action(slp, var) in the commit phase.
+ */
+template<typename _Action, typename _SLP>
+auto PrepareLeafAction(const _Action &_action, const _SLP &_slp, std::size_t _var, int)
+-> decltype(_action.Prepare(_slp, _var)) {
+  return _action.Prepare(_slp, _var);
+}
+
+
+template<typename _Action, typename _SLP>
+NoAction PrepareLeafAction(const _Action &, const _SLP &, std::size_t, long) {
+  return NoAction();
+}
+
+
+template<typename _Action, typename _SLP, typename _Prepared>
+auto CommitLeafAction(_Action &_action, const _SLP &_slp, std::size_t _var, _Prepared &&_prepared, int)
+-> decltype(_action.Commit(_slp, _var, std::forward<_Prepared>(_prepared)), void()) {
+  _action.Commit(_slp, _var, std::forward<_Prepared>(_prepared));
+}
+
+
+template<typename _Action, typename _SLP, typename _Prepared>
+void CommitLeafAction(_Action &_action, const _SLP &_slp, std::size_t _var, _Prepared &&, long) {
+  _action(_slp, _var);
+}
+
+
+/**
+ * Leaf action that reports each committed leaf, keeping the two-phase protocol of the wrapped action
+ *
+ * @tparam _Action
+ * @tparam _Report
+ */
+template<typename _Action, typename _Report>
+class ReportLeafAction {
+ public:
+  ReportLeafAction(_Action &_action, _Report &_report) : action_(_action), report_(_report) {}
+
+  template<typename _SLP>
+  void operator()(const _SLP &_slp, std::size_t _var) {
+    Commit(_slp, _var, Prepare(_slp, _var));
+  }
+
+  template<typename _SLP>
+  auto Prepare(const _SLP &_slp, std::size_t _var) const {
+    return PrepareLeafAction(action_, _slp, _var, 0);
+  }
+
+  template<typename _SLP, typename _Prepared>
+  void Commit(const _SLP &_slp, std::size_t _var, _Prepared &&_prepared) {
+    CommitLeafAction(action_, _slp, _var, std::forward<_Prepared>(_prepared), 0);
+    report_(_var);
+  }
+
+ private:
+  _Action &action_;
+  _Report &report_;
+};
+
+
+template<typename _Action, typename _Report>
+auto BuildReportLeafAction(_Action &_action, _Report &_report) {
+  return ReportLeafAction<_Action, _Report>(_action, _report);
+}
+
+
+/**
+ * Parallel version of ComputeSampledSLPLeaves
+ *
+ * The top levels of the parse tree are expanded until there are enough subtrees to keep the threads busy. Each
+ * subtree is traversed independently into its own buffer of leaves (and prepared leaf-action data), and the buffers are
+ * reported in order, so the output and the sequence of committed actions are the same as in the serial version.
+ *
+ * @param _slp
+ * @param _block_size
+ * @param _out Output iterator of leaves
+ * @param _action Leaf action (see PrepareLeafAction and CommitLeafAction)
+ * @param _n_threads Number of threads
+ */
+template<typename _SLP, typename _OI, typename _Action = NoAction>
+void ComputeSampledSLPLeavesParallel(const _SLP &_slp,
+                                     uint64_t _block_size,
+                                     _OI _out,
+                                     _Action &&_action,
+                                     std::size_t _n_threads) {
+  if (_n_threads <= 1) {
+    auto action = [&_action](const auto &_leaf_slp, std::size_t _var) {
+      CommitLeafAction(_action, _leaf_slp, _var, PrepareLeafAction(_action, _leaf_slp, _var, 0), 0);
+    };
+    ComputeSampledSLPLeaves(_slp, _block_size, _out, _slp.Start(), action);
+    return;
+  }
+
+  const std::size_t kTasksPerThread = 8;
+
+  // Expand the top of the parse tree (in order) until there are enough subtrees
+  std::vector<std::size_t> frontier = {_slp.Start()};
+  std::vector<std::size_t> next_frontier;
+  bool expanded = true;
+  while (frontier.size() < kTasksPerThread * _n_threads && expanded) {
+    expanded = false;
+    next_frontier.clear();
+    for (const auto &var : frontier) {
+      if (_slp.SpanLength(var) <= _block_size) {
+        next_frontier.push_back(var);
+      } else {
+        const auto &children = _slp[var];
+        next_frontier.push_back(children.first);
+        next_frontier.push_back(children.second);
+        expanded = true;
+      }
+    }
+    frontier.swap(next_frontier);
+  }
+
+  using Prepared = std::decay_t<decltype(PrepareLeafAction(_action, _slp, 0, 0))>;
+  struct Task {
+    std::vector<std::size_t> leaves;
+    std::vector<Prepared> prepared;
+  };
+
+  // Tasks are processed in windows to bound the memory used by the prepared data
+  const std::size_t window_size = kTasksPerThread * _n_threads;
+  std::vector<Task> tasks(std::min(window_size, frontier.size()));
+  for (std::size_t first = 0; first < frontier.size(); first += window_size) {
+    auto n_tasks = std::min(window_size, frontier.size() - first);
+
+    ParallelFor(n_tasks, _n_threads, [&](std::size_t _k) {
+      auto &task = tasks[_k];
+      task.leaves.clear();
+      task.prepared.clear();
+
+      ComputeSampledSLPLeaves(_slp, _block_size, back_inserter(task.leaves), frontier[first + _k], NoAction());
+
+      task.prepared.reserve(task.leaves.size());
+      for (const auto &leaf : task.leaves) {
+        task.prepared.emplace_back(PrepareLeafAction(_action, _slp, leaf, 0));
+      }
+    });
+
+    for (std::size_t k = 0; k < n_tasks; ++k) {
+      auto &task = tasks[k];
+      for (std::size_t i = 0; i < task.leaves.size(); ++i) {
+        _out = task.leaves[i];
+        ++_out;
+
+        CommitLeafAction(_action, _slp, task.leaves[i], std::move(task.prepared[i]), 0);
+      }
+    }
+  }
+}
+
+
+/**
+ * Ranges of children (sampled nodes or leaves) of a node in the sampled tree, passed to the predicates and actions of
+ * ComputeSampledSLPNodes.
+ */
+typedef IteratorRange<std::vector<std::size_t>::const_iterator> ChildrenRange;
+
+
 template<typename _SLP, typename _SLPValueType = uint32_t, typename _Predicate, typename _Action = NoAction>
 void ComputeSampledSLPNodes(const _SLP &_slp,
                             uint32_t _block_size,
@@ -200,6 +371,16 @@ void ComputeSampledSLPNodes(const _SLP &_slp,
 }
 
 
+/**
+ * Compute the inner nodes of the sampled tree of the subtree rooted at _curr_var (in post-order).
+ *
+ * The traversal is iterative and keeps the children of the pending nodes in one shared stack: the children of a node
+ * are the contiguous ranges added by its left and right subtrees, which are passed to _pred and _action as
+ * ChildrenRange views. A node that is not sampled simply leaves the ranges of its children in the stack for its
+ * parent.
+ *
+ * @return children (ranges) of _curr_var
+ */
 template<typename _SLP, typename _SLPValueType = uint32_t, typename _Predicate, typename _Action = NoAction>
 std::vector<std::size_t> ComputeSampledSLPNodes(const _SLP &_slp,
                                                 std::size_t _curr_var,
@@ -208,25 +389,62 @@ std::vector<std::size_t> ComputeSampledSLPNodes(const _SLP &_slp,
                                                 std::size_t &_curr_leaf,
                                                 const _Predicate &_pred,
                                                 _Action &&_action = NoAction()) {
-  auto length = _slp.SpanLength(_curr_var);
-  if (length <= _block_size) {
-    return {_curr_leaf++};
+  struct Frame {
+    std::size_t var;
+    uint8_t state; // 0: not visited, 1: left child visited, 2: both children visited
+    std::size_t begin; // Begin of the ranges of the left child
+    std::size_t mid; // Begin of the ranges of the right child
+  };
+
+  std::vector<std::size_t> ranges;
+  std::vector<Frame> frames;
+  frames.push_back(Frame{_curr_var, 0, 0, 0});
+
+  while (!frames.empty()) {
+    auto &frame = frames.back();
+
+    switch (frame.state) {
+      case 0: {
+        if (_slp.SpanLength(frame.var) <= _block_size) {
+          ranges.push_back(_curr_leaf++);
+          frames.pop_back();
+          break;
+        }
+
+        frame.begin = ranges.size();
+        frame.state = 1;
+        auto left = _slp[frame.var].first;
+        frames.push_back(Frame{left, 0, 0, 0});
+        break;
+      }
+      case 1: {
+        frame.mid = ranges.size();
+        frame.state = 2;
+        auto right = _slp[frame.var].second;
+        frames.push_back(Frame{right, 0, 0, 0});
+        break;
+      }
+      default: {
+        auto var = frame.var;
+        auto begin = frame.begin;
+        ChildrenRange left_children(ranges.cbegin() + begin, ranges.cbegin() + frame.mid);
+        ChildrenRange right_children(ranges.cbegin() + frame.mid, ranges.cend());
+        frames.pop_back();
+
+        if (_pred(_slp, var, left_children, right_children) || var == _slp.Start()) {
+          _nodes.emplace_back(var);
+          auto new_node = _nodes.size() - 1;
+          _action(_slp, var, _nodes, new_node, left_children, right_children);
+
+          ranges.resize(begin);
+          ranges.push_back(new_node);
+        }
+        break;
+      }
+    }
   }
 
-  const auto &children = _slp[_curr_var];
-
-  auto left_children = ComputeSampledSLPNodes(_slp, children.first, _block_size, _nodes, _curr_leaf, _pred, _action);
-  auto right_children = ComputeSampledSLPNodes(_slp, children.second, _block_size, _nodes, _curr_leaf, _pred, _action);
-
-  if (_pred(_slp, _curr_var, left_children, right_children) || _curr_var == _slp.Start()) {
-    _nodes.emplace_back(_curr_var);
-    auto new_node = _nodes.size() - 1;
-    _action(_slp, _curr_var, _nodes, new_node, left_children, right_children);
-    return {new_node};
-  } else {
-    left_children.insert(left_children.end(), right_children.begin(), right_children.end());
-    return left_children;
-  }
+  return ranges;
 }
 
 
@@ -299,12 +517,82 @@ class IsEqual {
 };
 
 
+/**
+ * Variable Memo
+ *
+ * Memo of the decisions of a predicate indexed by variable (-1: unknown). The variables from a base variable on are
+ * stored in a flat array, grown on demand up to the last variable of the SLP, and the variables below the base in a
+ * hash map. With base 0 (default) the memo is flat; with the first variable of a new part of an SLP (e.g., a block
+ * appended to an IncrementalSLP) its cost is proportional to that part instead of to the whole SLP.
+ */
+class VariableMemo {
+ public:
+  explicit VariableMemo(std::size_t _base = 0) : base_(_base) {}
+
+  int8_t Get(std::size_t _var) const {
+    if (_var < base_) {
+      auto it = sparse_.find(_var);
+      return (it != sparse_.end()) ? it->second : -1;
+    }
+
+    return (_var - base_ < flat_.size()) ? flat_[_var - base_] : -1;
+  }
+
+  /**
+   * Set the decision for variable _var of an SLP with _n_vars variables
+   */
+  void Set(std::size_t _var, int8_t _value, std::size_t _n_vars) {
+    if (_var < base_) {
+      sparse_[_var] = _value;
+      return;
+    }
+
+    if (flat_.size() <= _var - base_) {
+      flat_.resize(std::max(_n_vars, _var) + 1 - base_, -1);
+    }
+    flat_[_var - base_] = _value;
+  }
+
+  /**
+   * Clear the memo and set its base variable
+   */
+  void Reset(std::size_t _base = 0) {
+    base_ = _base;
+    std::vector<int8_t>().swap(flat_);
+    sparse_.clear();
+  }
+
+ private:
+  std::size_t base_;
+  std::vector<int8_t> flat_; // Variables from base_ on
+  std::unordered_map<std::size_t, int8_t> sparse_; // Variables below base_
+};
+
+
+/**
+ * Reset the memo of a predicate (see VariableMemo), if it has one
+ */
+template<typename _Predicate>
+auto ResetPredicateMemo(_Predicate &_pred, std::size_t _base, int) -> decltype(_pred.ResetMemo(_base), void()) {
+  _pred.ResetMemo(_base);
+}
+
+template<typename _Predicate>
+void ResetPredicateMemo(_Predicate &_pred, std::size_t _base, long) {
+}
+
+template<typename _Predicate>
+void ResetPredicateMemo(_Predicate &_pred, std::size_t _base) {
+  ResetPredicateMemo(_pred, _base, 0);
+}
+
+
 /**
  * Predicate Must Be Sampled
  *
  * @tparam _PTS Precomputed Terminal Set
  */
-template<typename _PTS, typename _Set = std::vector<uint32_t>, typename _Children = std::vector<std::size_t>>
+template<typename _PTS, typename _Set = std::vector<uint32_t>, typename _Children = ChildrenRange>
 class MustBeSampled {
  public:
   template<typename _Pred, typename ..._Args>
@@ -326,9 +614,9 @@ class MustBeSampled {
                   const _RangeContainer &left_ranges,
                   const _RangeContainer &right_ranges) const {
 
-    auto it = cache.find(_curr_var);
-    if (it != cache.end()) {
-      return it->second;
+    auto cached = cache.Get(_curr_var);
+    if (cached != -1) {
+      return cached;
     }
 
     auto set = _slp.Span(_curr_var);
@@ -343,33 +631,168 @@ class MustBeSampled {
       }
     }
 
-    cache[_curr_var] = must_be_sampled;
+    cache.Set(_curr_var, must_be_sampled, _slp.Variables());
     return must_be_sampled;
   }
 
+  void ResetMemo(std::size_t _base = 0) {
+    cache.Reset(_base);
+  }
+
  private:
   std::vector<std::function<bool(const _Set &, const _Children &, const _Children &)>> preds_;
 
-  mutable std::unordered_map<std::size_t, bool> cache;
+  mutable VariableMemo cache; // Memo indexed by variable
 };
 
 
+/**
+ * Set Source from Span
+ *
+ * Computes the set of distinct terminals of a variable by expanding its span (O(span length)).
+ */
+template<typename _Set = std::vector<uint32_t>>
+class SpanSetSource {
+ public:
+  typedef _Set Set;
+
+  template<typename _SLP, typename _Children>
+  void operator()(const _SLP &_slp, std::size_t _var, const _Children &, const _Children &, Set &_set) const {
+    _set.clear();
+    _slp.Span(_var, back_inserter(_set));
+    sort(_set.begin(), _set.end());
+    _set.erase(unique(_set.begin(), _set.end()), _set.end());
+  }
+};
+
+
+/**
+ * Set Source from Children
+ *
+ * Computes the set of distinct terminals of a variable bottom-up, merging the sets already stored for its children
+ * (leaves and sampled nodes) in the PTS. The children of a variable cover its span, so the result is exact, and the
+ * cost depends on the size of the children's sets instead of on the span length.
+ *
+ * @tparam _PTS Precomputed terminal sets of the nodes of the sampled tree (node i is stored at i + 1)
+ */
+template<typename _PTS, typename _Set = std::vector<uint32_t>>
+class ChildrenSetSource {
+ public:
+  typedef _Set Set;
+
+  ChildrenSetSource(const _PTS &_pts) : pts_(_pts) {}
+
+  template<typename _SLP, typename _Children>
+  void operator()(const _SLP &_slp,
+                  std::size_t _var,
+                  const _Children &_lchildren,
+                  const _Children &_rchildren,
+                  Set &_set) const {
+    ranges_.clear();
+    auto add_ranges = [this](const auto &_children) {
+      for (const auto &item : _children) {
+        auto set = pts_[item + 1];
+        ranges_.emplace_back(set.begin(), set.end());
+      }
+    };
+    add_ranges(_lchildren);
+    add_ranges(_rchildren);
+
+    _set.clear();
+    MergeRangesKWay(ranges_.begin(), ranges_.end(), back_inserter(_set));
+  }
+
+ private:
+  const _PTS &pts_;
+
+  typedef decltype(std::declval<const _PTS &>()[1].begin()) Iterator;
+  mutable std::vector<std::pair<Iterator, Iterator>> ranges_;
+};
+
+
+/**
+ * Sampling Predicate
+ *
+ * Decides if a node of the sampled tree must be sampled: it computes the set of distinct terminals of the node with
+ * _SetSource and evaluates the predicates _Preds (any of them). Predicates are bound at compile time and decisions are
+ * memoized by variable (see VariableMemo). The set buffer is reused between calls.
+ *
+ * @tparam _SetSource
+ * @tparam _Preds
+ */
+template<typename _SetSource, typename ..._Preds>
+class SamplingPredicate {
+ public:
+  SamplingPredicate(const _SetSource &_set_source, const _Preds &... _preds)
+      : set_source_(_set_source), preds_(_preds...) {}
+
+  template<typename _SLP, typename _Children>
+  bool operator()(const _SLP &_slp,
+                  std::size_t _curr_var,
+                  const _Children &_lchildren,
+                  const _Children &_rchildren) const {
+    auto memoized = memo_.Get(_curr_var);
+    if (memoized != -1) {
+      return memoized;
+    }
+
+    set_source_(_slp, _curr_var, _lchildren, _rchildren, set_);
+
+    bool must_be_sampled = AnyOf(_lchildren, _rchildren, std::index_sequence_for<_Preds...>());
+
+    memo_.Set(_curr_var, must_be_sampled, _slp.Variables());
+    return must_be_sampled;
+  }
+
+  void ResetMemo(std::size_t _base = 0) {
+    memo_.Reset(_base);
+  }
+
+ private:
+  _SetSource set_source_;
+  std::tuple<_Preds...> preds_;
+
+  mutable VariableMemo memo_; // Memo indexed by variable (flat by default, see VariableMemo)
+  mutable typename _SetSource::Set set_;
+
+  template<typename _Children, std::size_t ..._I>
+  bool AnyOf(const _Children &_lchildren, const _Children &_rchildren, std::index_sequence<_I...>) const {
+    bool result = false;
+    (void) std::initializer_list<int>{(result = result || std::get<_I>(preds_)(set_, _lchildren, _rchildren), 0)...};
+    return result;
+  }
+};
+
+
+template<typename _SetSource, typename ..._Preds>
+auto BuildSamplingPredicate(const _SetSource &_set_source, const _Preds &... _preds) {
+  return SamplingPredicate<_SetSource, _Preds...>(_set_source, _preds...);
+}
+
+
+/**
+ * Compute the covers of the partition elements in [_first_idx, _last_idx), starting at the given position of the
+ * compact sequence: element _cseq[_pos] with _inner_pos elements of its expansion already covered.
+ */
 template<typename _SLP, typename _CSeq, typename _Partition, typename _GetLength, typename _Action>
 void ComputePartitionCover(const _SLP &_slp,
                            const _CSeq &_cseq,
                            const _Partition &_partition,
                            const _GetLength &_get_length,
-                           _Action _action,
-                           std::size_t initial_idx) {
+                           _Action &&_action,
+                           std::size_t _first_idx,
+                           std::size_t _last_idx,
+                           std::size_t _pos,
+                           std::size_t _inner_pos) {
   std::vector<typename _SLP::VariableType> seq;
 
-  std::size_t pos = 0;
-  std::size_t inner_pos = 0;
-  for (auto i = initial_idx; i < _partition.size() + initial_idx; ++i, _action(seq)) {
+  std::size_t pos = _pos;
+  std::size_t inner_pos = _inner_pos;
+  for (auto i = _first_idx; i < _last_idx; ++i, _action(seq)) {
 
     seq.clear();
 
-    auto length = _get_length(_partition[i]);
+    std::size_t length = _get_length(_partition[i]);
 
     if (inner_pos != 0) {
       // Find inner variables
@@ -406,6 +829,102 @@ void ComputePartitionCover(const _SLP &_slp,
 }
 
 
+template<typename _SLP, typename _CSeq, typename _Partition, typename _GetLength, typename _Action>
+void ComputePartitionCover(const _SLP &_slp,
+                           const _CSeq &_cseq,
+                           const _Partition &_partition,
+                           const _GetLength &_get_length,
+                           _Action _action,
+                           std::size_t initial_idx) {
+  ComputePartitionCover(_slp, _cseq, _partition, _get_length, _action,
+                        initial_idx, _partition.size() + initial_idx, 0, 0);
+}
+
+
+/**
+ * Compute the covers of the partition in parallel.
+ *
+ * The partition is split into ranges of consecutive elements. The starting position of each range in the expansion of
+ * the compact sequence comes from the prefix sums of the partition lengths, and it is located in _cseq with a binary
+ * search over the prefix sums of the span lengths of _cseq. Each range computes its covers independently into its own
+ * buffer, and the covers are reported through _action in the partition order (as in the serial version).
+ *
+ * @param _n_threads Number of threads
+ */
+template<typename _SLP, typename _CSeq, typename _Partition, typename _GetLength, typename _Action>
+void ComputePartitionCover(const _SLP &_slp,
+                           const _CSeq &_cseq,
+                           const _Partition &_partition,
+                           const _GetLength &_get_length,
+                           _Action _action,
+                           std::size_t initial_idx,
+                           std::size_t _n_threads) {
+  const std::size_t n = _partition.size();
+  const std::size_t n_ranges = std::min<std::size_t>(n, std::max<std::size_t>(_n_threads, 1) * 4);
+
+  if (_n_threads <= 1 || n_ranges <= 1) {
+    ComputePartitionCover(_slp, _cseq, _partition, _get_length, _action, initial_idx);
+    return;
+  }
+
+  auto range_begin = [n, n_ranges, initial_idx](std::size_t _r) {
+    return initial_idx + n * _r / n_ranges;
+  };
+
+  // Starting position (in the expansion) of each range
+  std::vector<std::size_t> range_offsets(n_ranges + 1, 0);
+  ParallelFor(n_ranges, _n_threads, [&](std::size_t _r) {
+    std::size_t length = 0;
+    for (auto i = range_begin(_r); i < range_begin(_r + 1); ++i) {
+      length += _get_length(_partition[i]);
+    }
+    range_offsets[_r + 1] = length;
+  });
+  std::partial_sum(range_offsets.begin(), range_offsets.end(), range_offsets.begin());
+
+  // Starting position (in the expansion) of each element of the compact sequence
+  std::vector<std::size_t> cseq_offsets(_cseq.size() + 1, 0);
+  for (std::size_t i = 0; i < _cseq.size(); ++i) {
+    cseq_offsets[i + 1] = cseq_offsets[i] + _slp.SpanLength(_cseq[i]);
+  }
+
+  struct RangeCovers {
+    std::vector<typename _SLP::VariableType> values;
+    std::vector<std::size_t> ends;
+  };
+  std::vector<RangeCovers> covers(n_ranges);
+
+  ParallelFor(n_ranges, _n_threads, [&](std::size_t _r) {
+    auto offset = range_offsets[_r];
+    auto pos = std::upper_bound(cseq_offsets.begin(), cseq_offsets.end(), offset) - cseq_offsets.begin() - 1;
+    auto inner_pos = offset - cseq_offsets[pos];
+
+    auto &range_covers = covers[_r];
+    range_covers.ends.reserve(range_begin(_r + 1) - range_begin(_r));
+    auto store = [&range_covers](const auto &_set) {
+      range_covers.values.insert(range_covers.values.end(), _set.begin(), _set.end());
+      range_covers.ends.emplace_back(range_covers.values.size());
+    };
+
+    ComputePartitionCover(_slp, _cseq, _partition, _get_length, store,
+                          range_begin(_r), range_begin(_r + 1), pos, inner_pos);
+  });
+
+  // Report the covers in order
+  for (auto &range_covers : covers) {
+    auto first = range_covers.values.begin();
+    for (auto end : range_covers.ends) {
+      auto last = range_covers.values.begin() + end;
+      auto set = MakeIteratorRange(first, last);
+      _action(set);
+      first = last;
+    }
+
+    decltype(range_covers.values)().swap(range_covers.values);
+  }
+}
+
+
 template<typename _Tree, typename _Report>
 auto ComputeCoverFromBottom(const _Tree &_tree, std::size_t _bp, std::size_t _ep, _Report _report)
 -> std::pair<decltype(_tree.Position(1)), decltype(_tree.Position(1))> {
@@ -430,6 +949,84 @@ auto ComputeCoverFromBottom(const _Tree &_tree, std::size_t _bp, std::size_t _ep
 }
 
 
+/**
+ * Cover Arena
+ *
+ * Caller-owned storage for the covers of a batch of intervals: the nodes of all the covers are stored contiguously,
+ * delimited by offsets, along with the range (positions) spanned by each cover. Clear keeps the allocated memory, so
+ * an arena reused across batches does not allocate in steady state.
+ */
+class CoverArena {
+ public:
+  typedef std::pair<std::size_t, std::size_t> Range;
+
+  CoverArena() : offsets_(1, 0) {}
+
+  /**
+   * Get the number of covers
+   */
+  std::size_t size() const {
+    return ranges_.size();
+  }
+
+  /**
+   * Get the nodes of cover i
+   */
+  auto Cover(std::size_t i) const {
+    return MakeIteratorRange(nodes_.begin() + offsets_[i], nodes_.begin() + offsets_[i + 1]);
+  }
+
+  /**
+   * Get the range spanned by cover i
+   */
+  const Range &GetRange(std::size_t i) const {
+    return ranges_[i];
+  }
+
+  void Clear() {
+    nodes_.clear();
+    offsets_.resize(1);
+    ranges_.clear();
+  }
+
+  /**
+   * Compute and add the cover of interval [_bp, _ep)
+   */
+  template<typename _Tree>
+  void Add(const _Tree &_tree, std::size_t _bp, std::size_t _ep) {
+    auto report = [this](const auto &_value) { nodes_.emplace_back(_value); };
+
+    ranges_.emplace_back(ComputeCoverFromBottom(_tree, _bp, _ep, report));
+    offsets_.emplace_back(nodes_.size());
+  }
+
+  /**
+   * Add the covers of the given arena
+   */
+  void Append(const CoverArena &_arena) {
+    auto shift = nodes_.size();
+    nodes_.insert(nodes_.end(), _arena.nodes_.begin(), _arena.nodes_.end());
+    for (auto it = _arena.offsets_.begin() + 1; it != _arena.offsets_.end(); ++it) {
+      offsets_.emplace_back(*it + shift);
+    }
+    ranges_.insert(ranges_.end(), _arena.ranges_.begin(), _arena.ranges_.end());
+  }
+
+  const auto &GetNodes() const {
+    return nodes_;
+  }
+
+  const auto &GetOffsets() const {
+    return offsets_;
+  }
+
+ private:
+  std::vector<std::size_t> nodes_;
+  std::vector<std::size_t> offsets_;
+  std::vector<Range> ranges_;
+};
+
+
 template<typename _Tree>
 class ComputeCoverBottomFunctor {
  public:
@@ -445,12 +1042,50 @@ class ComputeCoverBottomFunctor {
     return std::make_pair(std::move(range), std::move(nodes));
   }
 
+  /**
+   * Compute the covers of a batch of intervals [bp, ep), given as pairs, and append them (in order) to the arena
+   */
+  template<typename _II>
+  void Compute(_II _first, _II _last, CoverArena &_arena) const {
+    for (; _first != _last; ++_first) {
+      _arena.Add(tree_, _first->first, _first->second);
+    }
+  }
+
+  /**
+   * Compute the covers of a batch of intervals in parallel. The batch is split into blocks of consecutive intervals
+   * whose covers are computed in the threads of the pool and appended to the arena in order.
+   */
+  template<typename _RAI>
+  void Compute(_RAI _first, _RAI _last, CoverArena &_arena, ThreadPool &_pool) const {
+    const std::size_t n = _last - _first;
+    const std::size_t n_blocks = std::min<std::size_t>(n / kMinBlockSize, _pool.Size() * 4);
+    if (n_blocks <= 1) {
+      Compute(_first, _last, _arena);
+      return;
+    }
+
+    std::vector<CoverArena> blocks(n_blocks - 1);
+    auto block_begin = [n, n_blocks](std::size_t _b) { return n * _b / n_blocks; };
+
+    // The first block goes directly to the arena
+    _pool.ParallelFor(n_blocks, [&](std::size_t _b) {
+      Compute(_first + block_begin(_b), _first + block_begin(_b + 1), (_b == 0) ? _arena : blocks[_b - 1]);
+    });
+
+    for (const auto &block : blocks) {
+      _arena.Append(block);
+    }
+  }
+
   auto operator()(std::size_t _sp, std::size_t _ep) const {
     return Compute(_sp, _ep);
   }
 
  protected:
   const _Tree &tree_;
+
+  static const std::size_t kMinBlockSize = 64; // Minimum number of intervals per block
 };
 
 
@@ -12,7 +12,12 @@
 #include <type_traits>
 #include <cassert>
 
+#include <sdsl/int_vector.hpp>
+
 #include "slp_helper.h"
+#include "algorithm.h"
+#include "cardinality_sketch.h"
+#include "incremental_slp.h"
 #include "utility.h"
 #include "io.h"
 
@@ -61,8 +66,24 @@ class PTS {
       sets_.emplace_back(set);
     }
 
+    Extend(slp);
+  }
+
+  /**
+   * Compute the set of terminals of the variables added to the SLP since the last computation (e.g., after an append
+   * to an IncrementalSLP)
+   *
+   * @tparam _SLP Straight-Line Program (Grammar)
+   * @param slp
+   */
+  template<typename _SLP>
+  void Extend(const _SLP *slp) {
+    assert(slp->Sigma() < sets_.size());
+    sets_.reserve(slp->Variables() + 1);
+
+    std::vector<typename _Container::value_type> set(0);
     set.reserve(slp->Sigma());
-    for (; i <= slp->Variables(); ++i) {
+    for (std::size_t i = sets_.size(); i <= slp->Variables(); ++i) {
       const auto &right_hand = (*slp)[i];
       const auto &left = sets_[right_hand.first];
       const auto &right = sets_[right_hand.second];
@@ -117,6 +138,58 @@ class PTS {
 };
 
 
+/**
+ * Decode (copy) the elements in range [_first, _last) of a container into the given buffer.
+ *
+ * @return pointer past the last decoded element
+ */
+template<typename _Container, typename _Value>
+_Value *DecodeRange(const _Container &_container, std::size_t _first, std::size_t _last, _Value *_out) {
+  return std::copy(_container.begin() + _first, _container.begin() + _last, _out);
+}
+
+
+/**
+ * Decode the elements in range [_first, _last) of a bit-compressed vector into the given buffer. The packed words are
+ * unpacked one at a time, avoiding the bit-width proxy of each element access.
+ *
+ * @return pointer past the last decoded element
+ */
+template<uint8_t t_width, typename _Value>
+_Value *DecodeRange(const sdsl::int_vector<t_width> &_container, std::size_t _first, std::size_t _last, _Value *_out) {
+  if (_first == _last)
+    return _out;
+
+  const uint8_t width = _container.width();
+  if (width == 64) {
+    return std::copy(_container.data() + _first, _container.data() + _last, _out);
+  }
+
+  const uint64_t mask = (1ULL << width) - 1;
+  auto bit = _first * width;
+  auto word = _container.data() + (bit >> 6);
+  uint8_t offset = bit & 63;
+  uint64_t curr = *word;
+
+  for (auto i = _first; i < _last; ++i, ++_out) {
+    uint64_t value = curr >> offset;
+    offset += width;
+    if (64 < offset) {
+      curr = *(++word);
+      offset -= 64;
+      value |= curr << (width - offset);
+    } else if (offset == 64) {
+      offset = 0;
+      if (i + 1 < _last) curr = *(++word);
+    }
+
+    *_out = value & mask;
+  }
+
+  return _out;
+}
+
+
 template<typename _ObjContainer = std::vector<uint32_t>, typename _PosContainer = std::vector<uint32_t>>
 class Chunks {
  public:
@@ -163,6 +236,33 @@ class Chunks {
     return std::make_pair(objs_.begin() + pos_[i - 1], (i < pos_.size()) ? objs_.begin() + pos_[i] : objs_.end());
   }
 
+  /**
+   * Get the number of elements of chunk i
+   *
+   * @param i chunk
+   * @return length
+   */
+  std::size_t ChunkLength(std::size_t i) const {
+    assert(0 < i && i <= pos_.size());
+
+    return ((i < pos_.size()) ? pos_[i] : objs_.size()) - pos_[i - 1];
+  }
+
+  /**
+   * Decode chunk i into the given buffer in one bulk copy (word-at-a-time unpack for bit-compressed containers). The
+   * buffer must have room for ChunkLength(i) elements.
+   *
+   * @param i chunk
+   * @param _out buffer
+   * @return pointer past the last decoded element
+   */
+  template<typename _Value>
+  _Value *Decode(std::size_t i, _Value *_out) const {
+    assert(0 < i && i <= pos_.size());
+
+    return DecodeRange(objs_, pos_[i - 1], (i < pos_.size()) ? pos_[i] : objs_.size(), _out);
+  }
+
   const _ObjContainer &GetObjects() const {
     return objs_;
   }
@@ -251,12 +351,27 @@ class SampledPTS {
   SampledPTS() = default;
 
   template<typename _SLPValueType = uint32_t>
-  SampledPTS(const _SLP *_slp, uint32_t _block_size = __block_size, float _storing_factor = 16) {
-    Compute<_SLPValueType>(_slp, _block_size, _storing_factor);
+  SampledPTS(const _SLP *_slp,
+             uint32_t _block_size = __block_size,
+             float _storing_factor = 16,
+             bool _estimate_sizes = false) {
+    Compute<_SLPValueType>(_slp, _block_size, _storing_factor, _estimate_sizes);
   }
 
+  /**
+   * Compute the sampled sets
+   *
+   * @param _slp
+   * @param _block_size
+   * @param _storing_factor
+   * @param _estimate_sizes Decide the sampling with the estimated (KMV sketches) set sizes of the variables instead of
+   * merging the sets of their children
+   */
   template<typename _SLPValueType = uint32_t>
-  void Compute(const _SLP *_slp, uint32_t _block_size = __block_size, float _storing_factor = 16) {
+  void Compute(const _SLP *_slp,
+               uint32_t _block_size = __block_size,
+               float _storing_factor = 16,
+               bool _estimate_sizes = false) {
     slp_ = _slp;
     std::vector<_SLPValueType> nodes;
 
@@ -272,8 +387,6 @@ class SampledPTS {
     };
     ComputeSampledSLPLeaves(*slp_, _block_size, back_inserter(nodes), add_set);
 
-    grammar::MustBeSampled<decltype(pts_)> pred(grammar::AreChildrenTooBig<decltype(pts_)>(pts_, _storing_factor));
-
     auto build_inner_data = [&add_set, this](
         const _SLP &_slp,
         std::size_t _curr_var,
@@ -284,12 +397,133 @@ class SampledPTS {
       add_set(_slp, _curr_var);
     };
 
-    ComputeSampledSLPNodes(*slp_, _block_size, nodes, pred, build_inner_data);
+    if (_estimate_sizes) {
+      CardinalitySketches<> sketches(*slp_);
+      auto pred = BuildSamplingPredicate(SketchSetSource<decltype(sketches)>(sketches),
+                                         AreChildrenTooBig<decltype(pts_)>(pts_, _storing_factor));
+
+      ComputeSampledSLPNodes(*slp_, _block_size, nodes, pred, build_inner_data);
+    } else {
+      auto pred = BuildSamplingPredicate(ChildrenSetSource<decltype(pts_), std::vector<_ValueType>>(pts_),
+                                         AreChildrenTooBig<decltype(pts_)>(pts_, _storing_factor));
+
+      ComputeSampledSLPNodes(*slp_, _block_size, nodes, pred, build_inner_data);
+    }
   }
 
+  /**
+   * Query Context
+   *
+   * Scratch memory of the queries, reused between them to avoid allocations. The visited variables are marked with
+   * the epoch of the query, so the marks are never cleared. A context must not be shared by concurrent queries.
+   */
+  class QueryContext {
+   public:
+    QueryContext() = default;
+
+   private:
+    friend class SampledPTS;
+
+    typedef typename std::vector<_ValueType>::const_iterator Iterator;
+
+    std::vector<uint32_t> stamps_;
+    uint32_t epoch_ = 0;
+
+    std::vector<_ValueType> stack_;
+    std::vector<_ValueType> terminals_;
+    std::vector<std::pair<Iterator, Iterator>> ranges_;
+
+    void Start(std::size_t _n_vars) {
+      if (stamps_.size() < _n_vars + 1) {
+        stamps_.resize(_n_vars + 1, 0);
+      }
+
+      if (++epoch_ == 0) {
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        epoch_ = 1;
+      }
+
+      stack_.clear();
+      terminals_.clear();
+      ranges_.clear();
+    }
+
+    bool Visit(_ValueType _var) {
+      if (stamps_[_var] == epoch_)
+        return false;
+
+      stamps_[_var] = epoch_;
+      return true;
+    }
+  };
+
+  /**
+   * Get the set of variable i. Uses a query context local to the call, so concurrent queries are safe, but each call
+   * allocates its scratch memory (a visit mark per variable); many queries should reuse a context with GetSet.
+   */
   std::vector<_ValueType> operator[](_ValueType i) const {
-    std::vector<bool> _visited(i, false);
-    return GetSet(i, _visited);
+    QueryContext context;
+
+    std::vector<_ValueType> set;
+    GetSet(i, context, back_inserter(set));
+    return set;
+  }
+
+  /**
+   * Get the set of variable i using the given query context
+   *
+   * The sampled sets reachable from i through non-sampled variables are collected with an iterative traversal and
+   * merged at the end in a single k-way merge.
+   *
+   * @param i Variable
+   * @param _context Query context
+   * @param _out Output iterator
+   * @return output iterator past the last reported element
+   */
+  template<typename _OI>
+  _OI GetSet(_ValueType i, QueryContext &_context, _OI _out) const {
+    auto it = vars_.find(i);
+    if (it != vars_.end()) {
+      auto s = pts_[it->second];
+      return std::copy(s.first, s.second, _out);
+    }
+
+    assert(slp_ != nullptr);
+
+    if (i <= slp_->Sigma()) {
+      *_out = i;
+      return ++_out;
+    }
+
+    _context.Start(slp_->Variables());
+
+    auto &stack = _context.stack_;
+    stack.push_back(i);
+    _context.Visit(i);
+    while (!stack.empty()) {
+      auto var = stack.back();
+      stack.pop_back();
+
+      auto it_var = vars_.find(var);
+      if (it_var != vars_.end()) {
+        auto s = pts_[it_var->second];
+        _context.ranges_.emplace_back(s.first, s.second);
+      } else if (var <= slp_->Sigma()) {
+        _context.terminals_.push_back(var);
+      } else {
+        auto children = (*slp_)[var];
+        if (_context.Visit(children.second)) stack.push_back(children.second);
+        if (_context.Visit(children.first)) stack.push_back(children.first);
+      }
+    }
+
+    auto &terminals = _context.terminals_;
+    if (!terminals.empty()) {
+      std::sort(terminals.begin(), terminals.end());
+      _context.ranges_.emplace_back(terminals.cbegin(), terminals.cend());
+    }
+
+    return MergeRangesKWay(_context.ranges_.begin(), _context.ranges_.end(), _out);
   }
 
   bool operator==(const SampledPTS<_SLP, _ValueType, __block_size> &_sampled_pts) const {
@@ -331,32 +565,6 @@ class SampledPTS {
 
   Chunks<std::vector<_ValueType>> pts_;
   std::map<_ValueType, std::size_t> vars_;
-
-  template<typename _BitVector>
-  std::vector<_ValueType> GetSet(_ValueType i, _BitVector &_visited) const {
-    std::vector<_ValueType> set;
-    auto it = vars_.find(i);
-    if (it != vars_.end()) {
-      auto s = pts_[it->second];
-      copy(s.first, s.second, back_inserter(set));
-    } else {
-      assert(slp_ != nullptr);
-
-      if (i <= slp_->Sigma()) {
-        return {i};
-      }
-
-      auto children = (*slp_)[i];
-      auto left = !_visited[children.first] ? GetSet(children.first, _visited) : std::vector<_ValueType>(0);
-      auto right = !_visited[children.second] ? GetSet(children.second, _visited) : std::vector<_ValueType>(0);
-
-      set_union(left.begin(), left.end(), right.begin(), right.end(), back_inserter(set));
-    }
-
-    _visited[i] = 1;
-
-    return set;
-  }
 };
 
 
@@ -390,13 +598,14 @@ class GCChunks {
   }
 
   template<typename _II, typename __Chunks, typename _Encoder>
-  GCChunks(_II _begin, _II _end, const __Chunks &_chunks, _Encoder &_encoder) {
-    Compute(_begin, _end, _chunks, _encoder);
+  GCChunks(_II _begin, _II _end, const __Chunks &_chunks, _Encoder &_encoder, std::size_t _n_threads = 1) {
+    Compute(_begin, _end, _chunks, _encoder, _n_threads);
   }
 
   template<typename _II, typename __Chunks, typename _Encoder>
-  void Compute(_II _begin, _II _end, const __Chunks &_chunks, _Encoder &_encoder) {
+  void Compute(_II _begin, _II _end, const __Chunks &_chunks, _Encoder &_encoder, std::size_t _n_threads = 1) {
     std::vector<typename _SLP::VariableType> cseq;
+    index_.Clear();
 
     auto report_cseq = [&cseq](auto v) {
       cseq.emplace_back(v);
@@ -405,22 +614,30 @@ class GCChunks {
     auto wrapper = BuildSLPWrapper(slp_);
     _encoder.Encode(_begin, _end, wrapper, report_cseq);
 
-    auto get_length = [](const auto &_chunk) -> auto {
-      return _chunk.size();
-    };
+    InsertCovers(cseq, _chunks, _n_threads);
+  }
 
-    if (kExpand) {
-      auto action_expand = [this](auto &_set) { chunks_.Insert(_set.begin(), _set.end()); };
+  /**
+   * Append new chunks. The objects [_begin, _end) of the new chunks are compressed against the existing rules (see
+   * AppendToSLP), and the covers of the new chunks are inserted after the existing ones, so the cost depends only on
+   * the appended data. The objects must be in the alphabet of the SLP.
+   *
+   * @param _begin
+   * @param _end
+   * @param _chunks New chunks (their objects are [_begin, _end))
+   * @param _encoder Encoder of the objects (e.g., RePairEncoder<false>)
+   */
+  template<typename _II, typename __Chunks, typename _Encoder>
+  void Append(_II _begin, _II _end, const __Chunks &_chunks, _Encoder &_encoder, std::size_t _n_threads = 1) {
+    std::vector<typename _SLP::VariableType> cseq;
 
-      ComputePartitionCover(slp_, cseq, _chunks, get_length, action_expand, 1);
-    } else {
-      auto action_no_expand = [this](auto &_set) {
-        std::sort(_set.begin(), _set.end());
-        chunks_.Insert(_set.begin(), _set.end());
-      };
+    auto report_cseq = [&cseq](auto v) {
+      cseq.emplace_back(v);
+    };
 
-      ComputePartitionCover(slp_, cseq, _chunks, get_length, action_no_expand, 1);
-    }
+    AppendToSLP(slp_, index_, _begin, _end, _encoder, report_cseq);
+
+    InsertCovers(cseq, _chunks, _n_threads);
   }
 
   auto size() const {
@@ -491,11 +708,33 @@ class GCChunks {
   void load(std::istream &in) {
     sdsl::load(slp_, in);
     sdsl::load(chunks_, in);
+    index_.Clear();
   }
 
  private:
   _SLP slp_;
   _Chunks chunks_;
+  RuleIndex index_; // Index of the rules for Append (not serialized, built on demand)
+
+  template<typename _CSeq, typename __Chunks>
+  void InsertCovers(const _CSeq &_cseq, const __Chunks &_chunks, std::size_t _n_threads) {
+    auto get_length = [](const auto &_chunk) -> auto {
+      return _chunk.size();
+    };
+
+    if (kExpand) {
+      auto action_expand = [this](auto &_set) { chunks_.Insert(_set.begin(), _set.end()); };
+
+      ComputePartitionCover(slp_, _cseq, _chunks, get_length, action_expand, 1, _n_threads);
+    } else {
+      auto action_no_expand = [this](auto &_set) {
+        std::sort(_set.begin(), _set.end());
+        chunks_.Insert(_set.begin(), _set.end());
+      };
+
+      ComputePartitionCover(slp_, _cseq, _chunks, get_length, action_no_expand, 1, _n_threads);
+    }
+  }
 };
 
 
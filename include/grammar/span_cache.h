@@ -0,0 +1,319 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#ifndef GRAMMAR_SPAN_CACHE_H
+#define GRAMMAR_SPAN_CACHE_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <iterator>
+#include <type_traits>
+
+
+namespace grammar {
+
+/**
+ * Span Cache
+ *
+ * Bounded cache of decompressed variable sets (spans) keyed by variable id. The memory budget (in bytes) is split
+ * among independent shards, each one guarded by its own lock, so the cache can be shared across threads with low
+ * contention. Eviction follows the CLOCK (second chance) policy.
+ *
+ * @tparam _ValueType
+ */
+template<typename _ValueType = uint32_t>
+class SpanCache {
+ public:
+  typedef std::vector<_ValueType> Set;
+  typedef std::shared_ptr<const Set> SetPtr;
+
+  /**
+   * Constructor
+   *
+   * @param _budget Memory budget in bytes
+   * @param _n_shards Number of shards (independent locks)
+   */
+  explicit SpanCache(std::size_t _budget, std::size_t _n_shards = 16) : shards_(std::max<std::size_t>(_n_shards, 1)) {
+    for (auto &shard : shards_) {
+      shard.budget = _budget / shards_.size();
+    }
+  }
+
+  /**
+   * Get the set of variable _var. On miss, the set is computed with _compute(_var, set) and stored if it fits in the
+   * budget of its shard.
+   *
+   * @tparam _Compute Functor to decompress the set of a variable
+   * @param _var
+   * @param _compute
+   * @return shared pointer to the set (it remains valid even if the set is evicted)
+   */
+  template<typename _Compute>
+  SetPtr Get(std::size_t _var, _Compute &&_compute) {
+    auto &shard = shards_[_var % shards_.size()];
+
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.index.find(_var);
+      if (it != shard.index.end()) {
+        auto &entry = shard.entries[it->second];
+        entry.referenced = true;
+        ++shard.hits;
+        return entry.set;
+      }
+      ++shard.misses;
+    }
+
+    // Decompress outside the lock
+    auto new_set = std::make_shared<Set>();
+    _compute(_var, *new_set);
+    SetPtr set = new_set;
+
+    auto bytes = Bytes(*set);
+    if (shard.budget < bytes)
+      return set;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(_var);
+    if (it != shard.index.end()) {
+      // Another thread stored it first
+      return shard.entries[it->second].set;
+    }
+
+    while (shard.budget < shard.size + bytes) {
+      shard.Evict();
+    }
+
+    shard.index[_var] = shard.entries.size();
+    shard.entries.push_back(Entry{_var, set, false});
+    shard.size += bytes;
+
+    return set;
+  }
+
+  /**
+   * Get number of hits
+   */
+  std::size_t Hits() const {
+    std::size_t hits = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      hits += shard.hits;
+    }
+    return hits;
+  }
+
+  /**
+   * Get number of misses
+   */
+  std::size_t Misses() const {
+    std::size_t misses = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      misses += shard.misses;
+    }
+    return misses;
+  }
+
+  /**
+   * Get memory used by the stored sets (in bytes)
+   */
+  std::size_t Size() const {
+    std::size_t size = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      size += shard.size;
+    }
+    return size;
+  }
+
+  /**
+   * Remove all the stored sets and reset the counters
+   */
+  void Clear() {
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.entries.clear();
+      shard.index.clear();
+      shard.hand = 0;
+      shard.size = 0;
+      shard.hits = 0;
+      shard.misses = 0;
+    }
+  }
+
+ private:
+  struct Entry {
+    std::size_t var;
+    SetPtr set;
+    bool referenced;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+    std::unordered_map<std::size_t, std::size_t> index;
+    std::size_t hand = 0;
+    std::size_t budget = 0;
+    std::size_t size = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+
+    // Evict the first non-referenced entry under the clock hand (second chance)
+    void Evict() {
+      while (true) {
+        if (entries.size() <= hand)
+          hand = 0;
+
+        auto &entry = entries[hand];
+        if (entry.referenced) {
+          entry.referenced = false;
+          ++hand;
+          continue;
+        }
+
+        size -= Bytes(*entry.set);
+        index.erase(entry.var);
+        if (hand != entries.size() - 1) {
+          entry = std::move(entries.back());
+          index[entry.var] = hand;
+        }
+        entries.pop_back();
+        return;
+      }
+    }
+  };
+
+  static std::size_t Bytes(const Set &_set) {
+    return sizeof(Entry) + _set.capacity() * sizeof(_ValueType);
+  }
+
+  std::vector<Shard> shards_;
+};
+
+
+/**
+ * Cached Set
+ *
+ * Container-like view (begin/end/size) of a set stored in a SpanCache.
+ *
+ * @tparam _SetPtr
+ */
+template<typename _SetPtr>
+class CachedSet {
+ public:
+  CachedSet(_SetPtr _set) : set_(std::move(_set)) {}
+
+  auto begin() const {
+    return set_->begin();
+  }
+
+  auto end() const {
+    return set_->end();
+  }
+
+  auto size() const {
+    return set_->size();
+  }
+
+ private:
+  _SetPtr set_;
+};
+
+
+/**
+ * Cached Spans
+ *
+ * Container of the spans of the variables of an SLP, indexed by variable, where each span is decompressed once and
+ * kept in the given cache.
+ *
+ * @tparam _SLP
+ * @tparam _Cache
+ */
+template<typename _SLP, typename _Cache = SpanCache<>>
+class CachedSpans {
+ public:
+  CachedSpans(const _SLP &_slp, _Cache &_cache) : slp_(_slp), cache_(_cache) {}
+
+  auto operator[](std::size_t _var) const {
+    auto compute = [this](std::size_t _v, auto &_set) {
+      slp_.Span(_v, back_inserter(_set));
+    };
+
+    return CachedSet<typename _Cache::SetPtr>(cache_.Get(_var, compute));
+  }
+
+ protected:
+  const _SLP &slp_;
+  _Cache &cache_;
+};
+
+
+template<typename _SLP, typename _Cache>
+auto BuildCachedSpans(const _SLP &_slp, _Cache &_cache) {
+  return CachedSpans<_SLP, _Cache>(_slp, _cache);
+}
+
+
+/**
+ * Cached Grammar-Compressed Chunks
+ *
+ * Expands the chunks of a GCChunks (with kExpand) using a cache of the spans of its variables, so hot variables are
+ * decompressed only once.
+ *
+ * @tparam _GCChunks
+ * @tparam _Cache
+ */
+template<typename _GCChunks, typename _Cache = SpanCache<>>
+class CachedGCChunks {
+ public:
+  CachedGCChunks(const _GCChunks &_gcchunks, _Cache &_cache)
+      : gcchunks_(_gcchunks), spans_(_gcchunks.GetSLP(), _cache) {}
+
+  auto size() const {
+    return gcchunks_.size();
+  }
+
+  std::vector<uint32_t> operator[](std::size_t i) const {
+    assert(i <= gcchunks_.size());
+
+    std::vector<uint32_t> set;
+
+    const auto &slp = gcchunks_.GetSLP();
+    auto chunk = gcchunks_.GetChunks()[i];
+    for (auto it = chunk.begin(); it != chunk.end(); ++it) {
+      auto value = *it;
+      if (slp.IsTerminal(value)) {
+        set.push_back(value);
+      } else {
+        auto span = spans_[value];
+        set.insert(set.end(), span.begin(), span.end());
+      }
+    }
+    return set;
+  }
+
+  const auto &GetSLP() const {
+    return gcchunks_.GetSLP();
+  }
+
+ protected:
+  const _GCChunks &gcchunks_;
+  CachedSpans<std::decay_t<decltype(std::declval<_GCChunks>().GetSLP())>, _Cache> spans_;
+};
+
+
+template<typename _GCChunks, typename _Cache>
+auto BuildCachedGCChunks(const _GCChunks &_gcchunks, _Cache &_cache) {
+  return CachedGCChunks<_GCChunks, _Cache>(_gcchunks, _cache);
+}
+
+}
+
+#endif //GRAMMAR_SPAN_CACHE_H
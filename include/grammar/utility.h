@@ -5,6 +5,7 @@
 #ifndef GRAMMAR_UTILITY_H
 #define GRAMMAR_UTILITY_H
 
+#include <cstddef>
 #include <type_traits>
 #include <algorithm>
 
@@ -14,7 +15,7 @@ namespace grammar {
 class NoAction {
  public:
   template<typename ...Args>
-  void operator()(Args... args) {}
+  void operator()(Args &&... args) const {}
 };
 
 
@@ -31,6 +32,58 @@ typename std::enable_if<!std::is_constructible<_X, _Y>::value>::type Construct(_
 }
 
 
+/**
+ * Iterator Range
+ *
+ * Non-owning container-like view of the elements in [first, last).
+ *
+ * @tparam _Iterator Random access iterator
+ */
+template<typename _Iterator>
+class IteratorRange {
+ public:
+  IteratorRange(_Iterator _first, _Iterator _last) : first_(_first), last_(_last) {}
+
+  _Iterator begin() const {
+    return first_;
+  }
+
+  _Iterator end() const {
+    return last_;
+  }
+
+  std::size_t size() const {
+    return last_ - first_;
+  }
+
+  bool empty() const {
+    return first_ == last_;
+  }
+
+  decltype(auto) front() const {
+    return *first_;
+  }
+
+  decltype(auto) back() const {
+    return *(last_ - 1);
+  }
+
+  decltype(auto) operator[](std::size_t i) const {
+    return first_[i];
+  }
+
+ private:
+  _Iterator first_;
+  _Iterator last_;
+};
+
+
+template<typename _Iterator>
+IteratorRange<_Iterator> MakeIteratorRange(_Iterator _first, _Iterator _last) {
+  return IteratorRange<_Iterator>(_first, _last);
+}
+
+
 // Primary template with a static assertion
 // for a meaningful error message
 // if it ever gets instantiated.
@@ -0,0 +1,136 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+
+#include "grammar/cardinality_sketch.h"
+#include "grammar/sampled_slp.h"
+#include "grammar/slp.h"
+#include "grammar/slp_metadata.h"
+#include "grammar/re_pair.h"
+
+
+TEST(KMVSketch, ExactBelowK) {
+  grammar::KMVSketch<64> sketch;
+  for (int k = 0; k < 3; ++k) {
+    for (uint64_t i = 1; i <= 50; ++i) {
+      sketch.Insert(i);
+    }
+  }
+
+  EXPECT_EQ(sketch.size(), 50);
+}
+
+
+TEST(KMVSketch, Estimate) {
+  grammar::KMVSketch<256> sketch;
+  const std::size_t n = 100000;
+  for (uint64_t i = 0; i < n; ++i) {
+    sketch.Insert(i * 7 + 3);
+  }
+
+  EXPECT_NEAR(double(sketch.size()), double(n), 0.2 * n);
+}
+
+
+TEST(KMVSketch, Merge) {
+  grammar::KMVSketch<32> sketch1, sketch2, sketch_union;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    sketch1.Insert(i);
+    sketch_union.Insert(i);
+  }
+  for (uint64_t i = 500; i < 3000; ++i) {
+    sketch2.Insert(i);
+    sketch_union.Insert(i);
+  }
+
+  sketch1.Merge(sketch2);
+  EXPECT_EQ(sketch1.GetHashes(), sketch_union.GetHashes());
+}
+
+
+class CardinalitySketches_TF : public ::testing::TestWithParam<int> {
+ protected:
+  grammar::SLP<> slp_{0};
+
+  void SetUp() override {
+    std::mt19937 gen(GetParam());
+    std::uniform_int_distribution<int> dist(1, GetParam());
+    std::vector<int> sequence(5000);
+    for (auto &item : sequence) {
+      item = dist(gen);
+    }
+
+    grammar::RePairEncoder<true> encoder;
+    grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp_);
+  }
+};
+
+
+TEST_P(CardinalitySketches_TF, Estimate) {
+  grammar::CardinalitySketches<64> sketches(slp_);
+  ASSERT_EQ(sketches.Variables(), slp_.Variables());
+
+  for (auto i = 1u; i <= slp_.Variables(); ++i) {
+    auto span = slp_.Span(i);
+    std::set<uint32_t> set(span.begin(), span.end());
+
+    if (set.size() < 64) {
+      EXPECT_EQ(sketches.Estimate(i), set.size()) << i;
+    } else {
+      EXPECT_NEAR(double(sketches.Estimate(i)), double(set.size()), 0.5 * set.size()) << i;
+    }
+    EXPECT_EQ(sketches[i].size(), sketches.Estimate(i));
+  }
+}
+
+
+TEST_P(CardinalitySketches_TF, SampledSLPWithoutExactSets) {
+  // All the sets have less than k elements, so the estimates are exact
+  grammar::CardinalitySketches<256> sketches(slp_);
+
+  for (uint32_t block_size : {4, 16, 64}) {
+    grammar::Chunks<> pts;
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    grammar::SampledSLP<> e_sslp(
+        slp_, block_size, add_set, add_set,
+        grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)));
+
+    grammar::Cardinalities cardinalities;
+    grammar::AddCardinality<decltype(sketches)> add_cardinality(sketches, cardinalities);
+    grammar::SampledSLP<> sslp(
+        slp_, block_size, add_cardinality, add_cardinality,
+        grammar::BuildSamplingPredicate(grammar::SketchSetSource<decltype(sketches)>(sketches),
+                                        grammar::AreChildrenTooBig<grammar::Cardinalities>(cardinalities, 2)));
+
+    EXPECT_EQ(sslp, e_sslp) << block_size;
+    ASSERT_EQ(cardinalities.size(), pts.size());
+    for (int i = 1; i <= pts.size(); ++i) {
+      EXPECT_EQ(cardinalities[i].size(), pts[i].size());
+    }
+  }
+}
+
+
+TEST_P(CardinalitySketches_TF, SampledPTSWithEstimatedSizes) {
+  grammar::SampledPTS<grammar::SLP<>> pts(&slp_, 8, 2, true);
+
+  for (auto i = 1u; i <= slp_.Variables(); ++i) {
+    auto span = slp_.Span(i);
+    sort(span.begin(), span.end());
+    span.erase(unique(span.begin(), span.end()), span.end());
+
+    EXPECT_EQ(pts[i], span) << i;
+  }
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    CardinalitySketches,
+    CardinalitySketches_TF,
+    ::testing::Values(8, 32, 200)
+);
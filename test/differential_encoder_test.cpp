@@ -0,0 +1,109 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+
+#include "grammar/differential_encoder.h"
+
+
+/**
+ * Random walk with differences in [-_max_diff, _max_diff]
+ */
+template<typename T>
+std::vector<T> RandomWalk(std::size_t _n, int _max_diff, T _first, unsigned _seed) {
+  std::mt19937 gen(_seed);
+  std::uniform_int_distribution<int> dist(-_max_diff, _max_diff);
+
+  std::vector<T> series(_n);
+  T value = _first;
+  for (auto &item : series) {
+    item = value;
+    value += dist(gen);
+  }
+
+  return series;
+}
+
+
+template<typename T>
+std::stringstream ToStream(const std::vector<T> &_series) {
+  std::stringstream ss;
+  ss.write(reinterpret_cast<const char *>(_series.data()), _series.size() * sizeof(T));
+  return ss;
+}
+
+
+class CompressSeries_TF : public ::testing::TestWithParam<std::tuple<std::size_t, std::size_t>> {
+};
+
+
+TEST_P(CompressSeries_TF, Values) {
+  auto n = std::get<0>(GetParam());
+  auto chunk_size = std::get<1>(GetParam());
+
+  auto series = RandomWalk<int32_t>(n, 4, 1000000, n);
+  auto in = ToStream(series);
+
+  grammar::DifferentialSLP<> dslp;
+  auto info = grammar::CompressSeries<int32_t>(in, dslp, 64, chunk_size, 8);
+
+  EXPECT_EQ(info.size, n);
+  EXPECT_EQ(info.first, series[0]);
+  EXPECT_LE(-4, info.min);
+  EXPECT_LE(info.max, 4);
+
+  ASSERT_EQ(dslp.size(), n);
+  for (std::size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(info.first + dslp.ValueAt(i), series[i]) << i;
+  }
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    DifferentialEncoder,
+    CompressSeries_TF,
+    ::testing::Values(
+        std::make_tuple(1, 0),
+        std::make_tuple(1000, 0),
+        std::make_tuple(1000, 4096),
+        std::make_tuple(20000, 0),
+        std::make_tuple(20000, 1000),
+        std::make_tuple(20001, 1000),
+        std::make_tuple(20000, 3000)
+    )
+);
+
+
+TEST(CompressSeries, Int64) {
+  auto series = RandomWalk<int64_t>(5000, 100, int64_t(1) << 40, 3);
+  auto in = ToStream(series);
+
+  grammar::DifferentialSLP<> dslp;
+  auto info = grammar::CompressSeries<int64_t>(in, dslp, 16);
+
+  ASSERT_EQ(dslp.size(), series.size());
+  for (std::size_t i = 0; i < series.size(); ++i) {
+    EXPECT_EQ(info.first + dslp.ValueAt(i), series[i]) << i;
+  }
+}
+
+
+TEST(CompressSeries, DifferenceOutOfRange) {
+  auto series = RandomWalk<int32_t>(5000, 10, 0, 5);
+  auto in = ToStream(series);
+
+  grammar::DifferentialSLP<> dslp;
+  EXPECT_THROW(grammar::CompressSeries<int32_t>(in, dslp, 16, 1000, 5), std::out_of_range);
+}
+
+
+TEST(CompressSeries, EmptySeries) {
+  std::stringstream in;
+
+  grammar::DifferentialSLP<> dslp;
+  EXPECT_THROW(grammar::CompressSeries<int32_t>(in, dslp, 16), std::invalid_argument);
+}
@@ -0,0 +1,524 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <fstream>
+#include <numeric>
+#include <type_traits>
+
+#include "grammar/differential_slp.h"
+#include "grammar/slp.h"
+#include "grammar/slp_helper.h"
+#include "grammar/re_pair.h"
+
+
+class DifferentialSLP_TF : public ::testing::TestWithParam<std::tuple<std::size_t, int>> {
+ protected:
+  std::vector<int> sequence_; // Differential sequence shifted by diff_base_
+  std::size_t diff_base_ = 0;
+  std::vector<std::size_t> cseq_;
+  grammar::SLP<> slp_;
+
+  void SetUp() override {
+    auto n = std::get<0>(GetParam());
+    auto max_diff = std::get<1>(GetParam());
+
+    std::mt19937 gen(n);
+    std::uniform_int_distribution<int> dist(-max_diff, max_diff);
+    diff_base_ = max_diff + 1;
+
+    sequence_.resize(n);
+    for (auto &item : sequence_) {
+      item = dist(gen) + diff_base_;
+    }
+
+    grammar::RePairEncoder<false> encoder;
+    auto wrapper = grammar::BuildSLPWrapper(slp_);
+    auto report_cseq = [this](auto _var) { cseq_.emplace_back(_var); };
+    encoder.Encode(sequence_.begin(), sequence_.end(), wrapper, report_cseq);
+  }
+};
+
+
+TEST_P(DifferentialSLP_TF, ComputeSpanSums) {
+  std::vector<int64_t> e_span_sums(slp_.Variables() - slp_.Sigma());
+  auto report = [this, &e_span_sums](auto _var, auto _sum) {
+    e_span_sums[_var - slp_.Sigma() - 1] = _sum;
+  };
+  auto e_minmax = grammar::ComputeSpanSums(slp_, diff_base_, report);
+
+  for (std::size_t n_threads : {1, 2, 4}) {
+    sdsl::int_vector<> span_sums;
+    auto minmax = grammar::ComputeSpanSums(slp_, diff_base_, span_sums, n_threads);
+
+    EXPECT_EQ(minmax.first, e_minmax.first) << n_threads;
+    EXPECT_EQ(minmax.second, e_minmax.second) << n_threads;
+    ASSERT_EQ(span_sums.size(), e_span_sums.size()) << n_threads;
+    for (std::size_t i = 0; i < span_sums.size(); ++i) {
+      EXPECT_EQ(int64_t(span_sums[i]), e_span_sums[i]) << i << " " << n_threads;
+    }
+  }
+}
+
+
+TEST_P(DifferentialSLP_TF, SpanSumsOfVariables) {
+  sdsl::int_vector<> span_sums;
+  auto minmax = grammar::ComputeSpanSums(slp_, diff_base_, span_sums, 3);
+  int64_t diff_base_sums = minmax.first < 0 ? -minmax.first : 0;
+
+  for (std::size_t var = slp_.Sigma() + 1; var <= slp_.Variables(); ++var) {
+    int64_t e_sum = 0;
+    for (const auto &item : slp_.Span(var)) {
+      e_sum += int64_t(item) - int64_t(diff_base_);
+    }
+
+    EXPECT_EQ(int64_t(span_sums[var - slp_.Sigma() - 1]) - diff_base_sums, e_sum) << var;
+  }
+}
+
+
+TEST_P(DifferentialSLP_TF, WrapperOperations) {
+  sdsl::int_vector<> span_sums;
+  auto minmax = grammar::ComputeSpanSums(slp_, diff_base_, span_sums);
+  std::size_t diff_base_sums = minmax.first < 0 ? -minmax.first : 0;
+
+  auto get_span_sum = [this, &span_sums, diff_base_sums](auto _var) -> int64_t {
+    return slp_.IsTerminal(_var) ? int64_t(_var) - int64_t(diff_base_)
+                                 : int64_t(span_sums[_var - slp_.Sigma() - 1]) - int64_t(diff_base_sums);
+  };
+
+  sdsl::bit_vector tmp_samples_pos(sequence_.size(), 0);
+  std::vector<int64_t> samples;
+  std::vector<std::size_t> sample_roots_pos;
+  auto report_sample = [&](auto _pos, auto _sum, auto _root_pos) {
+    tmp_samples_pos[_pos] = 1;
+    samples.emplace_back(_sum);
+    sample_roots_pos.emplace_back(_root_pos);
+  };
+  grammar::ComputeSamplesOnCompactSequence(cseq_, slp_, get_span_sum, 64, report_sample);
+
+  sdsl::sd_vector<> samples_pos(tmp_samples_pos);
+  sdsl::sd_vector<>::rank_1_type samples_pos_rank(&samples_pos);
+  sdsl::sd_vector<>::select_1_type samples_pos_select(&samples_pos);
+
+  auto dslp = grammar::MakeDifferentialSLPWrapper(sequence_.size(), slp_, cseq_, diff_base_, span_sums,
+                                                  diff_base_sums, samples, sample_roots_pos,
+                                                  samples_pos, samples_pos_rank, samples_pos_select);
+
+  // Original interface, with the sample structures given separately
+  using Wrapper = grammar::DifferentialSLPWrapper<grammar::SLP<>,
+                                                  std::vector<std::size_t>,
+                                                  sdsl::int_vector<>,
+                                                  std::vector<int64_t>,
+                                                  std::vector<std::size_t>>;
+  static_assert(std::is_same<decltype(dslp), Wrapper>::value, "MakeDifferentialSLPWrapper must build the original type");
+  Wrapper e_dslp(sequence_.size(), slp_, cseq_, diff_base_, span_sums, diff_base_sums, samples, sample_roots_pos,
+                 samples_pos, samples_pos_rank, samples_pos_select);
+  EXPECT_EQ(e_dslp.ValueAt(sequence_.size() - 1), dslp.ValueAt(sequence_.size() - 1));
+
+  auto value_sums = dslp.BuildValueSums();
+  auto leaf_blocks = dslp.BuildLeafBlocks(8);
+
+  // The differences of the leaf blocks are bit-packed with a shift, which must survive the serialization
+  {
+    std::ofstream out("tmp.leaf_blocks", std::ios::binary);
+    leaf_blocks.serialize(out);
+  }
+  decltype(leaf_blocks) loaded_leaf_blocks;
+  {
+    std::ifstream in("tmp.leaf_blocks", std::ios::binary);
+    loaded_leaf_blocks.load(in);
+  }
+  EXPECT_EQ(loaded_leaf_blocks.size(), leaf_blocks.size());
+
+  std::vector<int64_t> values;
+  int64_t value = 0;
+  for (const auto &item : sequence_) {
+    value += int64_t(item) - int64_t(diff_base_);
+    values.emplace_back(value);
+  }
+
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(dslp.ValueAt(i), values[i]) << i;
+  }
+
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<std::size_t> dist(0, values.size() - 1);
+  for (int k = 0; k < 300; ++k) {
+    auto sp = dist(gen), ep = dist(gen);
+    if (ep < sp) std::swap(sp, ep);
+
+    int64_t e_sum = 0;
+    for (auto i = sp; i <= ep; ++i) {
+      e_sum += values[i];
+    }
+
+    EXPECT_EQ(dslp.RangeSum(sp, ep), values[ep] - (sp == 0 ? 0 : values[sp - 1])) << sp << " " << ep;
+    EXPECT_EQ(dslp.SumOfValues(sp, ep, value_sums), e_sum) << sp << " " << ep;
+    EXPECT_EQ(dslp.SumOfValues(sp, ep), e_sum) << sp << " " << ep;
+
+    std::vector<int64_t> expanded;
+    grammar::ExpandDifferentialSLP(dslp, sp, ep, [&expanded](auto _value) { expanded.emplace_back(_value); });
+    EXPECT_TRUE(std::equal(expanded.begin(), expanded.end(), values.begin() + sp, values.begin() + ep + 1))
+              << sp << " " << ep;
+
+    std::vector<int64_t> buffer(ep - sp + 1);
+    EXPECT_EQ(dslp.ExpandToBuffer(sp, ep, buffer.data()), buffer.size());
+    EXPECT_EQ(buffer, expanded) << sp << " " << ep;
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    EXPECT_EQ(dslp.ExpandToBuffer(sp, ep, buffer.data(), leaf_blocks), buffer.size());
+    EXPECT_EQ(buffer, expanded) << sp << " " << ep;
+
+    std::fill(buffer.begin(), buffer.end(), 0);
+    EXPECT_EQ(dslp.ExpandToBuffer(sp, ep, buffer.data(), loaded_leaf_blocks), buffer.size());
+    EXPECT_EQ(buffer, expanded) << sp << " " << ep;
+  }
+}
+
+
+using PlainDifferentialSLPSamples = grammar::DifferentialSLPSamples<sdsl::int_vector<>,
+                                                                   sdsl::int_vector<>,
+                                                                   sdsl::bit_vector,
+                                                                   sdsl::rank_support_v<>,
+                                                                   sdsl::select_support_mcl<>>;
+
+
+/**
+ * Serialize the samples followed by a sentinel, so the load must read back exactly what was written
+ */
+template<typename Samples>
+void CheckSamplesSerialization(const Samples &_samples) {
+  const uint64_t e_sentinel = 0xABCDEF;
+  {
+    std::ofstream out("tmp.dslp_samples", std::ios::binary);
+    _samples.serialize(out);
+    sdsl::serialize(e_sentinel, out);
+  }
+
+  Samples samples;
+  uint64_t sentinel = 0;
+  {
+    std::ifstream in("tmp.dslp_samples", std::ios::binary);
+    samples.load(in);
+    sdsl::load(sentinel, in);
+  }
+
+  EXPECT_EQ(sentinel, e_sentinel);
+  ASSERT_EQ(samples.size(), _samples.size());
+  for (std::size_t i = 1; i <= samples.size(); ++i) {
+    EXPECT_EQ(samples.SamplePosition(i), _samples.SamplePosition(i)) << i;
+    EXPECT_EQ(samples.SampleFirstRoot(i), _samples.SampleFirstRoot(i)) << i;
+    EXPECT_EQ(samples.SampleValue(i), _samples.SampleValue(i)) << i;
+    EXPECT_EQ(samples.Sample(samples.SamplePosition(i)), i) << i;
+  }
+}
+
+
+TEST_P(DifferentialSLP_TF, Samples) {
+  sdsl::int_vector<> span_sums;
+  auto minmax = grammar::ComputeSpanSums(slp_, diff_base_, span_sums);
+  std::size_t diff_base_sums = minmax.first < 0 ? -minmax.first : 0;
+
+  auto get_span_sum = [this, &span_sums, diff_base_sums](auto _var) -> int64_t {
+    return slp_.IsTerminal(_var) ? int64_t(_var) - int64_t(diff_base_)
+                                 : int64_t(span_sums[_var - slp_.Sigma() - 1]) - int64_t(diff_base_sums);
+  };
+
+  std::vector<int64_t> values;
+  int64_t value = 0;
+  for (const auto &item : sequence_) {
+    value += int64_t(item) - int64_t(diff_base_);
+    values.emplace_back(value);
+  }
+
+  for (std::size_t max_span_length : {4, 64, 1024}) {
+    std::vector<std::size_t> e_positions;
+    std::vector<int64_t> e_values;
+    std::vector<std::size_t> e_roots_pos;
+    auto report_sample = [&](auto _pos, auto _sum, auto _root_pos) {
+      e_positions.emplace_back(_pos);
+      e_values.emplace_back(_sum);
+      e_roots_pos.emplace_back(_root_pos);
+    };
+    grammar::ComputeSamplesOnCompactSequence(cseq_, slp_, get_span_sum, max_span_length, report_sample);
+
+    grammar::DifferentialSLPSamples<> samples(sequence_.size(), cseq_, slp_, get_span_sum, max_span_length);
+    ASSERT_EQ(samples.size(), e_values.size()) << max_span_length;
+    for (std::size_t i = 0; i < e_values.size(); ++i) {
+      EXPECT_EQ(samples.SamplePosition(i + 1), e_positions[i]) << i;
+      EXPECT_EQ(int64_t(samples.SampleValue(i + 1)), e_values[i]) << i;
+      EXPECT_EQ(samples.SampleFirstRoot(i + 1), e_roots_pos[i]) << i;
+      EXPECT_EQ(samples.Sample(e_positions[i]), i + 1) << i;
+    }
+
+    CheckSamplesSerialization(samples);
+    CheckSamplesSerialization(PlainDifferentialSLPSamples(
+        sequence_.size(), cseq_, slp_, get_span_sum, max_span_length));
+
+    auto copy = samples;
+    auto dslp = grammar::MakeDifferentialSLPWrapper(sequence_.size(), slp_, cseq_, diff_base_, span_sums,
+                                                    diff_base_sums, copy);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      EXPECT_EQ(dslp.ValueAt(i), values[i]) << i << " " << max_span_length;
+    }
+  }
+}
+
+
+TEST_P(DifferentialSLP_TF, SamplesOfSeveralIntervals) {
+  auto get_span_sum = [this](auto _var) -> int64_t {
+    int64_t sum = 0;
+    for (const auto &item : slp_.Span(_var)) {
+      sum += int64_t(item) - int64_t(diff_base_);
+    }
+    return sum;
+  };
+
+  std::vector<std::size_t> max_span_lengths = {1, 16, 300, 4096};
+  std::vector<std::vector<std::tuple<std::size_t, int64_t, std::size_t>>> samples(max_span_lengths.size());
+  grammar::ComputeSamplesOnCompactSequence(
+      cseq_, slp_, get_span_sum, max_span_lengths, [&samples](auto _k, auto _pos, auto _sum, auto _root_pos) {
+        samples[_k].emplace_back(_pos, _sum, _root_pos);
+      });
+
+  for (std::size_t k = 0; k < max_span_lengths.size(); ++k) {
+    std::vector<std::tuple<std::size_t, int64_t, std::size_t>> e_samples;
+    grammar::ComputeSamplesOnCompactSequence(
+        cseq_, slp_, get_span_sum, max_span_lengths[k], [&e_samples](auto _pos, auto _sum, auto _root_pos) {
+          e_samples.emplace_back(_pos, _sum, _root_pos);
+        });
+
+    EXPECT_EQ(samples[k], e_samples) << max_span_lengths[k];
+  }
+}
+
+
+TEST_P(DifferentialSLP_TF, HierarchicalSamples) {
+  sdsl::int_vector<> span_sums;
+  auto minmax = grammar::ComputeSpanSums(slp_, diff_base_, span_sums);
+  std::size_t diff_base_sums = minmax.first < 0 ? -minmax.first : 0;
+
+  auto get_span_sum = [this, &span_sums, diff_base_sums](auto _var) -> int64_t {
+    return slp_.IsTerminal(_var) ? int64_t(_var) - int64_t(diff_base_)
+                                 : int64_t(span_sums[_var - slp_.Sigma() - 1]) - int64_t(diff_base_sums);
+  };
+
+  std::vector<int64_t> values;
+  int64_t value = 0;
+  for (const auto &item : sequence_) {
+    value += int64_t(item) - int64_t(diff_base_);
+    values.emplace_back(value);
+  }
+
+  for (std::size_t max_span_length : {1, 64}) {
+    grammar::DifferentialSLPSamples<> e_samples(sequence_.size(), cseq_, slp_, get_span_sum, max_span_length);
+
+    for (std::size_t coarse_rate : {1, 4, 64}) {
+      grammar::HierarchicalDifferentialSLPSamples<> samples(
+          sequence_.size(), cseq_, slp_, get_span_sum, max_span_length, coarse_rate);
+
+      ASSERT_EQ(samples.size(), e_samples.size());
+      for (std::size_t i = 1; i <= samples.size(); ++i) {
+        EXPECT_EQ(samples.SamplePosition(i), e_samples.SamplePosition(i)) << i;
+        EXPECT_EQ(samples.SampleFirstRoot(i), e_samples.SampleFirstRoot(i)) << i;
+        EXPECT_EQ(samples.SampleValue(i), int64_t(e_samples.SampleValue(i))) << i;
+      }
+
+      CheckSamplesSerialization(samples);
+      CheckSamplesSerialization(grammar::HierarchicalDifferentialSLPSamples<sdsl::bit_vector,
+                                                                            sdsl::rank_support_v<>,
+                                                                            sdsl::select_support_mcl<>>(
+          sequence_.size(), cseq_, slp_, get_span_sum, max_span_length, coarse_rate));
+
+      {
+        std::ofstream out("tmp.dslp_samples", std::ios::binary);
+        samples.serialize(out);
+      }
+      grammar::HierarchicalDifferentialSLPSamples<> samples_loaded;
+      {
+        std::ifstream in("tmp.dslp_samples", std::ios::binary);
+        samples_loaded.load(in);
+      }
+
+      auto dslp = grammar::MakeDifferentialSLPWrapper(sequence_.size(), slp_, cseq_, diff_base_, span_sums,
+                                                      diff_base_sums, samples_loaded);
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(dslp.ValueAt(i), values[i]) << i << " " << max_span_length << " " << coarse_rate;
+      }
+
+      std::vector<int64_t> expanded;
+      grammar::ExpandDifferentialSLP(dslp, 0, values.size() - 1, [&expanded](auto _value) {
+        expanded.emplace_back(_value);
+      });
+      EXPECT_EQ(expanded, values) << max_span_length << " " << coarse_rate;
+    }
+  }
+}
+
+
+template<typename DSLP>
+void CheckDifferentialSLP(const DSLP &_dslp, const std::vector<int64_t> &_values) {
+  ASSERT_EQ(_dslp.size(), _values.size());
+  for (std::size_t i = 0; i < _values.size(); ++i) {
+    EXPECT_EQ(_dslp.ValueAt(i), _values[i]) << i;
+  }
+
+  std::vector<int64_t> expanded;
+  grammar::ExpandDifferentialSLP(_dslp, 0, _values.size() - 1, [&expanded](auto _value) {
+    expanded.emplace_back(_value);
+  });
+  EXPECT_EQ(expanded, _values);
+
+  std::vector<int64_t> buffer(_values.size());
+  _dslp.ExpandToBuffer(0, _values.size() - 1, buffer.data(), _dslp.BuildLeafBlocks());
+  EXPECT_EQ(buffer, _values);
+
+  auto value_sums = _dslp.BuildValueSums();
+  auto ep = _values.size() - 1, sp = ep / 3;
+  EXPECT_EQ(_dslp.SumOfValues(sp, ep, value_sums), std::accumulate(_values.begin() + sp, _values.end(), int64_t(0)));
+  EXPECT_EQ(_dslp.RangeSum(sp, ep), _values[ep] - (sp == 0 ? 0 : _values[sp - 1]));
+}
+
+
+TEST_P(DifferentialSLP_TF, OwningDifferentialSLP) {
+  std::vector<int64_t> values;
+  int64_t value = 0;
+  for (const auto &item : sequence_) {
+    value += int64_t(item) - int64_t(diff_base_);
+    values.emplace_back(value);
+  }
+
+  grammar::DifferentialSLP<> dslp(sequence_.size(), slp_, cseq_, diff_base_, 64, 2);
+  CheckDifferentialSLP(dslp, values);
+
+  {
+    std::ofstream out("tmp.dslp", std::ios::binary);
+    dslp.serialize(out);
+  }
+  grammar::DifferentialSLP<> dslp_loaded;
+  {
+    std::ifstream in("tmp.dslp", std::ios::binary);
+    dslp_loaded.load(in);
+  }
+  CheckDifferentialSLP(dslp_loaded, values);
+
+  using HierarchicalDSLP = grammar::DifferentialSLP<grammar::SLP<sdsl::int_vector<>, sdsl::int_vector<>>,
+                                                    sdsl::int_vector<>,
+                                                    sdsl::int_vector<>,
+                                                    grammar::HierarchicalDifferentialSLPSamples<>>;
+  HierarchicalDSLP hdslp(sequence_.size(), slp_, cseq_, diff_base_, 1);
+  CheckDifferentialSLP(hdslp, values);
+}
+
+
+TEST(ChooseSampling, Policies) {
+  std::vector<grammar::SamplingCandidate> candidates = {
+      {16, 1000, 15.0},
+      {64, 600, 20.0},
+      {128, 700, 40.0}, // Dominated by 64
+      {256, 500, 50.0},
+      {1024, 450, 200.0}
+  };
+
+  // Minimum size x latency
+  EXPECT_EQ(grammar::ChooseSampling(candidates), 1);
+
+  // Fastest within the memory budget, or the smallest
+  EXPECT_EQ(grammar::ChooseSampling(candidates, 2000), 0);
+  EXPECT_EQ(grammar::ChooseSampling(candidates, 550), 3);
+  EXPECT_EQ(grammar::ChooseSampling(candidates, 100), 4);
+
+  // Smallest within the latency target, or the fastest
+  EXPECT_EQ(grammar::ChooseSampling(candidates, 0, 45.0), 1);
+  EXPECT_EQ(grammar::ChooseSampling(candidates, 0, 1000.0), 4);
+  EXPECT_EQ(grammar::ChooseSampling(candidates, 0, 1.0), 0);
+
+  EXPECT_EQ(grammar::ChooseSampling({{64, 600, 20.0}}, 100, 1.0), 0);
+}
+
+
+/**
+ * SLP with a forest of roots, as required by ExpandSLPFromFront
+ */
+struct ForestSLP : public grammar::SLP<> {
+  std::vector<std::size_t> roots;
+
+  ForestSLP(std::size_t _sigma) : grammar::SLP<>(_sigma) {}
+
+  std::size_t Root(std::size_t _i) const {
+    return roots[_i];
+  }
+};
+
+
+TEST(ExpandSLPFromFront, DeepGrammar) {
+  // Left-deep and right-deep chains of height 300 (beyond the inline capacity of the stack)
+  ForestSLP slp(2);
+  std::vector<std::size_t> sequence;
+
+  std::size_t left_deep = 1;
+  sequence.push_back(1);
+  for (int i = 0; i < 300; ++i) {
+    left_deep = slp.AddRule(left_deep, 1 + i % 2);
+    sequence.push_back(1 + i % 2);
+  }
+  slp.roots.push_back(left_deep);
+
+  std::vector<std::size_t> right_sequence(1, 2);
+  std::size_t right_deep = 2;
+  for (int i = 0; i < 300; ++i) {
+    right_deep = slp.AddRule(1 + i % 2, right_deep);
+    right_sequence.insert(right_sequence.begin(), 1 + i % 2);
+  }
+  slp.roots.push_back(right_deep);
+  sequence.insert(sequence.end(), right_sequence.begin(), right_sequence.end());
+
+  for (std::size_t sp = 0; sp < sequence.size(); sp += 7) {
+    for (std::size_t len : {1, 2, 50, 400}) {
+      if (sequence.size() < sp + len)
+        continue;
+
+      std::vector<std::size_t> expanded;
+      std::size_t skipped = 0;
+      grammar::ExpandSLPFromFront(slp, 0, sp, len,
+                                  [&expanded](auto _var) { expanded.emplace_back(_var); },
+                                  [&slp, &skipped](auto _var) { skipped += slp.SpanLength(_var); });
+
+      EXPECT_EQ(skipped, sp) << sp << " " << len;
+      EXPECT_TRUE(std::equal(expanded.begin(), expanded.end(), sequence.begin() + sp)) << sp << " " << len;
+      EXPECT_EQ(expanded.size(), len) << sp << " " << len;
+    }
+  }
+}
+
+
+TEST(PrefixSum, OddAndEvenLengths) {
+  for (std::size_t n : {0, 1, 2, 3, 8, 11}) {
+    std::vector<int64_t> values(n), e_values(n);
+    int64_t sum = -5;
+    for (std::size_t i = 0; i < n; ++i) {
+      values[i] = (i % 3 == 0) ? -int64_t(i) : int64_t(i * i);
+      sum += values[i];
+      e_values[i] = sum;
+    }
+
+    grammar::PrefixSum(values.data(), values.data() + n, -5);
+    EXPECT_EQ(values, e_values) << n;
+  }
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    DifferentialSLP,
+    DifferentialSLP_TF,
+    ::testing::Values(
+        std::make_tuple(10, 2),
+        std::make_tuple(1000, 3),
+        std::make_tuple(20000, 5),
+        std::make_tuple(20000, 50)
+    )
+);
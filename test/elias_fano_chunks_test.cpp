@@ -0,0 +1,120 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <numeric>
+
+#include "grammar/elias_fano_chunks.h"
+#include "grammar/slp_metadata.h"
+#include "grammar/algorithm.h"
+
+
+using Set = std::vector<uint32_t>;
+using Sets = std::vector<Set>;
+
+
+class EliasFanoChunks_TF : public ::testing::TestWithParam<Sets> {};
+
+
+TEST_P(EliasFanoChunks_TF, InsertAndAccess) {
+  const auto &sets = GetParam();
+
+  grammar::EliasFanoChunks<> chunks;
+  for (int i = 0; i < sets.size(); ++i) {
+    EXPECT_EQ(chunks.Insert(sets[i].begin(), sets[i].end()), i + 1);
+  }
+
+  ASSERT_EQ(chunks.size(), sets.size());
+  for (int i = 0; i < sets.size(); ++i) {
+    EXPECT_EQ(chunks.ChunkLength(i + 1), sets[i].size());
+    EXPECT_EQ(chunks[i + 1], sets[i]) << i;
+  }
+}
+
+
+TEST_P(EliasFanoChunks_TF, ConstructFromChunksAndDecode) {
+  const auto &sets = GetParam();
+
+  grammar::Chunks<> chunks;
+  for (const auto &item : sets) {
+    chunks.Insert(item.begin(), item.end());
+  }
+
+  grammar::EliasFanoChunks<> ef_chunks(chunks);
+  ASSERT_EQ(ef_chunks.size(), sets.size());
+
+  std::vector<uint32_t> ids(sets.size());
+  std::iota(ids.begin(), ids.end(), 1);
+  grammar::SetsBuffer<> buffer;
+  buffer.Decode(ids.begin(), ids.end(), ef_chunks);
+  for (int i = 0; i < sets.size(); ++i) {
+    auto set = buffer[i];
+    ASSERT_EQ(set.size(), sets[i].size()) << i;
+    EXPECT_TRUE(std::equal(set.begin(), set.end(), sets[i].begin())) << i;
+  }
+}
+
+
+TEST_P(EliasFanoChunks_TF, Serialization) {
+  const auto &sets = GetParam();
+
+  grammar::EliasFanoChunks<> chunks;
+  for (const auto &item : sets) {
+    chunks.Insert(item.begin(), item.end());
+  }
+
+  {
+    std::ofstream out("tmp.elias_fano_chunks", std::ios::binary);
+    chunks.serialize(out);
+  }
+
+  grammar::EliasFanoChunks<> chunks_loaded;
+  EXPECT_FALSE(chunks == chunks_loaded);
+
+  {
+    std::ifstream in("tmp.elias_fano_chunks", std::ios::binary);
+    chunks_loaded.load(in);
+  }
+  EXPECT_TRUE(chunks == chunks_loaded);
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    EliasFanoChunks,
+    EliasFanoChunks_TF,
+    ::testing::Values(
+        Sets{{1, 2, 3, 4}, {1, 2, 3}, {3}, {1, 2, 3}, {1, 2}},
+        Sets{{1}, {}, {3, 4}, {0}, {}, {5, 5, 7}},
+        Sets{{0, 100, 1000, 1 << 20}, {7}, {4294967295u}, {1, 2, 3, 64, 65, 66, 127, 128, 129}}
+    )
+);
+
+
+TEST(EliasFanoChunks, RandomSets) {
+  std::mt19937 gen(11);
+
+  grammar::EliasFanoChunks<> chunks;
+  Sets sets;
+  for (uint32_t max_value : {1u, 10u, 1000u, 1u << 16, 1u << 30}) {
+    std::uniform_int_distribution<uint32_t> dist(0, max_value);
+    for (int i = 0; i < 30; ++i) {
+      Set set(i * 5);
+      for (auto &item : set) {
+        item = dist(gen);
+      }
+      std::sort(set.begin(), set.end());
+      set.erase(std::unique(set.begin(), set.end()), set.end());
+
+      chunks.Insert(set.begin(), set.end());
+      sets.emplace_back(set);
+    }
+  }
+
+  ASSERT_EQ(chunks.size(), sets.size());
+  for (int i = 0; i < sets.size(); ++i) {
+    EXPECT_EQ(chunks[i + 1], sets[i]) << i;
+  }
+}
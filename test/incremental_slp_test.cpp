@@ -0,0 +1,349 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <fstream>
+#include <set>
+
+#include "grammar/incremental_slp.h"
+#include "grammar/sampled_slp.h"
+#include "grammar/slp.h"
+#include "grammar/slp_metadata.h"
+#include "grammar/re_pair.h"
+
+
+std::vector<int> RandomSequence(std::size_t _n, int _sigma, unsigned _seed) {
+  std::mt19937 gen(_seed);
+  std::uniform_int_distribution<int> dist(1, _sigma);
+  std::vector<int> sequence(_n);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  return sequence;
+}
+
+
+class IncrementalSLP_TF : public ::testing::TestWithParam<std::tuple<std::size_t, std::size_t>> {
+ protected:
+  std::vector<int> sequence_;
+  std::vector<std::size_t> blocks_; // Block boundaries
+
+  void SetUp() override {
+    auto n = std::get<0>(GetParam());
+    auto block_size = std::get<1>(GetParam());
+
+    sequence_ = RandomSequence(n, 16, n);
+    for (std::size_t i = 0; i < n; i += block_size) {
+      blocks_.push_back(i);
+    }
+    blocks_.push_back(n);
+  }
+};
+
+
+TEST_P(IncrementalSLP_TF, Append) {
+  grammar::IncrementalSLP<> slp(16);
+  grammar::RePairEncoder<false> encoder;
+
+  for (std::size_t i = 0; i + 1 < blocks_.size(); ++i) {
+    auto root = slp.Append(sequence_.begin() + blocks_[i], sequence_.begin() + blocks_[i + 1], encoder);
+
+    auto span = slp.Span(root);
+    EXPECT_TRUE(std::equal(span.begin(), span.end(), sequence_.begin() + blocks_[i])) << i;
+
+    EXPECT_EQ(slp.Length(), blocks_[i + 1]);
+    EXPECT_EQ(slp.Start(), (i == 0) ? root : 0) << i;
+
+    // The segments derive the whole sequence
+    std::vector<uint32_t> all;
+    for (const auto &segment : slp.GetSegments()) {
+      slp.Span(segment, back_inserter(all));
+    }
+    ASSERT_EQ(all.size(), blocks_[i + 1]) << i;
+    EXPECT_TRUE(std::equal(all.begin(), all.end(), sequence_.begin())) << i;
+  }
+
+  EXPECT_EQ(slp.GetSegments().size(), blocks_.size() - 1);
+  EXPECT_EQ(slp.GetSegmentsOffsets(), blocks_);
+}
+
+
+/**
+ * Height of the parse tree of a variable
+ */
+template<typename _SLP>
+std::size_t Height(const _SLP &_slp, std::size_t _var) {
+  if (_slp.IsTerminal(_var)) {
+    return 0;
+  }
+
+  auto children = _slp[_var];
+  return 1 + std::max(Height(_slp, children.first), Height(_slp, children.second));
+}
+
+
+TEST_P(IncrementalSLP_TF, BuildStart) {
+  grammar::IncrementalSLP<> slp(16);
+  grammar::RePairEncoder<false> encoder;
+
+  std::size_t max_segment_height = 0;
+  for (std::size_t i = 0; i + 1 < blocks_.size(); ++i) {
+    auto root = slp.Append(sequence_.begin() + blocks_[i], sequence_.begin() + blocks_[i + 1], encoder);
+    max_segment_height = std::max(max_segment_height, Height(slp, root));
+
+    auto n_vars = slp.Variables();
+    auto start = slp.BuildStart();
+    EXPECT_EQ(slp.Start(), start);
+
+    // Only the rules over the changed segments are added
+    std::size_t log_segments = 0;
+    while ((std::size_t(1) << log_segments) < slp.GetSegments().size()) ++log_segments;
+    EXPECT_LE(slp.Variables() - n_vars, log_segments) << i;
+    EXPECT_LE(Height(slp, start), max_segment_height + log_segments) << i;
+
+    auto all = slp.Span(start);
+    ASSERT_EQ(all.size(), blocks_[i + 1]) << i;
+    EXPECT_TRUE(std::equal(all.begin(), all.end(), sequence_.begin())) << i;
+
+    // The start is kept until the next append
+    n_vars = slp.Variables();
+    EXPECT_EQ(slp.BuildStart(), start);
+    EXPECT_EQ(slp.Variables(), n_vars);
+  }
+}
+
+
+TEST_P(IncrementalSLP_TF, PTSExtend) {
+  grammar::IncrementalSLP<> slp(16);
+  grammar::RePairEncoder<false> encoder;
+  grammar::PTS<> pts;
+
+  for (std::size_t i = 0; i + 1 < blocks_.size(); ++i) {
+    slp.Append(sequence_.begin() + blocks_[i], sequence_.begin() + blocks_[i + 1], encoder);
+
+    if (i == 0) {
+      pts.Compute(&slp);
+    } else {
+      pts.Extend(&slp);
+    }
+
+    grammar::PTS<> e_pts(&slp);
+    EXPECT_TRUE(pts == e_pts) << i;
+  }
+}
+
+
+TEST_P(IncrementalSLP_TF, SampledCover) {
+  grammar::IncrementalSLP<> slp(16);
+  grammar::RePairEncoder<false> encoder;
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  auto pred = grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2));
+
+  grammar::IncrementalSampledSLP<> sslp;
+  for (std::size_t i = 0; i + 1 < blocks_.size(); ++i) {
+    slp.Append(sequence_.begin() + blocks_[i], sequence_.begin() + blocks_[i + 1], encoder);
+    sslp.Update(slp, 4, add_set, add_set, pred);
+  }
+
+  ASSERT_EQ(sslp.Segments(), blocks_.size() - 1);
+  EXPECT_EQ(sslp.Length(), sequence_.size());
+  EXPECT_EQ(sslp.Nodes(), pts.size());
+
+  for (std::size_t pos = 0; pos < sequence_.size(); ++pos) {
+    auto leaf = sslp.Leaf(pos);
+    EXPECT_LE(sslp.Position(leaf), pos) << pos;
+    EXPECT_LT(pos, sslp.Position(leaf + 1)) << pos;
+  }
+
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<std::size_t> dist(0, sequence_.size());
+  for (int k = 0; k < 200; ++k) {
+    auto bp = dist(gen), ep = dist(gen);
+    if (ep < bp) std::swap(bp, ep);
+
+    std::set<uint32_t> set;
+    auto range = sslp.Cover(bp, ep, [&pts, &set](auto _node) {
+      auto chunk = pts[_node];
+      set.insert(chunk.begin(), chunk.end());
+    });
+
+    ASSERT_LE(bp, range.first) << bp << " " << ep;
+    ASSERT_LE(range.second, ep) << bp << " " << ep;
+
+    std::set<uint32_t> e_set(sequence_.begin() + range.first, sequence_.begin() + std::max(range.first, range.second));
+    EXPECT_EQ(set, e_set) << bp << " " << ep;
+  }
+}
+
+
+TEST_P(IncrementalSLP_TF, SampledSegments) {
+  grammar::IncrementalSLP<> slp(16);
+  grammar::RePairEncoder<false> encoder;
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  auto pred = grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2));
+
+  grammar::IncrementalSampledSLP<> sslp;
+  std::size_t node_offset = 0;
+  for (std::size_t i = 0; i + 1 < blocks_.size(); ++i) {
+    slp.Append(sequence_.begin() + blocks_[i], sequence_.begin() + blocks_[i + 1], encoder);
+    sslp.Update(slp, 4, add_set, add_set, pred);
+
+    // Each segment must be the sampled tree computed from scratch over its rooted SLP
+    grammar::Chunks<> e_pts;
+    grammar::AddSet<grammar::Chunks<>> e_add_set(e_pts);
+    grammar::SampledSLP<> e_sslp(
+        grammar::BuildRootedSLP(slp, slp.GetSegments()[i]), 4, e_add_set, e_add_set,
+        grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(e_pts, 2)));
+
+    EXPECT_TRUE(sslp.GetSegment(i) == e_sslp) << i;
+
+    ASSERT_EQ(sslp.Nodes() - node_offset, e_pts.size()) << i;
+    for (std::size_t j = 1; j <= e_pts.size(); ++j) {
+      auto set = pts[node_offset + j];
+      auto e_set = e_pts[j];
+      EXPECT_TRUE(std::equal(set.begin(), set.end(), e_set.begin(), e_set.end())) << i << " " << j;
+    }
+    node_offset = sslp.Nodes();
+  }
+}
+
+
+TEST_P(IncrementalSLP_TF, SampledSerialization) {
+  grammar::IncrementalSLP<> slp(16);
+  grammar::RePairEncoder<false> encoder;
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  auto pred = grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2));
+
+  grammar::IncrementalSampledSLP<> sslp;
+  for (std::size_t i = 0; i + 1 < blocks_.size(); ++i) {
+    slp.Append(sequence_.begin() + blocks_[i], sequence_.begin() + blocks_[i + 1], encoder);
+    sslp.Update(slp, 4, add_set, add_set, pred);
+  }
+
+  {
+    std::ofstream out("tmp.sampled_slp", std::ios::binary);
+    sslp.serialize(out);
+  }
+
+  grammar::IncrementalSampledSLP<> sslp_loaded;
+  {
+    std::ifstream in("tmp.sampled_slp", std::ios::binary);
+    sslp_loaded.load(in);
+  }
+
+  EXPECT_TRUE(sslp == sslp_loaded);
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    IncrementalSLP,
+    IncrementalSLP_TF,
+    ::testing::Values(
+        std::make_tuple(100, 100),
+        std::make_tuple(1000, 300),
+        std::make_tuple(3000, 250),
+        std::make_tuple(3000, 1024)
+    )
+);
+
+
+TEST(IncrementalSLP, RepeatedBlockReusesRules) {
+  auto block = RandomSequence(1000, 8, 5);
+
+  grammar::IncrementalSLP<> slp(8);
+  grammar::RePairEncoder<false> encoder;
+
+  slp.Append(block.begin(), block.end(), encoder);
+  auto n_vars = slp.Variables();
+
+  auto root = slp.Append(block.begin(), block.end(), encoder);
+
+  // The repeated block is mostly reduced with the existing rules
+  EXPECT_LT(slp.Variables() - n_vars, (n_vars - slp.Sigma()) / 10);
+  EXPECT_EQ(slp.Span(root), std::vector<uint32_t>(block.begin(), block.end()));
+}
+
+
+TEST(IncrementalSLP, ShortFirstBlock) {
+  std::vector<int> block = {3};
+
+  grammar::IncrementalSLP<> slp(8);
+  grammar::RePairEncoder<false> encoder;
+
+  EXPECT_THROW(slp.Append(block.begin(), block.end(), encoder), std::invalid_argument);
+
+  // Short blocks are fine after the first one
+  std::vector<int> first_block = {1, 2, 1};
+  slp.Append(first_block.begin(), first_block.end(), encoder);
+  EXPECT_EQ(slp.Append(block.begin(), block.end(), encoder), 3u);
+  EXPECT_EQ(slp.Span(slp.BuildStart()), std::vector<uint32_t>({1, 2, 1, 3}));
+}
+
+
+TEST(IncrementalSLP, SymbolOutOfAlphabet) {
+  std::vector<int> block = {1, 2, 9, 1};
+
+  grammar::IncrementalSLP<> slp(8);
+  grammar::RePairEncoder<false> encoder;
+
+  EXPECT_THROW(slp.Append(block.begin(), block.end(), encoder), std::out_of_range);
+}
+
+
+TEST(GCChunks, Append) {
+  auto sequence = RandomSequence(4000, 32, 11);
+
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<std::size_t> dist(1, 20);
+
+  std::vector<std::vector<uint32_t>> sets;
+  for (std::size_t i = 0; i < sequence.size();) {
+    auto j = std::min(i + dist(gen), sequence.size());
+    std::set<uint32_t> set(sequence.begin() + i, sequence.begin() + j);
+    sets.emplace_back(set.begin(), set.end());
+    i = j;
+  }
+
+  grammar::Chunks<> first_chunks, second_chunks;
+  for (std::size_t i = 0; i < sets.size(); ++i) {
+    auto &chunks = (i < sets.size() / 2) ? first_chunks : second_chunks;
+    chunks.Insert(sets[i].begin(), sets[i].end());
+  }
+
+  grammar::RePairEncoder<false> encoder;
+  grammar::GCChunks<grammar::SLP<>, true> gcchunks(
+      first_chunks.GetObjects().begin(), first_chunks.GetObjects().end(), first_chunks, encoder);
+  auto sigma = gcchunks.GetSLP().Sigma();
+
+  // Objects must be in the alphabet of the first chunks
+  grammar::Chunks<> new_chunks;
+  for (std::size_t i = 1; i <= second_chunks.size(); ++i) {
+    std::vector<uint32_t> set;
+    for (const auto &item : second_chunks[i]) {
+      if (item <= sigma) set.push_back(item);
+    }
+    new_chunks.Insert(set.begin(), set.end());
+  }
+
+  gcchunks.Append(new_chunks.GetObjects().begin(), new_chunks.GetObjects().end(), new_chunks, encoder);
+
+  ASSERT_EQ(gcchunks.size(), first_chunks.size() + new_chunks.size());
+  for (std::size_t i = 1; i <= first_chunks.size(); ++i) {
+    auto chunk = first_chunks[i];
+    EXPECT_EQ(gcchunks[i], std::vector<uint32_t>(chunk.begin(), chunk.end())) << i;
+  }
+  for (std::size_t i = 1; i <= new_chunks.size(); ++i) {
+    auto chunk = new_chunks[i];
+    EXPECT_EQ(gcchunks[first_chunks.size() + i], std::vector<uint32_t>(chunk.begin(), chunk.end())) << i;
+  }
+}
@@ -0,0 +1,179 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <fstream>
+#include <numeric>
+
+#include "grammar/leaf_marks.h"
+#include "grammar/sampled_slp.h"
+#include "grammar/slp.h"
+#include "grammar/slp_metadata.h"
+#include "grammar/re_pair.h"
+
+
+class SampledLeafMarks_TF : public ::testing::TestWithParam<std::tuple<std::size_t, double>> {
+ protected:
+  sdsl::bit_vector bv_;
+  std::vector<std::size_t> ranks_; // Number of ones in [0, i)
+  std::vector<std::size_t> ones_;
+
+  void SetUp() override {
+    auto n = std::get<0>(GetParam());
+    auto density = std::get<1>(GetParam());
+
+    std::mt19937 gen(n);
+    std::bernoulli_distribution dist(density);
+
+    bv_ = sdsl::bit_vector(n, 0);
+    ranks_.push_back(0);
+    for (std::size_t i = 0; i < n; ++i) {
+      bv_[i] = dist(gen);
+      if (bv_[i]) {
+        ones_.push_back(i);
+      }
+      ranks_.push_back(ones_.size());
+    }
+  }
+};
+
+
+TEST_P(SampledLeafMarks_TF, RankAndSelect) {
+  grammar::SampledLeafMarks<16> marks(bv_);
+  grammar::SampledLeafMarks<16>::rank_1_type rank(&marks);
+  grammar::SampledLeafMarks<16>::select_1_type select(&marks);
+
+  ASSERT_EQ(marks.size(), bv_.size());
+  for (std::size_t i = 0; i <= bv_.size(); ++i) {
+    EXPECT_EQ(rank(i), ranks_[i]) << i;
+  }
+  for (std::size_t i = 0; i < ones_.size(); ++i) {
+    EXPECT_EQ(select(i + 1), ones_[i]) << i;
+  }
+  for (std::size_t i = 0; i < bv_.size(); ++i) {
+    EXPECT_EQ(marks[i], bv_[i]) << i;
+  }
+}
+
+
+TEST_P(SampledLeafMarks_TF, BatchRank) {
+  grammar::SampledLeafMarks<> marks(bv_);
+  grammar::SampledLeafMarks<>::rank_1_type rank(&marks);
+
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<std::size_t> dist(0, bv_.size());
+  std::vector<std::size_t> positions(500);
+  for (auto &item : positions) {
+    item = dist(gen);
+  }
+
+  // Unsorted, sorted and clustered positions
+  auto check = [&]() {
+    std::vector<std::size_t> result;
+    rank.Batch(positions.begin(), positions.end(), back_inserter(result));
+
+    ASSERT_EQ(result.size(), positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      EXPECT_EQ(result[i], ranks_[positions[i]]) << positions[i];
+    }
+  };
+
+  check();
+
+  std::sort(positions.begin(), positions.end());
+  check();
+
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    positions[i] = std::min(positions[i / 10 * 10] + i % 10, bv_.size());
+  }
+  check();
+}
+
+
+TEST_P(SampledLeafMarks_TF, Serialization) {
+  grammar::SampledLeafMarks<> marks(bv_);
+  {
+    std::ofstream out("tmp.leaf_marks", std::ios::binary);
+    marks.serialize(out);
+  }
+
+  grammar::SampledLeafMarks<> marks_loaded;
+  {
+    std::ifstream in("tmp.leaf_marks", std::ios::binary);
+    marks_loaded.load(in);
+  }
+
+  ASSERT_EQ(marks_loaded.size(), marks.size());
+  EXPECT_TRUE(std::equal(marks.begin(), marks.end(), marks_loaded.begin()));
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    LeafMarks,
+    SampledLeafMarks_TF,
+    ::testing::Values(
+        std::make_tuple(0, 0.5),
+        std::make_tuple(1, 1.0),
+        std::make_tuple(64, 0.5),
+        std::make_tuple(1000, 0.02),
+        std::make_tuple(1000, 0.5),
+        std::make_tuple(1000, 1.0)
+    )
+);
+
+
+TEST(SampledLeafMarks, SampledSLPDropIn) {
+  std::mt19937 gen(23);
+  std::uniform_int_distribution<int> dist(1, 16);
+  std::vector<int> sequence(5000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp);
+
+  grammar::Chunks<> e_pts;
+  grammar::AddSet<grammar::Chunks<>> e_add_set(e_pts);
+  grammar::SampledSLP<> e_sslp(
+      slp, 8, e_add_set, e_add_set,
+      grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(e_pts, 2)));
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  grammar::SampledSLP<grammar::SampledLeafMarks<>> sslp(
+      slp, 8, add_set, add_set,
+      grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)));
+
+  std::vector<std::size_t> positions(sequence.size());
+  std::iota(positions.begin(), positions.end(), 0);
+
+  std::vector<std::size_t> e_leaves;
+  for (auto pos : positions) {
+    e_leaves.push_back(e_sslp.Leaf(pos));
+    EXPECT_EQ(sslp.Leaf(pos), e_leaves.back()) << pos;
+  }
+
+  std::vector<std::size_t> leaves;
+  sslp.Leaves(positions.begin(), positions.end(), back_inserter(leaves));
+  EXPECT_EQ(leaves, e_leaves);
+
+  std::vector<std::size_t> default_leaves;
+  e_sslp.Leaves(positions.begin(), positions.end(), back_inserter(default_leaves));
+  EXPECT_EQ(default_leaves, e_leaves);
+
+  std::vector<std::size_t> leaf_ids(e_leaves.back());
+  std::iota(leaf_ids.begin(), leaf_ids.end(), 1);
+  std::vector<std::size_t> e_positions, res_positions;
+  e_sslp.Positions(leaf_ids.begin(), leaf_ids.end(), back_inserter(e_positions));
+  sslp.Positions(leaf_ids.begin(), leaf_ids.end(), back_inserter(res_positions));
+  EXPECT_EQ(res_positions, e_positions);
+
+  for (std::size_t i = 0; i < leaf_ids.size(); ++i) {
+    EXPECT_EQ(e_sslp.Leaf(e_positions[i]), leaf_ids[i]);
+  }
+}
@@ -89,6 +89,45 @@ TEST_P(MergeSets_TF, MergeSetsOneByOneWithSetUnion) {
 }
 
 
+TEST_P(MergeSets_TF, MergeSetsKWay) {
+  const auto &sets = GetParam();
+
+  std::vector<uint32_t> set;
+  grammar::MergeSetsKWay(idx_sets.begin(), idx_sets.end(), sets, set);
+
+  EXPECT_EQ(set, e_set);
+}
+
+
+TEST_P(MergeSets_TF, MergeSetsKWayWithPreviousResult) {
+  const auto &sets = GetParam();
+
+  Set previous = {3, 7, 20};
+  std::vector<uint32_t> e_result;
+  std::set_union(e_set.begin(), e_set.end(), previous.begin(), previous.end(), back_inserter(e_result));
+
+  std::vector<uint32_t> set = previous;
+  grammar::MergeSetsKWay(idx_sets.begin(), idx_sets.end(), sets, set);
+
+  EXPECT_EQ(set, e_result);
+}
+
+
+TEST_P(MergeSets_TF, MergeRangesKWay) {
+  const auto &sets = GetParam();
+
+  std::vector<std::pair<Set::const_iterator, Set::const_iterator>> ranges;
+  for (const auto &item : sets) {
+    ranges.emplace_back(item.begin(), item.end());
+  }
+
+  std::vector<uint32_t> set;
+  grammar::MergeRangesKWay(ranges.begin(), ranges.end(), back_inserter(set));
+
+  EXPECT_EQ(set, e_set);
+}
+
+
 INSTANTIATE_TEST_CASE_P(
     MergeSets,
     MergeSets_TF,
@@ -98,6 +137,7 @@ INSTANTIATE_TEST_CASE_P(
         Sets{{7}, {1, 4, 7, 8}, {1, 2}, {2, 7}},
         Sets{{7}, {1, 4, 7, 8}, {1, 2}, {2, 7}, {1, 2}, {2, 7}},
         Sets{{7}, {1, 4, 7, 8}, {1, 2}, {2, 7}, {1, 2}, {2, 7}, {10}},
+        Sets{{}, {1, 4, 7, 8}, {}, {0, 2, 9}},
         Sets{}
     )
 );
\ No newline at end of file
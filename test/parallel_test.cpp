@@ -0,0 +1,112 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <numeric>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+
+#include "grammar/parallel.h"
+
+
+TEST(ParallelFor, RunsEachTaskOnce) {
+  for (std::size_t n_threads : {1, 2, 4, 16}) {
+    std::vector<int> counts(1000, 0);
+    grammar::ParallelFor(counts.size(), n_threads, [&counts](std::size_t i) { ++counts[i]; });
+
+    EXPECT_EQ(std::accumulate(counts.begin(), counts.end(), 0), counts.size()) << n_threads;
+    EXPECT_TRUE(std::all_of(counts.begin(), counts.end(), [](int c) { return c == 1; })) << n_threads;
+  }
+}
+
+
+TEST(ParallelFor, NoTasks) {
+  std::size_t n_calls = 0;
+  grammar::ParallelFor(0, 4, [&n_calls](std::size_t) { ++n_calls; });
+
+  EXPECT_EQ(n_calls, 0);
+}
+
+
+TEST(ParallelFor, RethrowsException) {
+  auto task = [](std::size_t i) {
+    if (i == 10)
+      throw std::runtime_error("task error");
+  };
+
+  EXPECT_THROW(grammar::ParallelFor(100, 4, task), std::runtime_error);
+}
+
+
+TEST(ThreadPool, RunsEachTaskOnce) {
+  for (std::size_t n_threads : {1, 2, 4}) {
+    grammar::ThreadPool pool(n_threads);
+    EXPECT_EQ(pool.Size(), n_threads);
+
+    // Several jobs on the same pool
+    for (std::size_t n : {0, 1, 7, 1000}) {
+      std::vector<int> counts(n, 0);
+      pool.ParallelFor(counts.size(), [&counts](std::size_t i) { ++counts[i]; });
+
+      EXPECT_TRUE(std::all_of(counts.begin(), counts.end(), [](int c) { return c == 1; })) << n_threads << " " << n;
+    }
+  }
+}
+
+
+TEST(ThreadPool, RethrowsException) {
+  grammar::ThreadPool pool(4);
+
+  auto task = [](std::size_t i) {
+    if (i == 10)
+      throw std::runtime_error("task error");
+  };
+  EXPECT_THROW(pool.ParallelFor(100, task), std::runtime_error);
+
+  // The pool is still usable
+  std::vector<int> counts(100, 0);
+  pool.ParallelFor(counts.size(), [&counts](std::size_t i) { ++counts[i]; });
+  EXPECT_TRUE(std::all_of(counts.begin(), counts.end(), [](int c) { return c == 1; }));
+}
+
+
+TEST(BoundedQueue, ProducerConsumer) {
+  grammar::BoundedQueue<std::vector<int>> queue(2);
+
+  std::thread producer([&queue]() {
+    for (int i = 0; i < 100; ++i) {
+      queue.Push(std::vector<int>(3, i));
+    }
+    queue.Close();
+  });
+
+  std::vector<int> consumed;
+  std::vector<int> block;
+  while (queue.Pop(block)) {
+    consumed.insert(consumed.end(), block.begin(), block.end());
+  }
+  producer.join();
+
+  ASSERT_EQ(consumed.size(), 300);
+  for (std::size_t i = 0; i < consumed.size(); ++i) {
+    EXPECT_EQ(consumed[i], i / 3) << i;
+  }
+}
+
+
+TEST(BoundedQueue, Close) {
+  grammar::BoundedQueue<int> queue(4);
+  EXPECT_TRUE(queue.Push(1));
+  queue.Close();
+
+  EXPECT_FALSE(queue.Push(2));
+
+  int item = 0;
+  EXPECT_TRUE(queue.Pop(item));
+  EXPECT_EQ(item, 1);
+  EXPECT_FALSE(queue.Pop(item));
+}
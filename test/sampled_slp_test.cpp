@@ -4,11 +4,14 @@
 
 #include <gtest/gtest.h>
 
+#include <random>
+
 #include <sdsl/sd_vector.hpp>
 
 #include "grammar/sampled_slp.h"
 #include "grammar/slp.h"
 #include "grammar/slp_metadata.h"
+#include "grammar/re_pair.h"
 
 
 using RightHand = std::pair<std::size_t, std::size_t>;
@@ -87,6 +90,26 @@ TEST_P(SampledSLPLeaves_TF, ComputeSampledSLPLeavesAndItsPTS) {
 }
 
 
+TEST_P(SampledSLPLeaves_TF, ComputeSampledSLPLeavesParallel) {
+  auto &block_size = std::get<2>(GetParam());
+
+  Nodes e_leaves;
+  grammar::Chunks<> e_spts;
+  grammar::AddSet<grammar::Chunks<>> e_add_set(e_spts);
+  grammar::ComputeSampledSLPLeaves(slp_, block_size, back_inserter(e_leaves), e_add_set);
+
+  for (std::size_t n_threads : {1, 2, 4}) {
+    Nodes leaves;
+    grammar::Chunks<> spts;
+    grammar::AddSet<grammar::Chunks<>> add_set(spts);
+    grammar::ComputeSampledSLPLeavesParallel(slp_, block_size, back_inserter(leaves), add_set, n_threads);
+
+    EXPECT_EQ(leaves, e_leaves) << n_threads;
+    EXPECT_EQ(spts, e_spts) << n_threads;
+  }
+}
+
+
 INSTANTIATE_TEST_CASE_P(
     SampledSLP,
     SampledSLPLeaves_TF,
@@ -166,6 +189,39 @@ TEST_P(SampledSLPNodes_TF, ComputeSampledSLPNodes) {
 }
 
 
+TEST_P(SampledSLPNodes_TF, ComputeSampledSLPNodesWithSamplingPredicate) {
+  auto block_size = std::get<2>(GetParam());
+  auto storing_factor = std::get<3>(GetParam());
+  const auto &e_nodes = std::get<4>(GetParam());;
+
+  {
+    Nodes nodes;
+    grammar::Chunks<> spts;
+    grammar::AddSet<grammar::Chunks<>> add_set(spts);
+    grammar::ComputeSampledSLPLeaves(slp_, block_size, back_inserter(nodes), add_set);
+
+    auto pred = grammar::BuildSamplingPredicate(grammar::ChildrenSetSource<grammar::Chunks<>>(spts),
+                                                grammar::AreChildrenTooBig<grammar::Chunks<>>(spts, storing_factor));
+    grammar::ComputeSampledSLPNodes(slp_, block_size, nodes, pred, add_set);
+
+    EXPECT_EQ(nodes, e_nodes);
+  }
+
+  {
+    Nodes nodes;
+    grammar::Chunks<> spts;
+    grammar::AddSet<grammar::Chunks<>> add_set(spts);
+    grammar::ComputeSampledSLPLeaves(slp_, block_size, back_inserter(nodes), add_set);
+
+    auto pred = grammar::BuildSamplingPredicate(grammar::SpanSetSource<>(),
+                                                grammar::AreChildrenTooBig<grammar::Chunks<>>(spts, storing_factor));
+    grammar::ComputeSampledSLPNodes(slp_, block_size, nodes, pred, add_set);
+
+    EXPECT_EQ(nodes, e_nodes);
+  }
+}
+
+
 INSTANTIATE_TEST_CASE_P(
     SampledSLP,
     SampledSLPNodes_TF,
@@ -369,6 +425,120 @@ TEST_P(SampledSLPParent_TF, CombinedSLPFirstChildAndParent) {
 }
 
 
+TEST_P(SampledSLPParent_TF, ParallelConstruction) {
+  auto block_size = std::get<2>(GetParam());
+  auto storing_factor = std::get<3>(GetParam());
+
+  grammar::Chunks<> e_pts;
+  grammar::AddSet<grammar::Chunks<>> e_add_set(e_pts);
+  grammar::SampledSLP<>
+      e_sslp(slp_, block_size, e_add_set, e_add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(e_pts, storing_factor)));
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  grammar::SampledSLP<>
+      sslp(slp_, block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, storing_factor)), 4);
+
+  EXPECT_EQ(sslp, e_sslp);
+  EXPECT_EQ(pts, e_pts);
+}
+
+
+TEST_P(SampledSLPParent_TF, FlatParents) {
+  auto block_size = std::get<2>(GetParam());
+  auto storing_factor = std::get<3>(GetParam());
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  grammar::SampledSLP<>
+      sslp(slp_, block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, storing_factor)));
+
+  grammar::Chunks<> f_pts;
+  grammar::AddSet<grammar::Chunks<>> f_add_set(f_pts);
+  grammar::FlatParentsSampledSLP<>
+      f_sslp(slp_, block_size, f_add_set, f_add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(f_pts, storing_factor)));
+
+  grammar::Chunks<> v_pts;
+  grammar::AddSet<grammar::Chunks<>> v_add_set(v_pts);
+  grammar::FlatParentsSampledSLP<grammar::SampledSLP<>, std::vector<uint32_t>>
+      v_sslp(slp_, block_size, v_add_set, v_add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(v_pts, storing_factor)));
+
+  // There is a set for each node
+  for (std::size_t i = 1; i <= pts.size(); ++i) {
+    ASSERT_EQ(f_sslp.IsFirstChild(i), sslp.IsFirstChild(i)) << i;
+    ASSERT_EQ(v_sslp.IsFirstChild(i), sslp.IsFirstChild(i)) << i;
+    if (sslp.IsFirstChild(i)) {
+      EXPECT_EQ(f_sslp.Parent(i), sslp.Parent(i)) << i;
+      EXPECT_EQ(v_sslp.Parent(i), sslp.Parent(i)) << i;
+    }
+  }
+}
+
+
+TEST_P(SampledSLPParent_TF, FlatParentsSerialization) {
+  auto block_size = std::get<2>(GetParam());
+  auto storing_factor = std::get<3>(GetParam());
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  grammar::FlatParentsSampledSLP<>
+      sslp(slp_, block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, storing_factor)));
+  {
+    std::ofstream out("tmp.sampled_slp", std::ios::binary);
+    sslp.serialize(out);
+  }
+
+  grammar::FlatParentsSampledSLP<> sslp_loaded;
+  EXPECT_FALSE(sslp == sslp_loaded);
+
+  {
+    std::ifstream in("tmp.sampled_slp", std::ios::binary);
+    sslp_loaded.load(in);
+  }
+  EXPECT_TRUE(sslp == sslp_loaded);
+
+  for (std::size_t i = 1; i <= pts.size(); ++i) {
+    ASSERT_EQ(sslp_loaded.IsFirstChild(i), sslp.IsFirstChild(i)) << i;
+    if (sslp.IsFirstChild(i)) {
+      EXPECT_EQ(sslp_loaded.Parent(i), sslp.Parent(i)) << i;
+    }
+  }
+}
+
+
+/**
+ * Flat parents sampled SLP whose flat parents can be reset, keeping the underlying sampled SLP
+ */
+class ResettableFlatParentsSampledSLP : public grammar::FlatParentsSampledSLP<> {
+ public:
+  using grammar::FlatParentsSampledSLP<>::FlatParentsSampledSLP;
+
+  void ResetFlatParents() {
+    fp_ = sdsl::int_vector<>(fp_.size(), 0);
+    fn_ = sdsl::int_vector<>(fn_.size(), 0);
+  }
+};
+
+
+TEST_P(SampledSLPParent_TF, FlatParentsEquality) {
+  auto block_size = std::get<2>(GetParam());
+  auto storing_factor = std::get<3>(GetParam());
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  ResettableFlatParentsSampledSLP
+      sslp(slp_, block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, storing_factor)));
+
+  auto copy = sslp;
+  EXPECT_TRUE(sslp == copy);
+
+  // The flat parents are compared too, not only the underlying sampled SLP
+  copy.ResetFlatParents();
+  EXPECT_TRUE(static_cast<const grammar::SampledSLP<> &>(sslp) == copy);
+  EXPECT_FALSE(sslp == copy);
+}
+
+
 TEST_P(SampledSLPParent_TF, Serialization) {
   auto block_size = std::get<2>(GetParam());
   auto storing_factor = std::get<3>(GetParam());
@@ -480,6 +650,25 @@ TEST_P(SLPSpanCoverFromBottom_TF, SpanCover) {
 }
 
 
+TEST_P(SLPSpanCoverFromBottom_TF, SpanCoverFlatParents) {
+  auto block_size = std::get<2>(GetParam());
+  auto storing_factor = std::get<3>(GetParam());
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  grammar::FlatParentsSampledSLP<>
+      sslp(slp_, block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, storing_factor)));
+
+  auto &span = std::get<4>(GetParam());
+
+  SpanCover result;
+  result.second = grammar::ComputeSpanCoverFromBottom(sslp, span.first, span.second, back_inserter(result.first));
+
+  auto &eresult = std::get<5>(GetParam());
+  EXPECT_EQ(result, eresult);
+}
+
+
 INSTANTIATE_TEST_CASE_P(
     SLP,
     SLPSpanCoverFromBottom_TF,
@@ -598,6 +787,32 @@ TEST_P(ComputePartitionCover_TF, compute) {
 }
 
 
+TEST_P(ComputePartitionCover_TF, computeParallel) {
+  auto &cseq = std::get<2>(GetParam());
+  auto &lengths = std::get<3>(GetParam());
+  Sequence partition_id;
+  for (int i = 0; i < lengths.size(); ++i) {
+    partition_id.push_back(i);
+  }
+
+  auto get_length = [&lengths](const auto &i) -> auto {
+    return lengths[i];
+  };
+
+  auto &e_result = std::get<4>(GetParam());
+  for (std::size_t n_threads : {1, 2, 3, 8}) {
+    Partition result;
+    auto action = [&result](auto &_seq) {
+      result.emplace_back(_seq.begin(), _seq.end());
+    };
+
+    grammar::ComputePartitionCover(slp_, cseq, partition_id, get_length, action, 0, n_threads);
+
+    EXPECT_EQ(result, e_result) << n_threads;
+  }
+}
+
+
 INSTANTIATE_TEST_CASE_P(
     SLP,
     ComputePartitionCover_TF,
@@ -624,4 +839,237 @@ INSTANTIATE_TEST_CASE_P(
             Partition{{4, 3}, {5}, {6}, {3, 3}, {6}, {2, 5, 1}}
         )
     )
-);
\ No newline at end of file
+);
+
+
+TEST(SampledSLP, ParallelConstructionRandomSequence) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(1, 16);
+  std::vector<int> sequence(5000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp);
+
+  for (uint32_t block_size : {4, 16, 64}) {
+    grammar::CombinedSLP<> e_cslp(slp);
+    grammar::Chunks<> e_pts;
+    {
+      grammar::AddSet<grammar::Chunks<>> add_set(e_pts);
+      e_cslp.Compute(block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(e_pts, 2)));
+    }
+
+    for (std::size_t n_threads : {2, 3, 8}) {
+      grammar::CombinedSLP<> cslp(slp);
+      grammar::Chunks<> pts;
+      {
+        grammar::AddSet<grammar::Chunks<>> add_set(pts);
+        cslp.Compute(block_size, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)), n_threads);
+      }
+
+      EXPECT_EQ(cslp, e_cslp) << block_size << " " << n_threads;
+      EXPECT_EQ(pts, e_pts) << block_size << " " << n_threads;
+    }
+  }
+}
+
+
+TEST(SampledSLP, SamplingPredicateRandomSequence) {
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int> dist(1, 32);
+  std::vector<int> sequence(5000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp);
+
+  for (uint32_t block_size : {4, 16, 64}) {
+    grammar::Chunks<> e_pts;
+    grammar::AddSet<grammar::Chunks<>> e_add_set(e_pts);
+    grammar::SampledSLP<> e_sslp(
+        slp, block_size, e_add_set, e_add_set,
+        grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(e_pts, 1.5),
+                                                  grammar::IsEqual<grammar::Chunks<>>(e_pts, 4)));
+
+    grammar::Chunks<> pts;
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    grammar::SampledSLP<> sslp(
+        slp, block_size, add_set, add_set,
+        grammar::BuildSamplingPredicate(grammar::ChildrenSetSource<grammar::Chunks<>>(pts),
+                                        grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 1.5),
+                                        grammar::IsEqual<grammar::Chunks<>>(pts, 4)));
+
+    EXPECT_EQ(sslp, e_sslp) << block_size;
+    EXPECT_EQ(pts, e_pts) << block_size;
+  }
+}
+
+
+TEST(ComputePartitionCover, ParallelRandomSequence) {
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> dist(1, 8);
+  std::vector<int> sequence(20000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  std::vector<std::size_t> cseq;
+  {
+    grammar::RePairEncoder<false> encoder;
+    auto wrapper = grammar::BuildSLPWrapper(slp);
+    auto report_cseq = [&cseq](auto v) {
+      cseq.emplace_back(v);
+    };
+    encoder.Encode(sequence.begin(), sequence.end(), wrapper, report_cseq);
+  }
+
+  std::uniform_int_distribution<std::size_t> length_dist(1, 40);
+  Sequence lengths;
+  for (std::size_t total = 0; total < sequence.size();) {
+    auto length = std::min(length_dist(gen), sequence.size() - total);
+    lengths.push_back(length);
+    total += length;
+  }
+
+  auto get_length = [](const auto &_length) -> auto {
+    return _length;
+  };
+
+  Partition e_result;
+  grammar::ComputePartitionCover(slp, cseq, lengths, get_length,
+                                 [&e_result](auto &_seq) { e_result.emplace_back(_seq.begin(), _seq.end()); }, 0);
+
+  for (std::size_t n_threads : {2, 3, 8}) {
+    Partition result;
+    grammar::ComputePartitionCover(slp, cseq, lengths, get_length,
+                                   [&result](auto &_seq) { result.emplace_back(_seq.begin(), _seq.end()); }, 0,
+                                   n_threads);
+
+    EXPECT_EQ(result, e_result) << n_threads;
+  }
+}
+
+
+TEST(LightSLP, ParallelCompute) {
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> dist(1, 16);
+  std::vector<int> sequence(5000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp);
+
+  grammar::CombinedSLP<> cslp(slp);
+  grammar::Chunks<> pts;
+  {
+    grammar::AddSet<grammar::Chunks<>> add_set(pts);
+    cslp.Compute(16, add_set, add_set, grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2)));
+  }
+
+  grammar::LightSLP<> e_lslp;
+  e_lslp.Compute(sequence.begin(), sequence.end(), grammar::RePairEncoder<false>(), cslp);
+
+  for (std::size_t n_threads : {2, 3, 8}) {
+    grammar::LightSLP<> lslp;
+    lslp.Compute(sequence.begin(), sequence.end(), grammar::RePairEncoder<false>(), cslp, n_threads);
+
+    EXPECT_TRUE(lslp == e_lslp) << n_threads;
+  }
+}
+
+
+TEST(FlatParentsSampledSLP, CoverFromBottomRandomSequence) {
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<int> dist(1, 16);
+  std::vector<int> sequence(5000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp);
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  auto pred = grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2));
+  grammar::SampledSLP<> sslp(slp, 8, add_set, add_set, pred);
+
+  grammar::Chunks<> f_pts;
+  grammar::AddSet<grammar::Chunks<>> f_add_set(f_pts);
+  auto f_pred = grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(f_pts, 2));
+  grammar::FlatParentsSampledSLP<grammar::SampledSLP<>, std::vector<uint32_t>> f_sslp(slp, 8, f_add_set, f_add_set, f_pred);
+
+  std::uniform_int_distribution<std::size_t> pos_dist(0, sequence.size());
+  for (int k = 0; k < 1000; ++k) {
+    auto bp = pos_dist(gen), ep = pos_dist(gen);
+    if (ep < bp) std::swap(bp, ep);
+
+    std::vector<std::size_t> e_cover, cover;
+    auto e_range = grammar::ComputeCoverFromBottom(sslp, bp, ep, [&e_cover](auto _node) { e_cover.push_back(_node); });
+    auto range = grammar::ComputeCoverFromBottom(f_sslp, bp, ep, [&cover](auto _node) { cover.push_back(_node); });
+
+    EXPECT_EQ(range, e_range) << bp << " " << ep;
+    EXPECT_EQ(cover, e_cover) << bp << " " << ep;
+  }
+}
+
+
+TEST(ComputeCoverBottomFunctor, Batch) {
+  std::mt19937 gen(19);
+  std::uniform_int_distribution<int> dist(1, 16);
+  std::vector<int> sequence(5000);
+  for (auto &item : sequence) {
+    item = dist(gen);
+  }
+
+  grammar::SLP<> slp(0);
+  grammar::RePairEncoder<true> encoder;
+  grammar::ConstructSLP(sequence.begin(), sequence.end(), encoder, slp);
+
+  grammar::Chunks<> pts;
+  grammar::AddSet<grammar::Chunks<>> add_set(pts);
+  auto pred = grammar::MustBeSampled<grammar::Chunks<>>(grammar::AreChildrenTooBig<grammar::Chunks<>>(pts, 2));
+  grammar::SampledSLP<> sslp(slp, 8, add_set, add_set, pred);
+
+  std::uniform_int_distribution<std::size_t> pos_dist(0, sequence.size());
+  std::vector<std::pair<std::size_t, std::size_t>> intervals(2000);
+  for (auto &interval : intervals) {
+    interval = std::minmax(pos_dist(gen), pos_dist(gen));
+  }
+
+  auto functor = grammar::BuildComputeCoverBottomFunctor(sslp);
+
+  auto check = [&](const grammar::CoverArena &_arena) {
+    ASSERT_EQ(_arena.size(), intervals.size());
+    for (std::size_t i = 0; i < intervals.size(); ++i) {
+      auto e_cover = functor(intervals[i].first, intervals[i].second);
+      auto cover = _arena.Cover(i);
+      EXPECT_EQ(_arena.GetRange(i), e_cover.first) << i;
+      EXPECT_EQ(std::vector<std::size_t>(cover.begin(), cover.end()), e_cover.second) << i;
+    }
+  };
+
+  grammar::CoverArena arena;
+  functor.Compute(intervals.begin(), intervals.end(), arena);
+  check(arena);
+
+  for (std::size_t n_threads : {1, 2, 4}) {
+    grammar::ThreadPool pool(n_threads);
+    for (int k = 0; k < 2; ++k) {
+      arena.Clear();
+      functor.Compute(intervals.begin(), intervals.end(), arena, pool);
+      check(arena);
+    }
+  }
+}
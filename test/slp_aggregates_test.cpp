@@ -0,0 +1,132 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <fstream>
+
+#include "grammar/slp_aggregates.h"
+#include "grammar/slp.h"
+#include "grammar/slp_helper.h"
+#include "grammar/re_pair.h"
+
+
+class SLPAggregates_TF : public ::testing::TestWithParam<std::tuple<std::size_t, int>> {
+ protected:
+  std::vector<int> sequence_;
+  grammar::SLP<> slp_; // Single start symbol
+  grammar::SLP<> forest_slp_;
+  std::vector<std::size_t> roots_;
+  std::vector<std::pair<std::size_t, std::size_t>> ranges_;
+
+  void SetUp() override {
+    auto n = std::get<0>(GetParam());
+    auto sigma = std::get<1>(GetParam());
+
+    std::mt19937 gen(n);
+    std::uniform_int_distribution<int> dist(1, sigma);
+    sequence_.resize(n);
+    for (auto &item : sequence_) {
+      item = dist(gen);
+    }
+
+    grammar::RePairEncoder<true> encoder;
+    grammar::ConstructSLP(sequence_.begin(), sequence_.end(), encoder, slp_);
+
+    grammar::RePairEncoder<false> forest_encoder;
+    auto wrapper = grammar::BuildSLPWrapper(forest_slp_);
+    auto report_cseq = [this](auto _var) { roots_.emplace_back(_var); };
+    forest_encoder.Encode(sequence_.begin(), sequence_.end(), wrapper, report_cseq);
+
+    std::uniform_int_distribution<std::size_t> pos_dist(0, n);
+    for (int i = 0; i < 300; ++i) {
+      auto bp = pos_dist(gen), ep = pos_dist(gen);
+      ranges_.emplace_back(std::min(bp, ep), std::max(bp, ep));
+    }
+    ranges_.emplace_back(0, n);
+    ranges_.emplace_back(0, 0);
+    ranges_.emplace_back(n - 1, n);
+  }
+
+  template<typename _Monoid, typename _Lift>
+  void Check(const _Lift &_lift) {
+    grammar::SLPAggregates<_Monoid> aggregates(slp_, _lift);
+    grammar::SLPAggregates<_Monoid> forest_aggregates(forest_slp_, _lift);
+    auto roots_offsets = grammar::ComputeRootsOffsets(forest_slp_, roots_);
+
+    for (const auto &range : ranges_) {
+      auto e_value = _Monoid::Identity();
+      for (auto i = range.first; i < range.second; ++i) {
+        e_value = _Monoid::Combine(e_value, _lift(sequence_[i]));
+      }
+
+      EXPECT_TRUE(grammar::RangeAggregate(slp_, aggregates, range.first, range.second) == e_value)
+                << range.first << " " << range.second;
+      EXPECT_TRUE(grammar::RangeAggregate(forest_slp_, forest_aggregates, roots_, range.first, range.second) == e_value)
+                << range.first << " " << range.second;
+      EXPECT_TRUE(grammar::RangeAggregate(forest_slp_, forest_aggregates, roots_, roots_offsets, range.first,
+                                          range.second) == e_value)
+                << range.first << " " << range.second;
+    }
+  }
+};
+
+
+TEST_P(SLPAggregates_TF, Sum) {
+  Check<grammar::SumMonoid<>>([](std::size_t _terminal) -> int64_t { return int64_t(_terminal) - 5; });
+}
+
+
+TEST_P(SLPAggregates_TF, MinMax) {
+  auto lift = [](std::size_t _terminal) -> int64_t { return _terminal * 7 % 11; };
+  Check<grammar::MinMonoid<>>(lift);
+  Check<grammar::MaxMonoid<>>(lift);
+}
+
+
+TEST_P(SLPAggregates_TF, Xor) {
+  Check<grammar::XorMonoid<>>([](std::size_t _terminal) -> uint64_t { return _terminal * 0x9e3779b97f4a7c15ULL; });
+}
+
+
+TEST_P(SLPAggregates_TF, Count) {
+  Check<grammar::CountMonoid<>>(grammar::BuildCountLift([](std::size_t _terminal) { return _terminal % 3 == 0; }));
+}
+
+
+TEST_P(SLPAggregates_TF, PrefixExtrema) {
+  Check<grammar::PrefixExtremaMonoid<>>([](std::size_t _terminal) {
+    return grammar::PrefixExtremaMonoid<>::Lift(int64_t(_terminal) - 4);
+  });
+}
+
+
+TEST_P(SLPAggregates_TF, Serialization) {
+  grammar::SLPAggregates<grammar::SumMonoid<>> aggregates(slp_, [](std::size_t _terminal) { return _terminal; });
+  {
+    std::ofstream out("tmp.slp_aggregates", std::ios::binary);
+    aggregates.serialize(out);
+  }
+
+  grammar::SLPAggregates<grammar::SumMonoid<>> aggregates_loaded;
+  EXPECT_FALSE(aggregates == aggregates_loaded);
+  {
+    std::ifstream in("tmp.slp_aggregates", std::ios::binary);
+    aggregates_loaded.load(in);
+  }
+  EXPECT_TRUE(aggregates == aggregates_loaded);
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    SLPAggregates,
+    SLPAggregates_TF,
+    ::testing::Values(
+        std::make_tuple(1, 4),
+        std::make_tuple(100, 4),
+        std::make_tuple(3000, 8),
+        std::make_tuple(10000, 64)
+    )
+);
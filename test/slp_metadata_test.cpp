@@ -4,11 +4,15 @@
 
 #include <gtest/gtest.h>
 
+#include <random>
+#include <numeric>
+
 #include <sdsl/vectors.hpp>
 
 #include "grammar/slp.h"
 #include "grammar/slp_metadata.h"
 #include "grammar/re_pair.h"
+#include "grammar/parallel.h"
 
 
 using RightHand = std::pair<uint32_t, uint32_t>;
@@ -79,6 +83,45 @@ TEST_P(SLPMD_TF, SampledPTSConstructor) {
 }
 
 
+TEST_P(SLPMD_TF, SampledPTSQueryContext) {
+  grammar::SampledPTS<grammar::SLP<>> pts(&slp_, 2, 1);
+
+  decltype(pts)::QueryContext context;
+  std::vector<uint32_t> result;
+  for (int k = 0; k < 3; ++k) {
+    for (auto i = 1u; i <= slp_.Variables(); ++i) {
+      auto span = slp_.Span(i);
+      sort(span.begin(), span.end());
+      span.erase(unique(span.begin(), span.end()), span.end());
+
+      result.clear();
+      pts.GetSet(i, context, back_inserter(result));
+      EXPECT_EQ(result, span) << i;
+      EXPECT_EQ(pts[i], span) << i;
+    }
+  }
+}
+
+
+TEST_P(SLPMD_TF, SampledPTSConcurrentQueries) {
+  grammar::SampledPTS<grammar::SLP<>> pts(&slp_, 2, 1);
+
+  const std::size_t n_queries = 64 * slp_.Variables();
+  std::vector<std::vector<uint32_t>> results(n_queries);
+  grammar::ParallelFor(n_queries, 8, [&pts, &results, this](std::size_t k) {
+    results[k] = pts[k % slp_.Variables() + 1];
+  });
+
+  for (std::size_t k = 0; k < n_queries; ++k) {
+    auto i = k % slp_.Variables() + 1;
+    auto span = slp_.Span(i);
+    sort(span.begin(), span.end());
+    span.erase(unique(span.begin(), span.end()), span.end());
+
+    EXPECT_EQ(results[k], span) << i;
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(
     SLPMetadata,
     SLPMD_TF,
@@ -217,6 +260,74 @@ TEST_P(Chunks_TF, CopyConstructor) {
 }
 
 
+TEST_P(Chunks_TF, BulkDecode) {
+  const auto &sets = std::get<0>(GetParam());
+
+  grammar::Chunks<> chunks;
+  for (const auto &item : sets) {
+    chunks.Insert(item.begin(), item.end());
+  }
+
+  auto bit_compress = [](sdsl::int_vector<> &_v) { sdsl::util::bit_compress(_v); };
+  grammar::Chunks<sdsl::int_vector<>, sdsl::int_vector<>> compact_chunks(chunks, bit_compress, bit_compress);
+
+  std::vector<uint32_t> buffer;
+  for (int i = 0; i < sets.size(); ++i) {
+    ASSERT_EQ(chunks.ChunkLength(i + 1), sets[i].size());
+    buffer.assign(sets[i].size(), 0);
+    EXPECT_EQ(chunks.Decode(i + 1, buffer.data()), buffer.data() + buffer.size());
+    EXPECT_EQ(buffer, sets[i]);
+
+    ASSERT_EQ(compact_chunks.ChunkLength(i + 1), sets[i].size());
+    buffer.assign(sets[i].size(), 0);
+    EXPECT_EQ(compact_chunks.Decode(i + 1, buffer.data()), buffer.data() + buffer.size());
+    EXPECT_EQ(buffer, sets[i]);
+  }
+
+  std::vector<uint32_t> ids(sets.size());
+  std::iota(ids.rbegin(), ids.rend(), 1);
+  grammar::SetsBuffer<> sets_buffer;
+  sets_buffer.Decode(ids.begin(), ids.end(), compact_chunks);
+  ASSERT_EQ(sets_buffer.size(), sets.size());
+  for (int k = 0; k < ids.size(); ++k) {
+    const auto &e_set = sets[ids[k] - 1];
+    auto set = sets_buffer[k];
+    ASSERT_EQ(set.size(), e_set.size());
+    EXPECT_TRUE(std::equal(set.begin(), set.end(), e_set.begin()));
+  }
+}
+
+
+TEST(Chunks, BulkDecodeBitCompressedWords) {
+  std::mt19937 gen(7);
+
+  for (uint32_t max_value : {1u, 6u, 255u, 1000u, 1u << 20, 0xFFFFFFFFu}) {
+    std::uniform_int_distribution<uint32_t> dist(0, max_value);
+
+    grammar::Chunks<> chunks;
+    Sets sets;
+    for (int i = 0; i < 20; ++i) {
+      std::vector<uint32_t> set(i * 7 + 1);
+      for (auto &item : set) {
+        item = dist(gen);
+      }
+      std::sort(set.begin(), set.end());
+      chunks.Insert(set.begin(), set.end());
+      sets.emplace_back(set);
+    }
+
+    auto bit_compress = [](sdsl::int_vector<> &_v) { sdsl::util::bit_compress(_v); };
+    grammar::Chunks<sdsl::int_vector<>, sdsl::int_vector<>> compact_chunks(chunks, bit_compress, bit_compress);
+
+    for (int i = 0; i < sets.size(); ++i) {
+      std::vector<uint32_t> buffer(compact_chunks.ChunkLength(i + 1));
+      compact_chunks.Decode(i + 1, buffer.data());
+      EXPECT_EQ(buffer, sets[i]) << max_value << " " << i;
+    }
+  }
+}
+
+
 TEST_P(Chunks_TF, Serialization) {
   const auto &sets = std::get<0>(GetParam());
 
@@ -289,6 +400,27 @@ TEST_P(Chunks_TF, GrammarCompressedChunkExpand) {
 }
 
 
+TEST_P(Chunks_TF, GrammarCompressedChunkParallel) {
+  const auto &sets = std::get<0>(GetParam());
+
+  grammar::Chunks<> chunks;
+  for (const auto &item : sets) {
+    chunks.Insert(item.begin(), item.end());
+  }
+
+  grammar::RePairEncoder<false> encoder;
+  grammar::GCChunks<grammar::SLP<>, false> e_gcchunks(
+      chunks.GetObjects().begin(), chunks.GetObjects().end(), chunks, encoder);
+
+  for (std::size_t n_threads : {2, 3, 8}) {
+    grammar::GCChunks<grammar::SLP<>, false> gcchunks(
+        chunks.GetObjects().begin(), chunks.GetObjects().end(), chunks, encoder, n_threads);
+
+    EXPECT_TRUE(gcchunks == e_gcchunks) << n_threads;
+  }
+}
+
+
 TEST_P(Chunks_TF, GrammarCompressedChunkSerialization) {
   const auto &sets = std::get<0>(GetParam());
 
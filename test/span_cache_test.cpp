@@ -0,0 +1,156 @@
+//
+// Created by agent <agent@local> on 10/18/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "grammar/span_cache.h"
+#include "grammar/slp.h"
+#include "grammar/slp_metadata.h"
+#include "grammar/re_pair.h"
+
+
+using Set = std::vector<uint32_t>;
+using Sets = std::vector<Set>;
+
+
+TEST(SpanCache, HitsAndMisses) {
+  grammar::SpanCache<> cache(1 << 20, 4);
+
+  std::size_t n_computed = 0;
+  auto compute = [&n_computed](std::size_t _var, auto &_set) {
+    ++n_computed;
+    _set.assign(_var, _var);
+  };
+
+  for (int k = 0; k < 3; ++k) {
+    for (std::size_t i = 1; i <= 10; ++i) {
+      auto set = cache.Get(i, compute);
+      EXPECT_EQ(*set, Set(i, i));
+    }
+  }
+
+  EXPECT_EQ(n_computed, 10);
+  EXPECT_EQ(cache.Misses(), 10);
+  EXPECT_EQ(cache.Hits(), 20);
+
+  cache.Clear();
+  EXPECT_EQ(cache.Size(), 0);
+  EXPECT_EQ(cache.Hits(), 0);
+  EXPECT_EQ(cache.Misses(), 0);
+}
+
+
+TEST(SpanCache, Budget) {
+  const std::size_t budget = 2048;
+  grammar::SpanCache<> cache(budget, 1);
+
+  auto compute = [](std::size_t _var, auto &_set) {
+    _set.assign(32, _var);
+  };
+
+  for (std::size_t i = 1; i <= 100; ++i) {
+    auto set = cache.Get(i, compute);
+    EXPECT_EQ(*set, Set(32, i));
+    EXPECT_LE(cache.Size(), budget);
+  }
+
+  // Sets bigger than the budget are never stored
+  auto compute_big = [](std::size_t _var, auto &_set) {
+    _set.assign(budget, _var);
+  };
+  auto big = cache.Get(1000, compute_big);
+  EXPECT_EQ(big->size(), budget);
+  EXPECT_LE(cache.Size(), budget);
+}
+
+
+TEST(SpanCache, SharedAcrossThreads) {
+  grammar::SpanCache<> cache(1 << 16);
+
+  auto compute = [](std::size_t _var, auto &_set) {
+    _set.assign(_var % 17 + 1, _var);
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, &compute]() {
+      for (std::size_t i = 0; i < 2000; ++i) {
+        auto var = i % 300;
+        auto set = cache.Get(var, compute);
+        ASSERT_EQ(*set, Set(var % 17 + 1, var));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(cache.Hits() + cache.Misses(), 4 * 2000);
+}
+
+
+class CachedGCChunks_TF : public ::testing::TestWithParam<Sets> {};
+
+
+TEST_P(CachedGCChunks_TF, Expand) {
+  const auto &sets = GetParam();
+
+  grammar::Chunks<> chunks;
+  for (const auto &item : sets) {
+    chunks.Insert(item.begin(), item.end());
+  }
+
+  grammar::RePairEncoder<false> encoder;
+  grammar::GCChunks<grammar::SLP<>> gcchunks(chunks.GetObjects().begin(), chunks.GetObjects().end(), chunks, encoder);
+
+  grammar::SpanCache<> cache(1 << 12);
+  auto cached_gcchunks = grammar::BuildCachedGCChunks(gcchunks, cache);
+  ASSERT_EQ(cached_gcchunks.size(), sets.size());
+
+  for (int k = 0; k < 2; ++k) {
+    for (int i = 0; i < sets.size(); ++i) {
+      EXPECT_EQ(cached_gcchunks[i + 1], sets[i]) << i;
+    }
+  }
+}
+
+
+TEST_P(CachedGCChunks_TF, TVSpans) {
+  const auto &sets = GetParam();
+
+  grammar::Chunks<> chunks;
+  for (const auto &item : sets) {
+    chunks.Insert(item.begin(), item.end());
+  }
+
+  grammar::RePairEncoder<false> encoder;
+  grammar::GCChunksTV<grammar::SLP<>>
+      gcchunkstv(chunks.GetObjects().begin(), chunks.GetObjects().end(), chunks, encoder);
+
+  grammar::SpanCache<> cache(1 << 12);
+  auto spans = grammar::BuildCachedSpans(gcchunkstv.GetSLP(), cache);
+
+  for (int i = 0; i < sets.size(); ++i) {
+    const auto &vs = gcchunkstv.GetVariableSet(i + 1);
+    for (auto it = vs.begin(); it != vs.end(); ++it) {
+      auto span = spans[*it];
+      auto e_span = gcchunkstv.GetSLP().Span(*it);
+      ASSERT_EQ(span.size(), e_span.size());
+      EXPECT_TRUE(std::equal(span.begin(), span.end(), e_span.begin()));
+    }
+  }
+}
+
+
+INSTANTIATE_TEST_CASE_P(
+    SpanCache,
+    CachedGCChunks_TF,
+    ::testing::Values(
+        Sets{{1, 2, 3, 4}, {1, 2, 3}, {3}, {1, 2, 3}, {1, 2}},
+        Sets{{1, 2}, {3, 4}, {1, 2, 3}, {3}, {1, 2, 3}, {1, 2}},
+        Sets{{1, 2, 3, 4}, {1, 2, 3}, {3}, {1, 2}, {1}, {2, 4}}
+    )
+);
@@ -0,0 +1,259 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <gflags/gflags.h>
+
+#include <sdsl/config.hpp>
+#include <sdsl/util.hpp>
+
+#include <grammar/slp.h>
+#include <grammar/re_pair.h>
+#include <grammar/slp_helper.h>
+#include <grammar/parallel.h>
+#include <grammar/differential_slp.h>
+
+#include "definitions.h"
+
+DEFINE_string(data, "", "Data file. (MANDATORY)");
+DEFINE_string(max_sizes, "64", "Maximum sizes of sampled intervals (comma-separated).");
+DEFINE_uint64(block_size, 1 << 16, "Number of rules per block read.");
+DEFINE_uint64(buffer_size, 1 << 20, "Size (in bytes) of the output buffers.");
+DEFINE_uint64(threads, 1, "Number of threads to compute the span sums.");
+
+using Clock = std::chrono::steady_clock;
+
+double Elapsed(Clock::time_point _start) {
+  return std::chrono::duration<double>(Clock::now() - _start).count();
+}
+
+/**
+ * Store an object into the cache with a buffered output stream
+ */
+template<typename T>
+void StoreToCache(const T &_v, const std::string &_key, sdsl::cache_config &_config, std::vector<char> &_buffer) {
+  auto file_name = sdsl::cache_file_name(_key, _config);
+
+  std::ofstream out;
+  out.rdbuf()->pubsetbuf(_buffer.data(), _buffer.size());
+  out.open(file_name, std::ios::binary | std::ios::trunc);
+  sdsl::serialize(_v, out);
+
+  _config.file_map[_key] = file_name;
+}
+
+/**
+ * Rules read from the RePair files
+ */
+struct RulesBlock {
+  std::vector<std::pair<int, int>> rules;
+};
+
+/**
+ * Close the queue and join the reader thread when leaving the scope, so that an exception in the consumer neither
+ * blocks the reader in Push nor destroys a joinable thread
+ */
+class ReaderGuard {
+ public:
+  ReaderGuard(grammar::BoundedQueue<RulesBlock> &_queue, std::thread &_reader) : queue_(_queue), reader_(_reader) {}
+
+  ReaderGuard(const ReaderGuard &) = delete;
+
+  ReaderGuard &operator=(const ReaderGuard &) = delete;
+
+  ~ReaderGuard() {
+    queue_.Close();
+    if (reader_.joinable()) {
+      reader_.join();
+    }
+  }
+
+ private:
+  grammar::BoundedQueue<RulesBlock> &queue_;
+  std::thread &reader_;
+};
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage("This program calculates the differential SLP (span sums and samples) for the given "
+                          "differential data, reading the RePair grammar only once.");
+  gflags::AllowCommandLineReparsing();
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+  if (FLAGS_data.empty()) {
+    std::cerr << "Command-line error!!!" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::size_t> max_sizes;
+  {
+    std::stringstream ss(FLAGS_max_sizes);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      max_sizes.emplace_back(std::stoul(item));
+    }
+  }
+
+  boost::filesystem::path datafile = FLAGS_data;
+  auto base_name = datafile.stem();
+
+  sdsl::cache_config config(false, ".", base_name.string());
+
+  std::size_t seq_size;
+  uint64_t diff_base_seq;
+  {
+    std::ifstream in(datafile.string() + ".info");
+    in >> seq_size;
+
+    int64_t minimal;
+    in >> minimal;
+    diff_base_seq = minimal < 0 ? std::abs(minimal) : 0;
+  }
+
+  auto start = Clock::now();
+
+  // Stage 1: read the grammar (producer) while the rules are added to the SLP (consumer)
+  grammar::SLP<> slp;
+  std::vector<std::size_t> compact_seq;
+  {
+    grammar::BoundedQueue<RulesBlock> queue(4);
+    int sigma = 0;
+
+    struct ReportRule {
+      grammar::BoundedQueue<RulesBlock> &queue;
+      int &sigma;
+      std::size_t block_size;
+      RulesBlock block;
+
+      void operator()(int _sigma) {
+        sigma = _sigma;
+      }
+
+      void operator()(int _left, int _right, int _length) {
+        block.rules.emplace_back(_left, _right);
+        if (block_size <= block.rules.size()) {
+          Flush();
+        }
+      }
+
+      void Flush() {
+        queue.Push(std::move(block));
+        block = RulesBlock();
+      }
+    } report_rule{queue, sigma, FLAGS_block_size};
+
+    auto report_compact_seq = [&compact_seq](const auto &_var) {
+      compact_seq.emplace_back(_var);
+    };
+
+    std::exception_ptr error;
+    std::thread reader([&]() {
+      try {
+        grammar::RePairReader<false> re_pair_reader;
+        re_pair_reader.Read(datafile.string(), report_rule, report_compact_seq);
+        report_rule.Flush();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      queue.Close();
+    });
+
+    {
+      ReaderGuard guard(queue, reader);
+
+      RulesBlock block;
+      bool first = true;
+      while (queue.Pop(block)) {
+        if (first) {
+          slp.Reset(sigma); // The alphabet is reported before the first rule
+          first = false;
+        }
+
+        for (const auto &rule : block.rules) {
+          slp.AddRule(rule.first, rule.second);
+        }
+      }
+
+      if (first) {
+        slp.Reset(sigma);
+      }
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+  std::cout << "Read (s): " << Elapsed(start) << std::endl;
+
+  start = Clock::now();
+  sdsl::int_vector<> span_sums;
+  auto minmax = grammar::ComputeSpanSums(slp, diff_base_seq, span_sums, FLAGS_threads);
+  uint64_t diff_base_sums = minmax.first < 0 ? -minmax.first : 0;
+  std::cout << "Span sums (s): " << Elapsed(start) << std::endl;
+
+  // Stage 2: samples for all the interval sizes in one pass
+  start = Clock::now();
+  auto get_span_sum = [&slp, &diff_base_seq, &span_sums, &diff_base_sums](auto _var) {
+    return slp.IsTerminal(_var)
+           ? int64_t(_var) - int64_t(diff_base_seq)
+           : int64_t(span_sums[_var - slp.Sigma() - 1]) - int64_t(diff_base_sums);
+  };
+
+  std::vector<sdsl::bit_vector> tmp_positions(max_sizes.size(), sdsl::bit_vector(seq_size, 0));
+  std::vector<std::vector<std::size_t>> tmp_values(max_sizes.size());
+  std::vector<std::vector<std::size_t>> tmp_roots_pos(max_sizes.size());
+  auto report_sample = [&](auto _k, auto _pos, auto _sum, auto _root_pos) {
+    tmp_positions[_k][_pos] = 1;
+    tmp_values[_k].emplace_back(_sum);
+    tmp_roots_pos[_k].emplace_back(_root_pos);
+  };
+
+  grammar::ComputeSamplesOnCompactSequence(compact_seq, slp, get_span_sum, max_sizes, report_sample);
+  std::cout << "Samples (s): " << Elapsed(start) << std::endl;
+
+  // Stage 3: write the outputs
+  start = Clock::now();
+  std::vector<char> buffer(FLAGS_buffer_size);
+  {
+    StoreToCache(span_sums, KEY_GRM_SPAN_SUMS, config, buffer);
+
+    std::ofstream out(cache_file_name(KEY_GRM_SPAN_SUMS, config) + ".info");
+    out << minmax.first << std::endl;
+    out << minmax.second << std::endl;
+  }
+
+  for (std::size_t k = 0; k < max_sizes.size(); ++k) {
+    // The samples of the first size are stored with the keys of build_dslp_samples, too
+    std::vector<std::string> suffixes = {"_" + std::to_string(max_sizes[k])};
+    if (k == 0) {
+      suffixes.emplace_back("");
+    }
+
+    sdsl::int_vector<> values;
+    grammar::Construct(values, tmp_values[k]);
+    sdsl::util::bit_compress(values);
+
+    sdsl::int_vector<> roots_pos;
+    grammar::Construct(roots_pos, tmp_roots_pos[k]);
+    sdsl::util::bit_compress(roots_pos);
+
+    sdsl::sd_vector<> positions(tmp_positions[k]);
+
+    for (const auto &suffix : suffixes) {
+      StoreToCache(values, KEY_GRM_SAMPLE_VALUES + suffix, config, buffer);
+      StoreToCache(roots_pos, KEY_GRM_SAMPLE_ROOTS_POSITIONS + suffix, config, buffer);
+      StoreToCache(positions, KEY_GRM_SAMPLE_POSITIONS + suffix, config, buffer);
+    }
+
+    std::cout << "Samples (max_size = " << max_sizes[k] << "): " << values.size() << std::endl;
+  }
+  std::cout << "Write (s): " << Elapsed(start) << std::endl;
+
+  return 0;
+}
@@ -3,6 +3,9 @@
 //
 
 #include <iostream>
+#include <random>
+#include <chrono>
+#include <sstream>
 //#include <filesystem>
 
 #include <boost/filesystem.hpp>
@@ -20,7 +23,35 @@
 #include "definitions.h"
 
 DEFINE_string(data, "", "Data file. (MANDATORY)");
-DEFINE_int32(max_size, 0, "Maximum size of sampled intervals. (MANDATORY)");
+DEFINE_int32(max_size, 0, "Maximum size of sampled intervals. If 0, it is chosen among the candidates.");
+DEFINE_string(candidates, "16,64,256,1024,4096", "Candidate maximum sizes of sampled intervals (comma-separated).");
+DEFINE_uint64(memory_budget, 0, "Memory budget (in bytes) of the differential SLP for the chosen sampling.");
+DEFINE_double(latency_target, 0, "Latency target (in nanoseconds per access) for the chosen sampling.");
+DEFINE_uint64(n_queries, 10000, "Number of sampled accesses to measure the latency of each candidate.");
+
+// Sink of the measured accesses, so they are not optimized away
+volatile int64_t latency_sink = 0;
+
+/**
+ * Measure the average latency (nanoseconds) of accessing the given positions
+ */
+template<typename DSLP>
+double MeasureLatency(const DSLP &_dslp, const std::vector<std::size_t> &_positions) {
+  int64_t value = 0, checksum = 0;
+  auto report_value = [&value](auto _value) {
+    value = _value;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &position : _positions) {
+    grammar::ExpandDifferentialSLP(_dslp, position, position, report_value);
+    checksum += value;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  latency_sink = checksum;
+  return std::chrono::duration<double, std::nano>(end - start).count() / std::max<std::size_t>(_positions.size(), 1);
+}
 
 int main(int argc, char **argv) {
   gflags::SetUsageMessage("This program calculates the differential SLP for the given differential data.");
@@ -79,34 +110,66 @@ int main(int argc, char **argv) {
       return slp.IsTerminal(_var) ? (_var - diff_base_seq) : (span_sums[_var - slp.Sigma() - 1] - diff_base_sums);
     };
 
-    sdsl::bit_vector tmp_sample_pos(seq_size, 0);
-    std::vector<std::size_t> tmp_samples;
-    tmp_samples.reserve(compact_seq.size());
-    std::vector<std::size_t> tmp_sample_roots_pos;
-    tmp_sample_roots_pos.reserve(compact_seq.size());
-    auto report_sample =
-        [&tmp_sample_pos, &tmp_samples, &tmp_sample_roots_pos](auto _seq_pos, auto _sum, auto _root_pos) {
-          tmp_sample_pos[_seq_pos] = 1;
-          tmp_samples.emplace_back(_sum);
-          tmp_sample_roots_pos.emplace_back(_root_pos);
-        };
-
-    grammar::ComputeSamplesOnCompactSequence(compact_seq, slp, get_span_sum, FLAGS_max_size, report_sample);
-
-    sdsl::int_vector<> samples;
-    grammar::Construct(samples, tmp_samples);
-    sdsl::util::bit_compress(samples);
-    sdsl::store_to_cache(samples, KEY_GRM_SAMPLE_VALUES /*+ ("_" + std::to_string(FLAGS_max_size))*/, config);
-
-    sdsl::int_vector<> sample_roots_pos;
-    grammar::Construct(sample_roots_pos, tmp_sample_roots_pos);
-    sdsl::util::bit_compress(sample_roots_pos);
-    sdsl::store_to_cache(sample_roots_pos,
-                         KEY_GRM_SAMPLE_ROOTS_POSITIONS /*+ ("_" + std::to_string(FLAGS_max_size))*/,
-                         config);
-
-    sdsl::sd_vector<> sample_pos(tmp_sample_pos);
-    sdsl::store_to_cache(sample_pos, KEY_GRM_SAMPLE_POSITIONS /*+ ("_" + std::to_string(FLAGS_max_size))*/, config);
+    using Samples = grammar::DifferentialSLPSamples<>;
+
+    std::vector<std::size_t> candidates;
+    if (0 < FLAGS_max_size) {
+      candidates.emplace_back(FLAGS_max_size);
+    } else {
+      std::stringstream ss(FLAGS_candidates);
+      std::string item;
+      while (std::getline(ss, item, ',')) {
+        candidates.emplace_back(std::stoul(item));
+      }
+    }
+
+    std::vector<std::size_t> positions(FLAGS_n_queries);
+    {
+      std::mt19937 eng(seq_size);
+      std::uniform_int_distribution<std::size_t> distr(0, seq_size - 1);
+      for (auto &item : positions) {
+        item = distr(eng);
+      }
+    }
+
+    // Size of the differential SLP without samples
+    std::size_t base_size = sdsl::size_in_bytes(slp) + sdsl::size_in_bytes(compact_seq) + sdsl::size_in_bytes(span_sums)
+        + sizeof(seq_size) + sizeof(diff_base_seq) + sizeof(diff_base_sums);
+
+    std::vector<Samples> all_samples;
+    std::vector<grammar::SamplingCandidate> metrics;
+    for (const auto &max_size : candidates) {
+      all_samples.emplace_back(seq_size, compact_seq, slp, get_span_sum, max_size);
+
+      auto dslp = grammar::MakeDifferentialSLPWrapper(
+          seq_size, slp, compact_seq, diff_base_seq, span_sums, diff_base_sums, all_samples.back());
+
+      metrics.push_back({max_size,
+                         base_size + sdsl::size_in_bytes(all_samples.back()),
+                         1 < candidates.size() ? MeasureLatency(dslp, positions) : 0.0});
+      std::cout << "max_size: " << metrics.back().max_span_length
+                << " size: " << metrics.back().size_in_bytes
+                << " latency: " << metrics.back().latency << std::endl;
+    }
+
+    auto chosen = grammar::ChooseSampling(metrics, FLAGS_memory_budget, FLAGS_latency_target);
+    const auto &samples = all_samples[chosen];
+
+    sdsl::store_to_cache(samples.GetValues(), KEY_GRM_SAMPLE_VALUES, config);
+    sdsl::store_to_cache(samples.GetRootsPositions(), KEY_GRM_SAMPLE_ROOTS_POSITIONS, config);
+    sdsl::store_to_cache(samples.GetPositions(), KEY_GRM_SAMPLE_POSITIONS, config);
+
+    {
+      std::ofstream out(cache_file_name(KEY_GRM_SAMPLE_VALUES, config) + ".info");
+      out << metrics[chosen].max_span_length << std::endl;
+      out << metrics[chosen].size_in_bytes << std::endl;
+      out << metrics[chosen].latency << std::endl;
+
+      // All the measured candidates
+      for (const auto &item : metrics) {
+        out << item.max_span_length << " " << item.size_in_bytes << " " << item.latency << std::endl;
+      }
+    }
   }
 
   return 0;
@@ -21,6 +21,7 @@
 
 
 DEFINE_string(data, "", "Data file. (MANDATORY)");
+DEFINE_uint32(threads, 1, "Number of threads.");
 
 int main(int argc, char **argv) {
   gflags::SetUsageMessage("This program calculates the differential SLP for the given differential data.");
@@ -62,25 +63,8 @@ int main(int argc, char **argv) {
       diff_base = minimal < 0 ? std::abs(minimal) : 0;
     }
 
-    sdsl::int_vector<> span_sums(slp.GetRules().size());
-//    std::size_t i = 0;
-    auto sigma = slp.Sigma();
-    auto report_sum = [&span_sums, sigma](auto _i, auto _sum) {
-      span_sums[_i - sigma - 1] = _sum;
-    };
-
-    auto minmax = grammar::ComputeSpanSums(slp, diff_base, report_sum);
-
-//  std::cout << "sigma: " << slp.Sigma() << std::endl;
-//  std::cout << "# rules: " << slp.GetRules().size() << std::endl;
-//  std::cout << "max len: " << *std::max_element(slp.GetRulesLengths().begin(), slp.GetRulesLengths().end()) << std::endl;
-//
-//  std::cout << "# sums: " << span_sums.size() << std::endl;
-//  std::cout << "minmax original span sum: " << minmax.first << " --- " << minmax.second << std::endl;
-//  auto mm = std::minmax_element(span_sums.begin(), span_sums.end());
-//  std::cout << "minmax new span sum: " << *mm.first << " --- " << *mm.second << std::endl;
-
-    sdsl::util::bit_compress(span_sums);
+    sdsl::int_vector<> span_sums;
+    auto minmax = grammar::ComputeSpanSums(slp, diff_base, span_sums, FLAGS_threads);
 
     sdsl::store_to_cache(span_sums, KEY_GRM_SPAN_SUMS, config);
 
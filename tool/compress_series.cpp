@@ -0,0 +1,72 @@
+//
+// Created by agent <agent@local> on 10/19/26.
+//
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+
+#include <gflags/gflags.h>
+
+#include <sdsl/io.hpp>
+
+#include <grammar/differential_encoder.h>
+
+DEFINE_string(data, "", "Raw binary series of integers. (MANDATORY)");
+DEFINE_bool(int64, false, "The integers of the series are 64 bits (32 bits otherwise).");
+DEFINE_uint64(chunk_size, 0, "Number of values per chunk (0 for the whole series).");
+DEFINE_uint64(max_diff, 0, "Maximum absolute difference between consecutive values (mandatory with chunks).");
+DEFINE_uint64(max_size, 64, "Maximum size of sampled intervals.");
+DEFINE_uint64(threads, 1, "Number of threads to compute the span sums.");
+DEFINE_string(output, "", "Output file (default: <data>.dslp).");
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage("This program compresses a raw integer series into a differential SLP, computing the "
+                          "differences, the grammar, the span sums and the samples in one pass over the series.");
+  gflags::AllowCommandLineReparsing();
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+
+  if (FLAGS_data.empty() || (0 < FLAGS_chunk_size && FLAGS_max_diff == 0)) {
+    std::cerr << "Command-line error!!!" << std::endl;
+    return 1;
+  }
+
+  auto output = FLAGS_output.empty() ? FLAGS_data + ".dslp" : FLAGS_output;
+
+  std::ifstream in(FLAGS_data, std::ios::binary);
+  if (!in) {
+    std::cerr << "Cannot open " << FLAGS_data << std::endl;
+    return 1;
+  }
+
+  auto start = Clock::now();
+
+  grammar::DifferentialSLP<> dslp;
+  auto compress = [&](auto _int) {
+    return grammar::CompressSeries<decltype(_int)>(
+        in, dslp, FLAGS_max_size, FLAGS_chunk_size, FLAGS_max_diff, FLAGS_threads);
+  };
+  auto info = FLAGS_int64 ? compress(int64_t()) : compress(int32_t());
+
+  std::cout << "Compress (s): " << std::chrono::duration<double>(Clock::now() - start).count() << std::endl;
+
+  {
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    sdsl::serialize(dslp, out);
+  }
+  {
+    std::ofstream out(output + ".info");
+    out << info.size << std::endl;
+    out << info.min << std::endl;
+    out << info.max << std::endl;
+    out << info.first << std::endl;
+  }
+
+  std::cout << "Values: " << info.size << std::endl;
+  std::cout << "Differences: [" << info.min << ", " << info.max << "]" << std::endl;
+  std::cout << "Size (bytes): " << sdsl::size_in_bytes(dslp) << std::endl;
+
+  return 0;
+}